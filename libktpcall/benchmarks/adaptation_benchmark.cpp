@@ -0,0 +1,178 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Offline benchmark for the network driven video adaptation of libktpcall.
+ *
+ * The video is sent over a simulated link that goes from a LAN to DSL, to a
+ * poor mobile link and back. Whatever is sent beyond the capacity of the link
+ * is lost and queues up in the round trip, on top of a little random loss. Every
+ * RTCP interval, the loss and round trip of that interval go through
+ * VideoAdaptationPolicy, like the receiver reports do in a call. For each phase,
+ * the tiers that were sent and the loss that they caused are compared with
+ * always sending 720p and always sending 320x240 at 15fps, as before.
+ */
+
+#include "../private/video-adaptation.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QTextStream>
+
+#include <stdlib.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+static const int s_rtcpInterval = 5; //s
+static const int s_baseRoundTrip = 40; //ms
+static const int s_fixedSmallBitrate = 150000; //320x240 at 15fps
+
+struct Phase
+{
+    const char *name;
+    int seconds;
+    int capacity; //bps
+    double randomLoss;
+};
+
+static const Phase s_phases[] = {
+    { "lan", 60, 20000000, 0.001 },
+    { "dsl", 60, 1200000, 0.005 },
+    { "mobile", 60, 350000, 0.01 },
+    { "lan again", 90, 20000000, 0.001 }
+};
+static const int s_phaseCount = sizeof(s_phases) / sizeof(s_phases[0]);
+
+enum Strategy {
+    Adaptive,
+    Fixed720p,
+    FixedSmall
+};
+
+struct PhaseResult
+{
+    PhaseResult() : seconds(0), sentBits(0), lostBits(0), pixelSeconds(0), changes(0) {}
+
+    int seconds;
+    qint64 sentBits;
+    qint64 lostBits;
+    qint64 pixelSeconds; //of what arrived, as a measure of the picture
+    int changes;
+};
+
+double random01()
+{
+    return double(rand()) / RAND_MAX;
+}
+
+QList<PhaseResult> simulate(Strategy strategy, unsigned int seed, bool verbose, QTextStream & out)
+{
+    srand(seed);
+
+    VideoAdaptationPolicy policy;
+    policy.setNativeSize(1280, 720);
+    QList<PhaseResult> results;
+
+    for (int p = 0; p < s_phaseCount; ++p) {
+        const Phase & phase = s_phases[p];
+        PhaseResult result;
+
+        for (int t = 0; t < phase.seconds; t += s_rtcpInterval) {
+            VideoAdaptationPolicy::Tier tier = policy.tier();
+            int bitrate = tier.bitrate;
+            int pixels = tier.width * tier.height * tier.framerate;
+            if (strategy == Fixed720p) {
+                bitrate = 1500000;
+                pixels = 1280 * 720 * 30;
+            } else if (strategy == FixedSmall) {
+                bitrate = s_fixedSmallBitrate;
+                pixels = 320 * 240 * 15;
+            }
+
+            //an overloaded link drops the excess and queues for as long as its buffer lasts
+            double overflow = bitrate > phase.capacity ? double(bitrate - phase.capacity) / bitrate : 0.0;
+            double fractionLost = qMin(1.0, overflow + phase.randomLoss * (0.5 + random01()));
+            int roundTrip = s_baseRoundTrip + (overflow > 0 ? 300 + int(overflow * 500) : 0);
+
+            result.seconds += s_rtcpInterval;
+            result.sentBits += qint64(bitrate) * s_rtcpInterval;
+            result.lostBits += qint64(bitrate * fractionLost) * s_rtcpInterval;
+            result.pixelSeconds += qint64(pixels * (1.0 - fractionLost)) * s_rtcpInterval;
+
+            if (strategy == Adaptive && policy.update(fractionLost, roundTrip, 0)) {
+                ++result.changes;
+                if (verbose) {
+                    tier = policy.tier();
+                    out << phase.name << ": loss " << QString::number(fractionLost * 100, 'f', 1)
+                        << "%, estimate " << policy.estimatedBitrate() / 1000 << " kbps -> "
+                        << tier.width << "x" << tier.height << "@" << tier.framerate << endl;
+                }
+            }
+        }
+        results.append(result);
+    }
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("adaptation_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Runs the libktpcall video adaptation against a simulated link that changes "
+        "between LAN, DSL and mobile, and compares it with a fixed resolution."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("seed"),
+        QStringLiteral("Seed of the simulated loss."), QStringLiteral("seed"), QStringLiteral("1")));
+    parser.addOption(QCommandLineOption(QStringLiteral("verbose"),
+        QStringLiteral("Print every tier change of the adaptation.")));
+    parser.process(app);
+
+    unsigned int seed = parser.value(QStringLiteral("seed")).toUInt();
+    bool verbose = parser.isSet(QStringLiteral("verbose"));
+
+    QTextStream out(stdout);
+    const char *strategyNames[] = { "adaptive", "fixed 720p", "fixed 240p" };
+    QList<PhaseResult> results[3];
+    for (int s = Adaptive; s <= FixedSmall; ++s) {
+        results[s] = simulate(Strategy(s), seed, verbose, out);
+    }
+
+    out << qSetFieldWidth(12) << left << "phase" << qSetFieldWidth(14) << "strategy"
+        << qSetFieldWidth(12) << right << "kbps" << "lost %" << "Mpixel/s" << "changes"
+        << qSetFieldWidth(0) << endl;
+    for (int p = 0; p < s_phaseCount; ++p) {
+        for (int s = Adaptive; s <= FixedSmall; ++s) {
+            const PhaseResult & result = results[s].at(p);
+            out << qSetFieldWidth(12) << left << s_phases[p].name << qSetFieldWidth(14) << strategyNames[s]
+                << qSetFieldWidth(12) << right
+                << QString::number(double(result.sentBits) / result.seconds / 1000, 'f', 0)
+                << QString::number(100.0 * result.lostBits / result.sentBits, 'f', 2)
+                << QString::number(double(result.pixelSeconds) / result.seconds / 1e6, 'f', 2)
+                << result.changes
+                << qSetFieldWidth(0) << endl;
+        }
+    }
+
+    return 0;
+}
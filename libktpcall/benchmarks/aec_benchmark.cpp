@@ -0,0 +1,190 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Headless benchmark for the in-pipeline echo canceller of libktpcall.
+ *
+ * It runs the capture bin of TfAudioContentHandler on a live test source,
+ * next to a far-end test source that goes through the echo probe, once with
+ * and once without the echo canceller, and reports the difference in process
+ * CPU time per 10 ms frame of captured audio.
+ */
+
+#include "../private/tf-audio-content-handler.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QEventLoop>
+#include <QtCore/QTimer>
+#include <QtCore/QTextStream>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/ElementFactory>
+#include <QGst/Pipeline>
+#include <QGst/Structure>
+
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+qint64 processCpuTimeNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+         + (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+QGst::ElementPtr makeTestSrc(int rate, int wave)
+{
+    QGst::ElementPtr src = QGst::ElementFactory::make("audiotestsrc");
+    src->setProperty("is-live", true);
+    src->setProperty("wave", wave);
+    src->setProperty("samplesperbuffer", rate / 100);
+    return src;
+}
+
+QGst::CapsPtr rateCaps(int rate)
+{
+    QGst::Structure capsStruct("audio/x-raw");
+    capsStruct.setValue("rate", rate);
+    capsStruct.setValue("channels", 1);
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+    return caps;
+}
+
+QGst::ElementPtr makeFakeSink()
+{
+    QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+    sink->setProperty("sync", true);
+    sink->setProperty("silent", true);
+    return sink;
+}
+
+/* far end:  audiotestsrc ! [echo probe] ! fakesink
+ * near end: audiotestsrc ! [TfAudioContentHandler src bin, with or without echo canceller] ! fakesink
+ * Returns the CPU time in ns that the process used, or -1 on failure */
+qint64 runCapture(int rate, bool withEchoCanceller, int durationMs)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    QString probeName = QStringLiteral("echo_probe_bench");
+
+    QGst::ElementPtr farSrc = makeTestSrc(rate, 0 /* sine */);
+    QGst::ElementPtr probe = TfAudioContentHandler::makeEchoProbe(probeName);
+    QGst::ElementPtr farSink = makeFakeSink();
+    if (!probe) {
+        return -1;
+    }
+    pipeline->add(farSrc, probe, farSink);
+    QGst::Element::linkMany(farSrc, probe, farSink);
+
+    QGst::BinPtr bin = TfAudioContentHandler::makeSrcBin(makeTestSrc(rate, 5 /* white noise */),
+            QLatin1String("bench"), rateCaps(rate),
+            withEchoCanceller ? probeName : QString());
+    if (!bin) {
+        return -1;
+    }
+    QGst::ElementPtr nearSink = makeFakeSink();
+    pipeline->add(bin, nearSink);
+    bin->link(nearSink);
+
+    //the probe has to be running before the echo canceller looks it up
+    probe->setState(QGst::StatePaused);
+    if (pipeline->setState(QGst::StatePlaying) == QGst::StateChangeFailure) {
+        qWarning() << "Failed to start the pipeline at" << rate << "Hz";
+        pipeline->setState(QGst::StateNull);
+        return -1;
+    }
+
+    //let the pipeline settle, so that preroll and caps negotiation do not count
+    QEventLoop loop;
+    QTimer::singleShot(500, &loop, SLOT(quit()));
+    loop.exec();
+
+    qint64 cpuStart = processCpuTimeNs();
+    QTimer::singleShot(durationMs, &loop, SLOT(quit()));
+    loop.exec();
+    qint64 cpuTime = processCpuTimeNs() - cpuStart;
+
+    QGst::MessagePtr error = pipeline->bus()->pop(QGst::MessageError);
+    pipeline->setState(QGst::StateNull);
+
+    if (error) {
+        qWarning() << "The pipeline at" << rate << "Hz posted an error:"
+                   << error.staticCast<QGst::ErrorMessage>()->error();
+        return -1;
+    }
+    return cpuTime;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("aec_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Measures the CPU cost of the libktpcall echo canceller per 10 ms frame, using test sources."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("duration"),
+        QStringLiteral("Measurement time per run, in seconds."), QStringLiteral("seconds"),
+        QStringLiteral("10")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int durationMs = parser.value(QStringLiteral("duration")).toInt() * 1000;
+    if (durationMs <= 0) {
+        durationMs = 10000;
+    }
+    const qint64 frames = durationMs / 10;
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(10) << left << "rate"
+        << qSetFieldWidth(14) << right << "base(us/frm)" << "aec(us/frm)" << "cost(us/frm)"
+        << qSetFieldWidth(0) << endl;
+
+    bool failed = false;
+    QList<int> rates;
+    rates << 16000 << 32000 << 48000;
+    Q_FOREACH (int rate, rates) {
+        qint64 base = runCapture(rate, false, durationMs);
+        qint64 aec = runCapture(rate, true, durationMs);
+        if (base < 0 || aec < 0) {
+            failed = true;
+            continue;
+        }
+
+        out << qSetFieldWidth(10) << left << rate
+            << qSetFieldWidth(14) << right
+            << QString::number(base / 1000.0 / frames, 'f', 1)
+            << QString::number(aec / 1000.0 / frames, 'f', 1)
+            << QString::number((aec - base) / 1000.0 / frames, 'f', 1)
+            << qSetFieldWidth(0) << endl;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Benchmark for the conversion of video to an RGB-only sink in libktpcall.
+ *
+ * For I420 frames of 320x240, 640x480 and 1280x720, shown mirrored in a 1280x720
+ * window, it measures:
+ *  - ConvertScalePlan with the portable kernels and with those that the CPU runs
+ *    best, checking that both give the same picture;
+ *  - videoconvert ! videoscale ! videoflip against ktpvideoconvertscale in a
+ *    pipeline, with the time of the pipeline without any conversion taken off.
+ */
+
+#include "../private/video-convert-scale.h"
+#include "../private/video-kernels.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTextStream>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/ElementFactory>
+#include <QGst/Pipeline>
+
+#include <gst/gst.h>
+#include <string.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+static const int s_windowWidth = 1280;
+static const int s_windowHeight = 720;
+
+struct Size
+{
+    int width;
+    int height;
+};
+
+static const Size s_sizes[] = {
+    { 320, 240 },
+    { 640, 480 },
+    { 1280, 720 }
+};
+
+enum Chain {
+    NoConversion,
+    ElementChain,
+    FusedElement
+};
+
+/* An I420 frame with some detail in every plane */
+struct Frame
+{
+    Frame(int width, int height)
+    {
+        strides[0] = width;
+        strides[1] = strides[2] = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        for (int p = 0; p < 3; ++p) {
+            int rows = p ? chromaHeight : height;
+            data[p].resize(strides[p] * rows);
+            for (int i = 0; i < data[p].size(); ++i) {
+                data[p][i] = quint8((i * (p * 3 + 7) + i / strides[p] * 5) & 0xff);
+            }
+            planes[p] = data[p].constData();
+        }
+    }
+
+    QVector<quint8> data[3];
+    const quint8 *planes[3];
+    int strides[3];
+};
+
+/* ms per frame */
+double timePlan(ConvertScalePlan & plan, const Frame & frame, QVector<quint8> & out, int frames)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; ++i) {
+        plan.run(frame.planes, frame.strides, out.data(), s_windowWidth * 4);
+    }
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
+
+/* videotestsrc ! I420 at size ! [chain] ! fakesink, as fast as it goes.
+ * Returns the ms per frame, or a negative value on failure */
+double timePipeline(const Size & size, Chain chain, int frames)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+
+    QGst::ElementPtr src = QGst::ElementFactory::make("videotestsrc");
+    src->setProperty("num-buffers", frames);
+    src->setProperty("pattern", 18 /* ball */);
+    QGst::ElementPtr srcFilter = QGst::ElementFactory::make("capsfilter");
+    srcFilter->setProperty("caps", QGst::Caps::fromString(QStringLiteral(
+            "video/x-raw, format=(string)I420, width=(int)%1, height=(int)%2, framerate=(fraction)30/1")
+            .arg(size.width).arg(size.height)));
+    QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+    sink->setProperty("sync", false);
+    sink->setProperty("silent", true);
+    pipeline->add(src, srcFilter, sink);
+
+    bool linked;
+    if (chain == NoConversion) {
+        linked = QGst::Element::linkMany(src, srcFilter, sink);
+    } else {
+        //what an RGB-only sink showing a window asks for
+        QGst::ElementPtr sinkFilter = QGst::ElementFactory::make("capsfilter");
+        sinkFilter->setProperty("caps", QGst::Caps::fromString(QStringLiteral(
+                "video/x-raw, format=(string)BGRx, width=(int)%1, height=(int)%2")
+                .arg(s_windowWidth).arg(s_windowHeight)));
+        pipeline->add(sinkFilter);
+
+        if (chain == ElementChain) {
+            QGst::ElementPtr colorspace = QGst::ElementFactory::make("videoconvert");
+            QGst::ElementPtr videoscale = QGst::ElementFactory::make("videoscale");
+            QGst::ElementPtr videoflip = QGst::ElementFactory::make("videoflip");
+            videoflip->setProperty("method", 4 /* horizontal */);
+            pipeline->add(colorspace, videoscale, videoflip);
+            linked = QGst::Element::linkMany(src, srcFilter, colorspace, videoscale, videoflip, sinkFilter, sink);
+        } else {
+            QGst::ElementPtr convertScale = VideoConvertScale::make(true);
+            if (!convertScale) {
+                return -1;
+            }
+            pipeline->add(convertScale);
+            linked = QGst::Element::linkMany(src, srcFilter, convertScale, sinkFilter, sink);
+        }
+    }
+    if (!linked) {
+        qWarning() << "Failed to link the pipeline for" << size.width << "x" << size.height;
+        return -1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    pipeline->setState(QGst::StatePlaying);
+
+    GstBus *bus = static_cast<GstBus*>(pipeline->bus());
+    GstMessage *message = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    double ms = timer.nsecsElapsed() / 1e6 / frames;
+
+    bool ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+    if (!ok) {
+        GError *error = NULL;
+        gst_message_parse_error(message, &error, NULL);
+        qWarning() << "The pipeline posted an error:" << error->message;
+        g_error_free(error);
+    }
+    gst_message_unref(message);
+    pipeline->setState(QGst::StateNull);
+    return ok ? ms : -1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("convert_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Compares the fused convert, scale and mirror of libktpcall with "
+        "videoconvert ! videoscale ! videoflip, for sinks that only take RGB."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("frames"),
+        QStringLiteral("Frames to convert for every measurement."), QStringLiteral("count"),
+        QStringLiteral("300")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int frames = qMax(1, parser.value(QStringLiteral("frames")).toInt());
+    const VideoKernels::Kernels & best = VideoKernels::best();
+    const VideoKernels::YuvMatrix matrix = VideoKernels::matrix(false, false);
+
+    QTextStream out(stdout);
+    out << "kernels: " << best.name << ", window: " << s_windowWidth << "x" << s_windowHeight
+        << ", frames: " << frames << endl << endl;
+
+    out << qSetFieldWidth(12) << left << "input" << qSetFieldWidth(14) << right
+        << "portable ms" << (QString::fromLatin1(best.name) + QStringLiteral(" ms")) << "speedup"
+        << qSetFieldWidth(0) << endl;
+    for (uint i = 0; i < sizeof(s_sizes) / sizeof(s_sizes[0]); ++i) {
+        const Size & size = s_sizes[i];
+        Frame frame(size.width, size.height);
+        QVector<quint8> portableOut(s_windowWidth * s_windowHeight * 4);
+        QVector<quint8> bestOut(portableOut.size());
+
+        ConvertScalePlan portablePlan(size.width, size.height, s_windowWidth, s_windowHeight, true,
+                                      matrix, false, VideoKernels::portable());
+        ConvertScalePlan bestPlan(size.width, size.height, s_windowWidth, s_windowHeight, true,
+                                  matrix, false, best);
+        double portableMs = timePlan(portablePlan, frame, portableOut, frames);
+        double bestMs = timePlan(bestPlan, frame, bestOut, frames);
+        if (memcmp(portableOut.constData(), bestOut.constData(), bestOut.size()) != 0) {
+            qWarning() << "The" << best.name << "kernels do not give the same picture as the portable ones";
+            return 1;
+        }
+
+        out << qSetFieldWidth(12) << left << QStringLiteral("%1x%2").arg(size.width).arg(size.height)
+            << qSetFieldWidth(14) << right
+            << QString::number(portableMs, 'f', 3) << QString::number(bestMs, 'f', 3)
+            << QString::number(portableMs / bestMs, 'f', 1)
+            << qSetFieldWidth(0) << endl;
+    }
+    out << endl;
+
+    out << qSetFieldWidth(12) << left << "input" << qSetFieldWidth(14) << right
+        << "chain ms" << "fused ms" << "speedup" << qSetFieldWidth(0) << endl;
+    for (uint i = 0; i < sizeof(s_sizes) / sizeof(s_sizes[0]); ++i) {
+        const Size & size = s_sizes[i];
+        double baseMs = timePipeline(size, NoConversion, frames);
+        double chainMs = timePipeline(size, ElementChain, frames);
+        double fusedMs = timePipeline(size, FusedElement, frames);
+        if (baseMs < 0 || chainMs < 0 || fusedMs < 0) {
+            return 1;
+        }
+        chainMs = qMax(0.0, chainMs - baseMs);
+        fusedMs = qMax(0.0, fusedMs - baseMs);
+
+        out << qSetFieldWidth(12) << left << QStringLiteral("%1x%2").arg(size.width).arg(size.height)
+            << qSetFieldWidth(14) << right
+            << QString::number(chainMs, 'f', 3) << QString::number(fusedMs, 'f', 3)
+            << (fusedMs > 0 ? QString::number(chainMs / fusedMs, 'f', 1) : QStringLiteral("-"))
+            << qSetFieldWidth(0) << endl;
+    }
+
+    return 0;
+}
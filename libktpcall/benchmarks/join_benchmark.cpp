@@ -0,0 +1,303 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Stress test for participants joining and leaving a conference in libktpcall.
+ *
+ * A fixed set of live test sources is mixed through the same AudioSinkController
+ * bins, mixer and post-mix conversion that TfAudioContentHandler uses, into a
+ * synchronized fakesink. One extra participant then joins and leaves over and
+ * over, the way remote streams come and go, and every buffer that reaches the
+ * sink late or after a hole in the timestamps is counted as a dropout. The same
+ * count over a run without joins is the baseline.
+ */
+
+#include "../private/tf-audio-content-handler.h"
+#include "../private/sink-controllers.h"
+#include "../private/bus-sync-handler.h"
+#include "../private/thread-scheduler.h"
+#include "../private/thread-topology.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QEventLoop>
+#include <QtCore/QTimer>
+#include <QtCore/QTextStream>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/ElementFactory>
+#include <QGst/Pipeline>
+#include <QGst/Structure>
+
+#include <gst/gst.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+//timestamps may be off by rounding in the mixer and the converters
+static const GstClockTime s_tolerance = GST_MSECOND;
+
+/* Counts the buffers that reach the sink too late to be played on time,
+ * or that do not follow the previous one */
+struct DropoutCounter
+{
+    DropoutCounter() : dropouts(0), latency(GST_CLOCK_TIME_NONE), expectedPts(GST_CLOCK_TIME_NONE) {}
+
+    QAtomicInteger<quint64> dropouts;
+    QAtomicInteger<quint64> latency;
+
+    //only used from the streaming thread
+    GstClockTime expectedPts;
+};
+
+GstPadProbeReturn onSinkBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    DropoutCounter *counter = static_cast<DropoutCounter*>(data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    GstClockTime latency = counter->latency.load();
+    if (!GST_CLOCK_TIME_IS_VALID(pts) || !GST_CLOCK_TIME_IS_VALID(latency)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    bool dropout = GST_CLOCK_TIME_IS_VALID(counter->expectedPts)
+            && pts > counter->expectedPts + s_tolerance;
+    if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
+        counter->expectedPts = pts + GST_BUFFER_DURATION(buffer);
+    }
+
+    GstElement *sink = GST_ELEMENT(gst_pad_get_parent(pad));
+    GstClock *clock = gst_element_get_clock(sink);
+    GstClockTime baseTime = gst_element_get_base_time(sink);
+    gst_object_unref(sink);
+    if (clock) {
+        GstClockTime now = gst_clock_get_time(clock) - baseTime;
+        gst_object_unref(clock);
+        //the segment of the mixer output starts at 0, so pts is the running time
+        dropout = dropout || now > pts + latency + s_tolerance;
+    }
+
+    if (dropout) {
+        counter->dropouts.fetchAndAddRelaxed(1);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+QGst::ElementPtr makeParticipantSrc(int index)
+{
+    QGst::ElementPtr src = QGst::ElementFactory::make("audiotestsrc");
+    src->setProperty("is-live", true);
+    src->setProperty("freq", 220.0 + 20.0 * index);
+    src->setProperty("samplesperbuffer", 480); //10 ms, like most codecs
+    return src;
+}
+
+QGst::ElementPtr makeRateFilter()
+{
+    QGst::Structure capsStruct("audio/x-raw");
+    capsStruct.setValue("format", QStringLiteral("S16LE"));
+    capsStruct.setValue("rate", 48000);
+    capsStruct.setValue("channels", 1);
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+
+    QGst::ElementPtr capsfilter = QGst::ElementFactory::make("capsfilter");
+    capsfilter->setProperty("caps", caps);
+    return capsfilter;
+}
+
+/* A remote participant: what fsconference gives us, and the controller on top of it */
+struct Participant
+{
+    QGst::ElementPtr src;
+    QGst::ElementPtr capsfilter;
+    AudioSinkController *ctrl;
+};
+
+Participant join(const QGst::PipelinePtr & pipeline, const QGst::ElementPtr & mixer, int index)
+{
+    Participant participant;
+    participant.src = makeParticipantSrc(index);
+    participant.capsfilter = makeRateFilter();
+    pipeline->add(participant.src, participant.capsfilter);
+    participant.src->link(participant.capsfilter);
+
+    //like TfAudioContentHandler::createSinkController(), before the first buffer is pushed
+    participant.ctrl = new AudioSinkController(mixer->getRequestPad("sink_%u"));
+    participant.ctrl->setSilenceSkipping(true);
+    participant.ctrl->initFromStreamingThread(participant.capsfilter->getStaticPad("src"), pipeline);
+
+    participant.capsfilter->syncStateWithParent();
+    participant.src->syncStateWithParent();
+    return participant;
+}
+
+void leave(const QGst::PipelinePtr & pipeline, const QGst::ElementPtr & mixer, Participant & participant)
+{
+    //like SinkManager::onPadUnlinked(), once fsconference has removed the stream
+    participant.src->setState(QGst::StateNull);
+    participant.capsfilter->setState(QGst::StateNull);
+    QGst::PadPtr srcPad = participant.capsfilter->getStaticPad("src");
+    srcPad->unlink(srcPad->peer());
+
+    QGst::PadPtr mixerPad = participant.ctrl->outputPad();
+    participant.ctrl->releaseFromStreamingThread(pipeline);
+    mixer->releaseRequestPad(mixerPad);
+    delete participant.ctrl;
+
+    pipeline->remove(participant.src);
+    pipeline->remove(participant.capsfilter);
+}
+
+void wait(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+/* participants x (audiotestsrc ! capsfilter ! [AudioSinkController bin]) ! mixer ! [post-mix conversion] ! fakesink,
+ * plus, if joining, one participant that joins and leaves `joins` times.
+ * Returns the dropouts, or -1 on failure */
+qint64 runConference(int participants, int joins, int intervalMs, bool joining)
+{
+    const ThreadScheduler scheduler(ThreadTopology::current());
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    BusSyncHandler::install(pipeline->bus(), &scheduler);
+
+    QGst::ElementPtr mixer = TfAudioContentHandler::makeMixer();
+    QGst::BinPtr conversion = TfAudioContentHandler::makeOutputConversionBin();
+    if (!conversion) {
+        return -1;
+    }
+    QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+    sink->setProperty("sync", true);
+    sink->setProperty("silent", true);
+
+    pipeline->add(mixer, conversion, sink);
+    if (!QGst::Element::linkMany(mixer, conversion, sink)) {
+        qWarning() << "Failed to link mixer ! conversion ! fakesink";
+        return -1;
+    }
+
+    DropoutCounter counter;
+    gst_pad_add_probe(sink->getStaticPad("sink"), GST_PAD_PROBE_TYPE_BUFFER,
+                      &onSinkBuffer, &counter, NULL);
+
+    QList<Participant> conference;
+    for (int i = 0; i < participants; ++i) {
+        conference.append(join(pipeline, mixer, i));
+    }
+
+    qint64 dropouts = -1;
+    if (pipeline->setState(QGst::StatePlaying) == QGst::StateChangeFailure) {
+        qWarning() << "Failed to start the pipeline with" << participants << "participants";
+    } else {
+        //let the pipeline settle, so that preroll and caps negotiation do not count
+        wait(500);
+
+        GstQuery *query = gst_query_new_latency();
+        if (gst_element_query(static_cast<GstElement*>(pipeline), query)) {
+            GstClockTime minLatency;
+            gst_query_parse_latency(query, NULL, &minLatency, NULL);
+            counter.latency.store(minLatency);
+        }
+        gst_query_unref(query);
+
+        if (!joining) {
+            wait(intervalMs * joins);
+        }
+        for (int i = 0; joining && i < joins; ++i) {
+            Participant participant = join(pipeline, mixer, participants);
+            wait(intervalMs / 2);
+            leave(pipeline, mixer, participant);
+            wait(intervalMs / 2);
+        }
+        dropouts = counter.dropouts.load();
+
+        QGst::MessagePtr error = pipeline->bus()->pop(QGst::MessageError);
+        if (error) {
+            qWarning() << "The pipeline posted an error:"
+                       << error.staticCast<QGst::ErrorMessage>()->error();
+            dropouts = -1;
+        }
+    }
+
+    pipeline->setState(QGst::StateNull);
+    for (int i = 0; i < conference.size(); ++i) {
+        leave(pipeline, mixer, conference[i]);
+    }
+    BusSyncHandler::uninstall(pipeline->bus());
+
+    return dropouts;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("join_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Counts the dropouts in the libktpcall conference audio while participants "
+        "join and leave, using test sources."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("participants"),
+        QStringLiteral("Participants that stay in the conference."), QStringLiteral("count"),
+        QStringLiteral("4")));
+    parser.addOption(QCommandLineOption(QStringLiteral("joins"),
+        QStringLiteral("How many times the extra participant joins and leaves."), QStringLiteral("count"),
+        QStringLiteral("20")));
+    parser.addOption(QCommandLineOption(QStringLiteral("interval"),
+        QStringLiteral("Time between two joins, in ms."), QStringLiteral("ms"),
+        QStringLiteral("500")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int participants = qMax(1, parser.value(QStringLiteral("participants")).toInt());
+    int joins = qMax(1, parser.value(QStringLiteral("joins")).toInt());
+    int intervalMs = qMax(20, parser.value(QStringLiteral("interval")).toInt());
+
+    //the baseline runs as long as the joins do
+    qint64 baseline = runConference(participants, joins, intervalMs, false);
+    qint64 dropouts = runConference(participants, joins, intervalMs, true);
+    if (baseline < 0 || dropouts < 0) {
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(12) << left << "run"
+        << qSetFieldWidth(12) << right << "joins" << "dropouts" << "per join"
+        << qSetFieldWidth(0) << endl;
+    out << qSetFieldWidth(12) << left << "baseline"
+        << qSetFieldWidth(12) << right << 0 << baseline << "-"
+        << qSetFieldWidth(0) << endl;
+    out << qSetFieldWidth(12) << left << "joining"
+        << qSetFieldWidth(12) << right << joins << dropouts
+        << QString::number(double(qMax(Q_INT64_C(0), dropouts - baseline)) / joins, 'f', 2)
+        << qSetFieldWidth(0) << endl;
+
+    return 0;
+}
@@ -0,0 +1,386 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Headless latency benchmark for the media bins that libktpcall builds.
+ *
+ * Every stage wraps one of the real bins between a live test source and an
+ * appsink. Each buffer that reaches the appsink is compared against the
+ * pipeline's running time at that moment; since live sources timestamp
+ * buffers with the running time at which they were captured, the difference
+ * is the time the buffer spent inside the bin (plus, for audio, the duration
+ * of the buffer itself). No Telepathy connection and no devices are needed.
+ */
+
+#include "../private/tf-audio-content-handler.h"
+#include "../private/tf-video-content-handler.h"
+#include "../private/sink-controllers.h"
+#include "../private/thread-topology.h"
+#include "../private/video-sink-bin.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QMutex>
+#include <QtCore/QTimer>
+#include <QtCore/QTextStream>
+#include <QtCore/QVector>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/Clock>
+#include <QGst/ElementFactory>
+#include <QGst/Fraction>
+#include <QGst/Pipeline>
+#include <QGst/Structure>
+#include <QGst/Utils/ApplicationSink>
+
+#include <gst/gst.h>
+#include <sys/resource.h>
+#include <algorithm>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+/* appsink that records, for every buffer it receives, how far
+ * the pipeline's running time is ahead of the buffer's timestamp */
+class LatencySink : public QGst::Utils::ApplicationSink
+{
+public:
+    LatencySink()
+    {
+        element()->setProperty("sync", false);
+        element()->setProperty("max-buffers", 4);
+        element()->setProperty("drop", false);
+    }
+
+    QVector<qint64> takeSamples()
+    {
+        QMutexLocker l(&m_mutex);
+        QVector<qint64> samples = m_samples;
+        m_samples.clear();
+        return samples;
+    }
+
+protected:
+    virtual QGst::FlowReturn newSample()
+    {
+        QGst::SamplePtr sample = pullSample();
+        if (!sample || !sample->buffer()) {
+            return QGst::FlowOk;
+        }
+
+        GstElement *sink = element();
+        GstClock *clock = gst_element_get_clock(sink);
+        if (!clock) {
+            return QGst::FlowOk;
+        }
+
+        GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(sink);
+        gst_object_unref(clock);
+
+        GstClockTime pts = sample->buffer()->presentationTimeStamp();
+        if (GST_CLOCK_TIME_IS_VALID(pts) && now >= pts) {
+            QMutexLocker l(&m_mutex);
+            m_samples.append(qint64(now - pts));
+        }
+        return QGst::FlowOk;
+    }
+
+private:
+    QMutex m_mutex;
+    QVector<qint64> m_samples;
+};
+
+struct StageResult
+{
+    QString name;
+    QVector<qint64> latencies;
+    qint64 wallTimeNs;
+    qint64 cpuTimeNs;
+};
+
+qint64 processCpuTimeNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+         + (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+qint64 percentile(const QVector<qint64> & sorted, int p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int index = qBound(0, (sorted.size() * p + 99) / 100 - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+QGst::ElementPtr makeAudioTestSrc()
+{
+    QGst::ElementPtr src = QGst::ElementFactory::make("audiotestsrc");
+    src->setProperty("is-live", true);
+    src->setProperty("wave", 8 /* ticks */);
+    src->setProperty("samplesperbuffer", 160);
+    return src;
+}
+
+QGst::ElementPtr makeVideoTestSrc()
+{
+    QGst::ElementPtr src = QGst::ElementFactory::make("videotestsrc");
+    src->setProperty("is-live", true);
+    src->setProperty("pattern", 18 /* ball */);
+    return src;
+}
+
+QGst::CapsPtr videoCaps(int width, int height, int framerate)
+{
+    QGst::Structure capsStruct("video/x-raw");
+    capsStruct.setValue("width", width);
+    capsStruct.setValue("height", height);
+    capsStruct.setValue("framerate", QGst::Fraction(framerate, 1));
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+    return caps;
+}
+
+/* Runs the pipeline for the given time and collects the latencies seen by sink */
+bool runPipeline(const QGst::PipelinePtr & pipeline, LatencySink & sink,
+                 int durationMs, StageResult & result)
+{
+    if (pipeline->setState(QGst::StatePlaying) == QGst::StateChangeFailure) {
+        qWarning() << "Failed to start pipeline for stage" << result.name;
+        pipeline->setState(QGst::StateNull);
+        return false;
+    }
+
+    //let the pipeline settle, so that preroll and caps negotiation do not count
+    QEventLoop loop;
+    QTimer::singleShot(500, &loop, SLOT(quit()));
+    loop.exec();
+    sink.takeSamples();
+
+    QElapsedTimer timer;
+    qint64 cpuStart = processCpuTimeNs();
+    timer.start();
+
+    QTimer::singleShot(durationMs, &loop, SLOT(quit()));
+    loop.exec();
+
+    result.cpuTimeNs = processCpuTimeNs() - cpuStart;
+    result.wallTimeNs = timer.nsecsElapsed();
+    result.latencies = sink.takeSamples();
+
+    QGst::MessagePtr error = pipeline->bus()->pop(QGst::MessageError);
+    pipeline->setState(QGst::StateNull);
+
+    if (error) {
+        qWarning() << "Stage" << result.name << "posted an error:"
+                   << error.staticCast<QGst::ErrorMessage>()->error();
+        return false;
+    }
+    return true;
+}
+
+/* audiotestsrc ! [TfAudioContentHandler src bin] ! appsink */
+bool benchAudioSource(int durationMs, StageResult & result)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    QGst::BinPtr bin = TfAudioContentHandler::makeSrcBin(makeAudioTestSrc(), QLatin1String("bench"));
+    if (!bin) {
+        return false;
+    }
+
+    LatencySink sink;
+    pipeline->add(bin, sink.element());
+    if (!bin->link(sink.element())) {
+        qWarning() << "Failed to link audio src bin ! appsink";
+        return false;
+    }
+
+    return runPipeline(pipeline, sink, durationMs, result);
+}
+
+/* audiotestsrc ! [AudioSinkController bin] ! [conference mixer] ! appsink */
+bool benchAudioSink(int durationMs, StageResult & result)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+
+    QGst::ElementPtr src = makeAudioTestSrc();
+    QGst::ElementPtr adder = TfAudioContentHandler::makeMixer();
+
+    LatencySink sink;
+    pipeline->add(src, adder, sink.element());
+    if (!adder->link(sink.element())) {
+        qWarning() << "Failed to link adder ! appsink";
+        return false;
+    }
+
+    AudioSinkController ctrl(adder->getRequestPad("sink_%u"));
+    ctrl.initFromStreamingThread(src->getStaticPad("src"), pipeline);
+
+    bool ok = runPipeline(pipeline, sink, durationMs, result);
+    ctrl.releaseFromStreamingThread(pipeline);
+    return ok;
+}
+
+/* videotestsrc ! [TfVideoContentHandler src bin] ! appsink */
+bool benchVideoSource(int durationMs, const QGst::CapsPtr & caps, StageResult & result)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    QGst::BinPtr bin = TfVideoContentHandler::makeSrcBin(makeVideoTestSrc(), QLatin1String("bench"), caps,
+                                                         ThreadTopology::current().splitsVideoCapture());
+    if (!bin) {
+        return false;
+    }
+
+    LatencySink sink;
+    pipeline->add(bin, sink.element());
+    if (!bin->link(sink.element())) {
+        qWarning() << "Failed to link video src bin ! appsink";
+        return false;
+    }
+
+    return runPipeline(pipeline, sink, durationMs, result);
+}
+
+/* videotestsrc ! [VideoSinkBin ending in appsink] */
+bool benchVideoSink(int durationMs, const QGst::CapsPtr & caps, StageResult & result)
+{
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+
+    QGst::ElementPtr src = makeVideoTestSrc();
+    QGst::ElementPtr capsfilter = QGst::ElementFactory::make("capsfilter");
+    capsfilter->setProperty("caps", caps);
+
+    LatencySink sink;
+    VideoSinkBin sinkBin(sink.element());
+
+    pipeline->add(src, capsfilter, sinkBin.bin());
+    if (!QGst::Element::linkMany(src, capsfilter, sinkBin.bin())) {
+        qWarning() << "Failed to link videotestsrc ! capsfilter ! video sink bin";
+        return false;
+    }
+
+    return runPipeline(pipeline, sink, durationMs, result);
+}
+
+void printResult(QTextStream & out, const StageResult & result)
+{
+    QVector<qint64> sorted = result.latencies;
+    std::sort(sorted.begin(), sorted.end());
+
+    double cpu = result.wallTimeNs > 0 ? 100.0 * result.cpuTimeNs / result.wallTimeNs : 0.0;
+
+    out << qSetFieldWidth(12) << left << result.name
+        << qSetFieldWidth(10) << right << sorted.size()
+        << QString::number(percentile(sorted, 50) / 1000000.0, 'f', 3)
+        << QString::number(percentile(sorted, 99) / 1000000.0, 'f', 3)
+        << QString::number(cpu, 'f', 1)
+        << qSetFieldWidth(0) << endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("latency_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Measures the latency that the libktpcall media bins add, using test sources."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("duration"),
+        QStringLiteral("Measurement time per stage, in seconds."), QStringLiteral("seconds"),
+        QStringLiteral("10")));
+    parser.addOption(QCommandLineOption(QStringLiteral("stage"),
+        QStringLiteral("Run only the given stage (audio-src, audio-sink, video-src, video-sink)."),
+        QStringLiteral("name")));
+    parser.addOption(QCommandLineOption(QStringLiteral("video-size"),
+        QStringLiteral("Video capture caps, as WIDTHxHEIGHT@FPS."), QStringLiteral("caps"),
+        QStringLiteral("320x240@15")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int durationMs = parser.value(QStringLiteral("duration")).toInt() * 1000;
+    if (durationMs <= 0) {
+        durationMs = 10000;
+    }
+
+    int width = 320, height = 240, framerate = 15;
+    QStringList size = parser.value(QStringLiteral("video-size")).split(QRegExp(QStringLiteral("[x@]")));
+    if (size.size() == 3) {
+        width = size.at(0).toInt();
+        height = size.at(1).toInt();
+        framerate = size.at(2).toInt();
+    }
+    QGst::CapsPtr caps = videoCaps(width, height, framerate);
+
+    QString onlyStage = parser.value(QStringLiteral("stage"));
+    QList<StageResult> results;
+    bool failed = false;
+
+    QStringList stages;
+    stages << QStringLiteral("audio-src") << QStringLiteral("audio-sink")
+           << QStringLiteral("video-src") << QStringLiteral("video-sink");
+
+    Q_FOREACH (const QString & stage, stages) {
+        if (!onlyStage.isEmpty() && onlyStage != stage) {
+            continue;
+        }
+
+        StageResult result;
+        result.name = stage;
+        result.wallTimeNs = 0;
+        result.cpuTimeNs = 0;
+
+        bool ok;
+        if (stage == QLatin1String("audio-src")) {
+            ok = benchAudioSource(durationMs, result);
+        } else if (stage == QLatin1String("audio-sink")) {
+            ok = benchAudioSink(durationMs, result);
+        } else if (stage == QLatin1String("video-src")) {
+            ok = benchVideoSource(durationMs, caps, result);
+        } else {
+            ok = benchVideoSink(durationMs, caps, result);
+        }
+
+        if (ok) {
+            results.append(result);
+        } else {
+            qWarning() << "Stage" << stage << "failed";
+            failed = true;
+        }
+    }
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(12) << left << "stage"
+        << qSetFieldWidth(10) << right << "buffers" << "p50(ms)" << "p99(ms)" << "cpu(%)"
+        << qSetFieldWidth(0) << endl;
+    Q_FOREACH (const StageResult & result, results) {
+        printResult(out, result);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Headless benchmark for the conference audio graph of libktpcall.
+ *
+ * For a growing number of participants, it feeds one live test source per
+ * participant through the same AudioSinkController bins, mixer and shared
+ * post-mix conversion that TfAudioContentHandler uses, into a synchronized
+ * fakesink, and reports the CPU time that the process spent. If mixing scales
+ * well, the CPU per participant stays flat as the participant count grows.
+ * Silent participants are not mixed; the share of skipped buffers is reported too.
+ */
+
+#include "../private/tf-audio-content-handler.h"
+#include "../private/sink-controllers.h"
+#include "../private/bus-sync-handler.h"
+#include "../private/thread-scheduler.h"
+#include "../private/thread-topology.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QTimer>
+#include <QtCore/QTextStream>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/ElementFactory>
+#include <QGst/Pipeline>
+#include <QGst/Structure>
+
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+struct RunResult
+{
+    int participants;
+    qint64 wallTimeNs;
+    qint64 cpuTimeNs;
+    quint64 mixerBuffers;
+    quint64 skippedBuffers;
+};
+
+qint64 processCpuTimeNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+         + (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+/* A remote participant, as it comes out of the decoder */
+QGst::ElementPtr makeParticipantSrc(int index, int rate, bool silent)
+{
+    QGst::ElementPtr src = QGst::ElementFactory::make("audiotestsrc");
+    src->setProperty("is-live", true);
+    if (silent) {
+        src->setProperty("wave", 4 /* silence */);
+    }
+    src->setProperty("freq", 220.0 + 20.0 * index);
+    src->setProperty("samplesperbuffer", rate / 100); //10 ms, like most codecs
+    return src;
+}
+
+QGst::ElementPtr makeRateFilter(int rate)
+{
+    QGst::Structure capsStruct("audio/x-raw");
+    capsStruct.setValue("format", QStringLiteral("S16LE"));
+    capsStruct.setValue("rate", rate);
+    capsStruct.setValue("channels", 1);
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+
+    QGst::ElementPtr capsfilter = QGst::ElementFactory::make("capsfilter");
+    capsfilter->setProperty("caps", caps);
+    return capsfilter;
+}
+
+/* N x (audiotestsrc ! capsfilter ! [AudioSinkController bin]) ! mixer ! [post-mix conversion] ! fakesink */
+bool runConference(int participants, int mismatchedEvery, int speakingEvery, int durationMs,
+                   RunResult & result)
+{
+    const ThreadScheduler scheduler(ThreadTopology::current());
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    //the silence detection of the controllers depends on it, like in TfChannelHandler
+    BusSyncHandler::install(pipeline->bus(), &scheduler);
+
+    QGst::ElementPtr mixer = TfAudioContentHandler::makeMixer();
+    QGst::BinPtr conversion = TfAudioContentHandler::makeOutputConversionBin();
+    if (!conversion) {
+        return false;
+    }
+    QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+    sink->setProperty("sync", true);
+    sink->setProperty("silent", true);
+
+    pipeline->add(mixer, conversion, sink);
+    if (!QGst::Element::linkMany(mixer, conversion, sink)) {
+        qWarning() << "Failed to link mixer ! conversion ! fakesink";
+        return false;
+    }
+
+    QList<AudioSinkController*> controllers;
+    for (int i = 0; i < participants; ++i) {
+        //most participants arrive at the mixer rate; some need converting
+        int rate = (mismatchedEvery > 0 && i % mismatchedEvery == mismatchedEvery - 1) ? 16000 : 48000;
+
+        //and in a real conference, most participants are listening
+        bool silent = speakingEvery > 0 && i % speakingEvery != 0;
+
+        QGst::ElementPtr src = makeParticipantSrc(i, rate, silent);
+        QGst::ElementPtr capsfilter = makeRateFilter(rate);
+        pipeline->add(src, capsfilter);
+        src->link(capsfilter);
+
+        AudioSinkController *ctrl = new AudioSinkController(mixer->getRequestPad("sink_%u"));
+        ctrl->setSilenceSkipping(true);
+        ctrl->initFromStreamingThread(capsfilter->getStaticPad("src"), pipeline);
+        controllers.append(ctrl);
+    }
+
+    bool ok = true;
+    if (pipeline->setState(QGst::StatePlaying) == QGst::StateChangeFailure) {
+        qWarning() << "Failed to start the pipeline with" << participants << "participants";
+        ok = false;
+    } else {
+        //let the pipeline settle, so that preroll and caps negotiation do not count
+        QEventLoop loop;
+        QTimer::singleShot(500, &loop, SLOT(quit()));
+        loop.exec();
+
+        QElapsedTimer timer;
+        quint64 mixerStart = 0, skippedStart = 0;
+        Q_FOREACH (AudioSinkController *ctrl, controllers) {
+            mixerStart += ctrl->mixerBufferCount();
+            skippedStart += ctrl->skippedBufferCount();
+        }
+        qint64 cpuStart = processCpuTimeNs();
+        timer.start();
+
+        QTimer::singleShot(durationMs, &loop, SLOT(quit()));
+        loop.exec();
+
+        result.cpuTimeNs = processCpuTimeNs() - cpuStart;
+        result.wallTimeNs = timer.nsecsElapsed();
+        Q_FOREACH (AudioSinkController *ctrl, controllers) {
+            result.mixerBuffers += ctrl->mixerBufferCount();
+            result.skippedBuffers += ctrl->skippedBufferCount();
+        }
+        result.mixerBuffers -= mixerStart;
+        result.skippedBuffers -= skippedStart;
+
+        QGst::MessagePtr error = pipeline->bus()->pop(QGst::MessageError);
+        if (error) {
+            qWarning() << "The pipeline with" << participants << "participants posted an error:"
+                       << error.staticCast<QGst::ErrorMessage>()->error();
+            ok = false;
+        }
+    }
+
+    pipeline->setState(QGst::StateNull);
+    Q_FOREACH (AudioSinkController *ctrl, controllers) {
+        QGst::PadPtr mixerPad = ctrl->outputPad();
+        ctrl->releaseFromStreamingThread(pipeline);
+        mixer->releaseRequestPad(mixerPad);
+        delete ctrl;
+    }
+    BusSyncHandler::uninstall(pipeline->bus());
+
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("mixing_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Measures how the CPU cost of the libktpcall conference audio graph grows "
+        "with the number of participants, using test sources."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("duration"),
+        QStringLiteral("Measurement time per participant count, in seconds."), QStringLiteral("seconds"),
+        QStringLiteral("5")));
+    parser.addOption(QCommandLineOption(QStringLiteral("max-participants"),
+        QStringLiteral("The largest conference to measure; counts double from 1."), QStringLiteral("count"),
+        QStringLiteral("16")));
+    parser.addOption(QCommandLineOption(QStringLiteral("mismatched-every"),
+        QStringLiteral("Make every Nth participant 16 kHz instead of 48 kHz (0 for none)."),
+        QStringLiteral("n"), QStringLiteral("0")));
+    parser.addOption(QCommandLineOption(QStringLiteral("speaking-every"),
+        QStringLiteral("Only every Nth participant speaks, the others are silent (0 for all speaking)."),
+        QStringLiteral("n"), QStringLiteral("0")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int durationMs = parser.value(QStringLiteral("duration")).toInt() * 1000;
+    if (durationMs <= 0) {
+        durationMs = 5000;
+    }
+    int maxParticipants = qMax(1, parser.value(QStringLiteral("max-participants")).toInt());
+    int mismatchedEvery = qMax(0, parser.value(QStringLiteral("mismatched-every")).toInt());
+    int speakingEvery = qMax(0, parser.value(QStringLiteral("speaking-every")).toInt());
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(14) << left << "participants"
+        << qSetFieldWidth(12) << right << "cpu(%)" << "cpu/part(%)" << "skipped(%)"
+        << qSetFieldWidth(0) << endl;
+
+    bool failed = false;
+    for (int participants = 1; participants <= maxParticipants; participants *= 2) {
+        RunResult result;
+        result.participants = participants;
+        result.wallTimeNs = 0;
+        result.cpuTimeNs = 0;
+        result.mixerBuffers = 0;
+        result.skippedBuffers = 0;
+
+        if (!runConference(participants, mismatchedEvery, speakingEvery, durationMs, result)) {
+            failed = true;
+            continue;
+        }
+
+        double cpu = result.wallTimeNs > 0 ? 100.0 * result.cpuTimeNs / result.wallTimeNs : 0.0;
+        double skipped = result.mixerBuffers > 0
+                ? 100.0 * result.skippedBuffers / result.mixerBuffers : 0.0;
+        out << qSetFieldWidth(14) << left << participants
+            << qSetFieldWidth(12) << right
+            << QString::number(cpu, 'f', 2)
+            << QString::number(cpu / participants, 'f', 3)
+            << QString::number(skipped, 'f', 1)
+            << qSetFieldWidth(0) << endl;
+    }
+
+    return failed ? 1 : 0;
+}
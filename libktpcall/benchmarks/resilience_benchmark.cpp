@@ -0,0 +1,207 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Offline benchmark for the audio loss adaptation of libktpcall.
+ *
+ * An Opus stream is sent over a simulated network with bursty loss (a
+ * Gilbert-Elliott channel) that goes through a clean, a lossy Wi-Fi, a congested
+ * and a recovered phase. Every RTCP interval, the loss and jitter of that interval
+ * go through AudioResiliencePolicy, like the receiver reports do in a call. A lost
+ * packet is recovered when FEC is on and the next packet arrives. For each phase,
+ * the audio that stayed lost and the bandwidth on the wire are compared with
+ * never and always using FEC.
+ */
+
+#include "../private/audio-resilience.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QTextStream>
+
+#include <stdlib.h>
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+static const int s_rtcpInterval = 5000; //ms
+static const int s_channelTick = 20; //ms, how often the channel can change its state
+static const int s_headerBytes = 40; //IPv4 + UDP + RTP
+static const int s_baseBitrate = 32000;
+
+struct Phase
+{
+    const char *name;
+    int seconds;
+    double goodToBad; //per tick
+    double badToGood;
+    double badLoss; //the good state loses nothing
+    int jitterMs;
+};
+
+static const Phase s_phases[] = {
+    { "clean", 60, 0.0005, 0.5, 0.5, 4 },
+    { "wifi", 60, 0.02, 0.3, 0.6, 20 },
+    { "congested", 30, 0.05, 0.2, 0.8, 60 },
+    { "recovered", 60, 0.0005, 0.5, 0.5, 4 }
+};
+static const int s_phaseCount = sizeof(s_phases) / sizeof(s_phases[0]);
+
+enum Strategy {
+    Adaptive,
+    NeverFec,
+    AlwaysFec
+};
+
+struct PhaseResult
+{
+    PhaseResult() : sentMs(0), lostMs(0), bits(0), fecReports(0), reports(0) {}
+
+    qint64 sentMs;
+    qint64 lostMs; //audio that neither the packet nor the FEC in the next one delivered
+    qint64 bits;
+    int fecReports;
+    int reports;
+};
+
+double random01()
+{
+    return double(rand()) / RAND_MAX;
+}
+
+AudioResiliencePolicy::Settings fixedSettings(Strategy strategy)
+{
+    AudioResiliencePolicy::Settings settings;
+    settings.fec = strategy == AlwaysFec;
+    settings.expectedLoss = settings.fec ? 10 : 0;
+    settings.packetTime = 20;
+    //the FEC share on top, so that the primary stream sounds like without FEC
+    settings.bitrate = settings.fec ? s_baseBitrate * 6 / 5 : s_baseBitrate;
+    return settings;
+}
+
+QList<PhaseResult> simulate(Strategy strategy, unsigned int seed, bool verbose, QTextStream & out)
+{
+    srand(seed);
+
+    AudioResiliencePolicy policy(s_baseBitrate, 20);
+    AudioResiliencePolicy::Settings settings = strategy == Adaptive ? policy.settings() : fixedSettings(strategy);
+
+    QList<PhaseResult> results;
+    bool bad = false;
+    bool previousLost = false;
+    bool previousFec = false;
+    int previousPacketTime = 0;
+
+    for (int p = 0; p < s_phaseCount; ++p) {
+        const Phase & phase = s_phases[p];
+        PhaseResult result;
+
+        int intervalPackets = 0;
+        int intervalLost = 0;
+        int intervalMs = 0;
+        for (int t = 0; t < phase.seconds * 1000; t += settings.packetTime) {
+            for (int tick = 0; tick < qMax(1, settings.packetTime / s_channelTick); ++tick) {
+                bad = bad ? random01() >= phase.badToGood : random01() < phase.goodToBad;
+            }
+            bool lost = bad && random01() < phase.badLoss;
+
+            //the FEC in this packet carries the previous one
+            if (previousLost && !(previousFec && !lost)) {
+                result.lostMs += previousPacketTime;
+            }
+            previousLost = lost;
+            previousFec = settings.fec;
+            previousPacketTime = settings.packetTime;
+
+            result.sentMs += settings.packetTime;
+            result.bits += qint64(settings.bitrate) * settings.packetTime / 1000 + s_headerBytes * 8;
+            ++intervalPackets;
+            intervalLost += lost;
+
+            intervalMs += settings.packetTime;
+            if (intervalMs < s_rtcpInterval) {
+                continue;
+            }
+
+            //a receiver report
+            double fractionLost = double(intervalLost) / intervalPackets;
+            if (strategy == Adaptive && policy.update(fractionLost, phase.jitterMs)) {
+                settings = policy.settings();
+            }
+            if (verbose && strategy == Adaptive) {
+                out << phase.name << ": loss " << QString::number(fractionLost * 100, 'f', 1)
+                    << "% -> FEC " << (settings.fec ? "on" : "off") << ", " << settings.packetTime
+                    << " ms packets, " << settings.bitrate << " bps" << endl;
+            }
+            result.fecReports += settings.fec;
+            ++result.reports;
+            intervalPackets = 0;
+            intervalLost = 0;
+            intervalMs = 0;
+        }
+        results.append(result);
+    }
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("resilience_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Runs the libktpcall audio loss adaptation against a simulated lossy network "
+        "and compares it with never and always using Opus FEC."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("seed"),
+        QStringLiteral("Seed of the simulated loss."), QStringLiteral("seed"), QStringLiteral("1")));
+    parser.addOption(QCommandLineOption(QStringLiteral("verbose"),
+        QStringLiteral("Print every decision of the adaptation.")));
+    parser.process(app);
+
+    unsigned int seed = parser.value(QStringLiteral("seed")).toUInt();
+    bool verbose = parser.isSet(QStringLiteral("verbose"));
+
+    QTextStream out(stdout);
+    const char *strategyNames[] = { "adaptive", "never FEC", "always FEC" };
+    QList<PhaseResult> results[3];
+    for (int s = Adaptive; s <= AlwaysFec; ++s) {
+        results[s] = simulate(Strategy(s), seed, verbose, out);
+    }
+
+    out << qSetFieldWidth(12) << left << "phase" << qSetFieldWidth(14) << "strategy"
+        << qSetFieldWidth(12) << right << "lost %" << "kbps" << "FEC on %"
+        << qSetFieldWidth(0) << endl;
+    for (int p = 0; p < s_phaseCount; ++p) {
+        for (int s = Adaptive; s <= AlwaysFec; ++s) {
+            const PhaseResult & result = results[s].at(p);
+            out << qSetFieldWidth(12) << left << s_phases[p].name << qSetFieldWidth(14) << strategyNames[s]
+                << qSetFieldWidth(12) << right
+                << QString::number(100.0 * result.lostMs / result.sentMs, 'f', 2)
+                << QString::number(double(result.bits) / result.sentMs, 'f', 1)
+                << QString::number(result.reports ? 100.0 * result.fecReports / result.reports : 0.0, 'f', 0)
+                << qSetFieldWidth(0) << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,441 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Benchmark for the streaming-thread topology of libktpcall on 2, 4 and 8 CPUs.
+ *
+ * A video call is built from the same capture bin and render bins that
+ * TfVideoContentHandler uses: a live test camera is encoded once and decoded and
+ * rendered for every remote participant, while a live audio source plays into
+ * a synchronized sink next to it. The process is restricted to the first N CPUs
+ * and the call runs twice, once with the threads left where the kernel puts them
+ * and once pinned by ThreadTopology. For each run, the rendered frame rate, the
+ * CPU load and the audio buffers that reached their sink late are reported.
+ */
+
+#include "../private/tf-video-content-handler.h"
+#include "../private/video-sink-bin.h"
+#include "../private/thread-scheduler.h"
+#include "../private/thread-topology.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QTimer>
+#include <QtCore/QTextStream>
+
+#include <QGst/Init>
+#include <QGst/Bus>
+#include <QGst/Caps>
+#include <QGst/ElementFactory>
+#include <QGst/Pipeline>
+
+#include <gst/gst.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+# include <sched.h>
+#endif
+
+using namespace KTpCallPrivate;
+
+namespace {
+
+//an audio buffer this much after its time has been heard late
+static const GstClockTime s_audioTolerance = 5 * GST_MSECOND;
+
+struct Codec
+{
+    const char *encoder;
+    const char *parser;
+    const char *decoder;
+};
+
+//in order of preference; jpeg is always there, but light on the CPU
+static const Codec s_codecs[] = {
+    { "vp8enc", NULL, "vp8dec" },
+    { "x264enc", "h264parse", "avdec_h264" },
+    { "jpegenc", NULL, "jpegdec" }
+};
+
+struct RunResult
+{
+    int cpus;
+    bool planned;
+    double fps;
+    double cpuLoad;
+    quint64 audioBuffers;
+    quint64 lateAudioBuffers;
+};
+
+/* What the streaming threads of one run may use, and whether they follow the plan */
+struct ThreadPolicy
+{
+    QList<int> cpus;
+    bool planned;
+    const ThreadScheduler *scheduler;
+};
+
+struct Counters
+{
+    Counters() : frames(0), audioBuffers(0), lateAudioBuffers(0), audioLatency(GST_CLOCK_TIME_NONE) {}
+
+    QAtomicInteger<quint64> frames;
+    QAtomicInteger<quint64> audioBuffers;
+    QAtomicInteger<quint64> lateAudioBuffers;
+    QAtomicInteger<quint64> audioLatency;
+};
+
+qint64 processCpuTimeNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+         + (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+QList<int> allowedCpus()
+{
+    QList<int> cpus;
+#ifdef Q_OS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+bool restrictCurrentThread(const QList<int> & cpus)
+{
+#ifdef Q_OS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    Q_FOREACH (int cpu, cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    Q_UNUSED(cpus);
+    return false;
+#endif
+}
+
+GstBusSyncReply onBusSyncMessage(GstBus *bus, GstMessage *message, gpointer data)
+{
+    Q_UNUSED(bus);
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS) {
+        const ThreadPolicy *policy = static_cast<const ThreadPolicy*>(data);
+        //pooled threads may still be pinned from the previous run
+        restrictCurrentThread(policy->cpus);
+        if (policy->planned) {
+            policy->scheduler->handleStreamStatus(message);
+        }
+    }
+    return GST_BUS_PASS;
+}
+
+GstPadProbeReturn onFrame(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    static_cast<Counters*>(data)->frames.fetchAndAddRelaxed(1);
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn onAudioBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Counters *counters = static_cast<Counters*>(data);
+    GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    GstClockTime latency = counters->audioLatency.load();
+    if (!GST_CLOCK_TIME_IS_VALID(pts) || !GST_CLOCK_TIME_IS_VALID(latency)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstElement *sink = GST_ELEMENT(gst_pad_get_parent(pad));
+    GstClock *clock = gst_element_get_clock(sink);
+    GstClockTime baseTime = gst_element_get_base_time(sink);
+    gst_object_unref(sink);
+    if (!clock) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    //the live source starts its segment at 0, so pts is the running time
+    GstClockTime now = gst_clock_get_time(clock) - baseTime;
+    gst_object_unref(clock);
+    counters->audioBuffers.fetchAndAddRelaxed(1);
+    if (now > pts + latency + s_audioTolerance) {
+        counters->lateAudioBuffers.fetchAndAddRelaxed(1);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+QGst::ElementPtr makeElement(const char *factory)
+{
+    return factory ? QGst::ElementFactory::make(factory) : QGst::ElementPtr();
+}
+
+const Codec *findCodec()
+{
+    for (uint i = 0; i < sizeof(s_codecs) / sizeof(s_codecs[0]); ++i) {
+        if (makeElement(s_codecs[i].encoder) && makeElement(s_codecs[i].decoder)
+                && (!s_codecs[i].parser || makeElement(s_codecs[i].parser))) {
+            return &s_codecs[i];
+        }
+    }
+    return NULL;
+}
+
+QGst::ElementPtr makeEncoder(const Codec *codec)
+{
+    QGst::ElementPtr encoder = QGst::ElementFactory::make(codec->encoder);
+    GObject *object = G_OBJECT(static_cast<GstElement*>(encoder));
+    //like a call: encode in real time, not for quality
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), "deadline")) {
+        gst_util_set_object_arg(object, "deadline", "1");
+    }
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), "tune")) {
+        gst_util_set_object_arg(object, "tune", "zerolatency");
+    }
+    return encoder;
+}
+
+void wait(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+/* videotestsrc ! [capture bin] ! encoder ! tee, then for every participant
+ * tee ! queue ! (parser) ! decoder ! [render bin with a synchronized fakesink],
+ * next to audiotestsrc ! queue ! fakesink. Returns false on failure */
+bool runCall(const Codec *codec, const ThreadPolicy & policy, int participants, int seconds,
+             RunResult *result)
+{
+    //streaming threads are started by the main thread, or by threads that it started
+    restrictCurrentThread(policy.cpus);
+    //pinning is off by default in a call; this benchmark measures what it gives
+    ThreadTopology topology = ThreadTopology::current();
+    topology.setPinningEnabled(true);
+    const ThreadScheduler scheduler(topology);
+    ThreadPolicy runPolicy = policy;
+    runPolicy.scheduler = &scheduler;
+
+    QGst::PipelinePtr pipeline = QGst::Pipeline::create();
+    gst_bus_set_sync_handler(static_cast<GstBus*>(pipeline->bus()), &onBusSyncMessage,
+                             &runPolicy, NULL);
+
+    QGst::ElementPtr camera = QGst::ElementFactory::make("videotestsrc");
+    camera->setProperty("is-live", true);
+    camera->setProperty("pattern", 18 /* ball */);
+    QGst::CapsPtr caps = QGst::Caps::fromString(QStringLiteral(
+            "video/x-raw, width=(int)1280, height=(int)720, framerate=(fraction)15/1"));
+    QGst::BinPtr srcBin = TfVideoContentHandler::makeSrcBin(camera, QStringLiteral("benchmark"), caps,
+                                                            topology.splitsVideoCapture());
+    if (!srcBin) {
+        qWarning() << "Failed to create the video capture bin";
+        return false;
+    }
+    ThreadScheduler::tag(srcBin, ThreadScheduler::VideoMedia);
+
+    QGst::ElementPtr encoder = makeEncoder(codec);
+    QGst::ElementPtr tee = QGst::ElementFactory::make("tee");
+    pipeline->add(srcBin, encoder, tee);
+    if (!QGst::Element::linkMany(srcBin, encoder, tee)) {
+        qWarning() << "Failed to link the capture bin !" << codec->encoder << "! tee";
+        return false;
+    }
+
+    Counters counters;
+    QList<VideoSinkBin*> renderBins;
+    for (int i = 0; i < participants; ++i) {
+        //like the thread of the fsconference jitterbuffer
+        QGst::ElementPtr queue = ThreadTopology::makeQueue(ThreadTopology::DecodeStage, ThreadScheduler::VideoMedia);
+        QGst::ElementPtr parser = makeElement(codec->parser);
+        QGst::ElementPtr decoder = QGst::ElementFactory::make(codec->decoder);
+        QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+        sink->setProperty("sync", true);
+        sink->setProperty("silent", true);
+        gst_pad_add_probe(sink->getStaticPad("sink"), GST_PAD_PROBE_TYPE_BUFFER, &onFrame, &counters, NULL);
+
+        VideoSinkBin *renderBin = new VideoSinkBin(sink);
+        renderBins.append(renderBin);
+
+        pipeline->add(queue, decoder, renderBin->bin());
+        bool linked;
+        if (parser) {
+            pipeline->add(parser);
+            linked = QGst::Element::linkMany(queue, parser, decoder, renderBin->bin());
+        } else {
+            linked = QGst::Element::linkMany(queue, decoder, renderBin->bin());
+        }
+        if (!linked || tee->getRequestPad("src_%u")->link(queue->getStaticPad("sink")) != QGst::PadLinkOk) {
+            qWarning() << "Failed to link the render branch of participant" << i;
+            qDeleteAll(renderBins);
+            return false;
+        }
+    }
+
+    QGst::ElementPtr microphone = QGst::ElementFactory::make("audiotestsrc");
+    microphone->setProperty("is-live", true);
+    microphone->setProperty("samplesperbuffer", 480); //10 ms at 48 kHz
+    QGst::ElementPtr audioQueue = ThreadTopology::makeQueue(ThreadTopology::EncodeStage, ThreadScheduler::AudioMedia);
+    QGst::ElementPtr audioSink = QGst::ElementFactory::make("fakesink");
+    audioSink->setProperty("sync", true);
+    audioSink->setProperty("silent", true);
+    pipeline->add(microphone, audioQueue, audioSink);
+    if (!QGst::Element::linkMany(microphone, audioQueue, audioSink)) {
+        qWarning() << "Failed to link audiotestsrc ! queue ! fakesink";
+        qDeleteAll(renderBins);
+        return false;
+    }
+    gst_pad_add_probe(audioSink->getStaticPad("sink"), GST_PAD_PROBE_TYPE_BUFFER,
+                      &onAudioBuffer, &counters, NULL);
+
+    bool ok = false;
+    if (pipeline->setState(QGst::StatePlaying) == QGst::StateChangeFailure) {
+        qWarning() << "Failed to start the call on" << policy.cpus.size() << "CPUs";
+    } else {
+        //let the pipeline settle, so that preroll and caps negotiation do not count
+        wait(1000);
+
+        GstQuery *query = gst_query_new_latency();
+        if (gst_element_query(static_cast<GstElement*>(pipeline), query)) {
+            GstClockTime minLatency;
+            gst_query_parse_latency(query, NULL, &minLatency, NULL);
+            counters.audioLatency.store(minLatency);
+        }
+        gst_query_unref(query);
+
+        quint64 frames = counters.frames.load();
+        qint64 cpuTime = processCpuTimeNs();
+        QElapsedTimer timer;
+        timer.start();
+
+        wait(seconds * 1000);
+
+        qint64 wallTime = timer.nsecsElapsed();
+        result->cpus = policy.cpus.size();
+        result->planned = policy.planned;
+        result->fps = double(counters.frames.load() - frames) / participants / (wallTime / 1e9);
+        result->cpuLoad = 100.0 * (processCpuTimeNs() - cpuTime) / wallTime / policy.cpus.size();
+        result->audioBuffers = counters.audioBuffers.load();
+        result->lateAudioBuffers = counters.lateAudioBuffers.load();
+
+        QGst::MessagePtr error = pipeline->bus()->pop(QGst::MessageError);
+        if (error) {
+            qWarning() << "The pipeline posted an error:"
+                       << error.staticCast<QGst::ErrorMessage>()->error();
+        } else {
+            ok = true;
+        }
+    }
+
+    pipeline->setState(QGst::StateNull);
+    gst_bus_set_sync_handler(static_cast<GstBus*>(pipeline->bus()), NULL, NULL, NULL);
+    qDeleteAll(renderBins);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("topology_benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Compares a libktpcall video call on 2, 4 and 8 CPUs with and without "
+        "the planned streaming-thread topology, using test sources."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("participants"),
+        QStringLiteral("Remote participants whose video is decoded and rendered."), QStringLiteral("count"),
+        QStringLiteral("4")));
+    parser.addOption(QCommandLineOption(QStringLiteral("duration"),
+        QStringLiteral("Duration of each run, in seconds."), QStringLiteral("seconds"),
+        QStringLiteral("10")));
+    parser.addOption(QCommandLineOption(QStringLiteral("no-plan"),
+        QStringLiteral("Only run with the threads left where the kernel puts them.")));
+    parser.process(app);
+
+    QGst::init(&argc, &argv);
+
+    int participants = qMax(1, parser.value(QStringLiteral("participants")).toInt());
+    int seconds = qMax(1, parser.value(QStringLiteral("duration")).toInt());
+    bool noPlan = parser.isSet(QStringLiteral("no-plan"));
+
+    const Codec *codec = findCodec();
+    if (!codec) {
+        qWarning() << "No video encoder and decoder available";
+        return 1;
+    }
+
+    QList<int> available = allowedCpus();
+    if (available.size() < 2) {
+        qWarning() << "Thread pinning can only be measured on 2 or more CPUs";
+        return 1;
+    }
+
+    QList<RunResult> results;
+    const int cpuCounts[] = { 2, 4, 8 };
+    for (uint i = 0; i < sizeof(cpuCounts) / sizeof(cpuCounts[0]); ++i) {
+        if (cpuCounts[i] > available.size()) {
+            qWarning() << "Skipping" << cpuCounts[i] << "CPUs, only" << available.size() << "are available";
+            continue;
+        }
+
+        for (int planned = 0; planned <= (noPlan ? 0 : 1); ++planned) {
+            ThreadPolicy policy;
+            policy.cpus = available.mid(0, cpuCounts[i]);
+            policy.planned = planned;
+            policy.scheduler = NULL;
+
+            RunResult result;
+            if (!runCall(codec, policy, participants, seconds, &result)) {
+                return 1;
+            }
+            results.append(result);
+        }
+    }
+    restrictCurrentThread(available);
+
+    QTextStream out(stdout);
+    out << "codec: " << codec->encoder << ", participants: " << participants << endl;
+    out << qSetFieldWidth(8) << left << "cpus" << qSetFieldWidth(12) << "threads"
+        << qSetFieldWidth(12) << right << "fps" << "cpu %" << "audio late"
+        << qSetFieldWidth(0) << endl;
+    Q_FOREACH (const RunResult & result, results) {
+        out << qSetFieldWidth(8) << left << result.cpus
+            << qSetFieldWidth(12) << (result.planned ? "planned" : "unpinned")
+            << qSetFieldWidth(12) << right
+            << QString::number(result.fps, 'f', 1)
+            << QString::number(result.cpuLoad, 'f', 1)
+            << QStringLiteral("%1/%2").arg(result.lateAudioBuffers).arg(result.audioBuffers)
+            << qSetFieldWidth(0) << endl;
+    }
+
+    return 0;
+}
@@ -62,6 +62,9 @@ Tp::Contacts CallContentHandler::remoteMembers() const
 AudioContentHandler::AudioContentHandler(TfAudioContentHandler *handler, QObject *parent)
     : CallContentHandler(handler, parent)
 {
+    connect(handler, SIGNAL(activeSpeakerChanged(Tp::ContactPtr)),
+            this, SIGNAL(activeSpeakerChanged(Tp::ContactPtr)));
+    connect(handler, SIGNAL(latencyChanged()), this, SIGNAL(latencyChanged()));
 }
 
 VolumeController *AudioContentHandler::inputVolumeControl() const
@@ -74,6 +77,41 @@ VolumeController *AudioContentHandler::outputVolumeControl() const
     return static_cast<TfAudioContentHandler*>(d->contentHandler)->outputVolumeController();
 }
 
+MuteController *AudioContentHandler::inputMuteControl() const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->inputMuteController();
+}
+
+LevelController *AudioContentHandler::inputLevelControl() const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->inputLevelController();
+}
+
+LevelController *AudioContentHandler::remoteMemberLevelControl(const Tp::ContactPtr & contact) const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->remoteMemberLevelController(contact);
+}
+
+Tp::ContactPtr AudioContentHandler::activeSpeaker() const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->activeSpeaker();
+}
+
+int AudioContentHandler::inputLatency() const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->inputLatency();
+}
+
+int AudioContentHandler::outputLatency() const
+{
+    return static_cast<TfAudioContentHandler*>(d->contentHandler)->outputLatency();
+}
+
+void AudioContentHandler::mixerStatistics(quint64 *mixerBuffers, quint64 *skippedBuffers) const
+{
+    static_cast<TfAudioContentHandler*>(d->contentHandler)->mixerStatistics(mixerBuffers, skippedBuffers);
+}
+
 //END AudioContentHandler
 //BEGIN VideoContentHandler
 
@@ -82,9 +120,10 @@ VideoContentHandler::VideoContentHandler(TfVideoContentHandler *handler, QObject
 {
 }
 
-void VideoContentHandler::linkVideoPreviewSink(const QGst::ElementPtr & sink)
+void VideoContentHandler::linkVideoPreviewSink(const QGst::ElementPtr & sink, SinkFlags flags)
 {
-    static_cast<TfVideoContentHandler*>(d->contentHandler)->linkVideoPreviewSink(sink);
+    static_cast<TfVideoContentHandler*>(d->contentHandler)->linkVideoPreviewSink(sink,
+            !flags.testFlag(SinkMirrors));
 }
 
 void VideoContentHandler::unlinkVideoPreviewSink()
@@ -93,11 +132,11 @@ void VideoContentHandler::unlinkVideoPreviewSink()
 }
 
 void VideoContentHandler::linkRemoteMemberVideoSink(const Tp::ContactPtr & contact,
-                                                    const QGst::ElementPtr & sink)
+                                                    const QGst::ElementPtr & sink, SinkFlags flags)
 {
     BaseSinkController *ctrl = d->contentHandler->sinkController(contact);
     if (ctrl) {
-        static_cast<VideoSinkController*>(ctrl)->linkVideoSink(sink);
+        static_cast<VideoSinkController*>(ctrl)->linkVideoSink(sink, !flags.testFlag(SinkMirrors));
     }
 }
 
@@ -20,6 +20,8 @@
 #define CALL_CONTENT_HANDLER_H
 
 #include "volume-controller.h"
+#include "level-controller.h"
+#include "mute-controller.h"
 #include <TelepathyQt/CallContent>
 
 class CallChannelHandler;
@@ -71,6 +73,45 @@ public:
     VolumeController *inputVolumeControl() const;
     VolumeController *outputVolumeControl() const;
 
+    /**
+     * \returns the controller that mutes the microphone at the capture source.
+     * Prefer this over muting inputVolumeControl(), which keeps encoding and sending silence.
+     */
+    MuteController *inputMuteControl() const;
+
+    /** \returns the level of the local microphone */
+    LevelController *inputLevelControl() const;
+
+    /**
+     * \returns the level of the audio received from \a contact,
+     * or 0 if the contact is not a remote member
+     */
+    LevelController *remoteMemberLevelControl(const Tp::ContactPtr & contact) const;
+
+    /** \returns the remote member that is currently speaking, or a null pointer */
+    Tp::ContactPtr activeSpeaker() const;
+
+    /**
+     * \returns the audio that the capture device buffers, in ms,
+     * or 0 if it is not known. The buffer grows and shrinks during the call
+     * as the device overruns or runs clean.
+     */
+    int inputLatency() const;
+
+    /** \returns the audio that the playback device buffers, in ms, or 0 if it is not known */
+    int outputLatency() const;
+
+    /**
+     * Gives how many buffers of remote audio have reached the mixer during the call
+     * in \a mixerBuffers, and in \a skippedBuffers how many of them were from
+     * silent participants and were left out of the mix.
+     */
+    void mixerStatistics(quint64 *mixerBuffers, quint64 *skippedBuffers) const;
+
+Q_SIGNALS:
+    void activeSpeakerChanged(const Tp::ContactPtr & contact);
+    void latencyChanged();
+
 private:
     friend class CallChannelHandler;
     AudioContentHandler(KTpCallPrivate::TfAudioContentHandler *handler, QObject *parent);
@@ -82,9 +123,24 @@ class VideoContentHandler : public CallContentHandler
 {
     Q_OBJECT
 public:
-    void linkVideoPreviewSink(const QGst::ElementPtr & sink);
+    enum SinkFlag {
+        NoSinkFlags = 0x0,
+        /**
+         * The sink shows the picture mirrored itself, e.g. with a transform
+         * on the item that renders it, so it is not mirrored on the CPU
+         */
+        SinkMirrors = 0x1
+    };
+    Q_DECLARE_FLAGS(SinkFlags, SinkFlag)
+
+    /**
+     * Links a sink that shows the video mirrored horizontally. Sinks that take the
+     * video in the format and size it comes in cost no CPU for conversion or scaling.
+     */
+    void linkVideoPreviewSink(const QGst::ElementPtr & sink, SinkFlags flags = NoSinkFlags);
     void unlinkVideoPreviewSink();
-    void linkRemoteMemberVideoSink(const Tp::ContactPtr & contact, const QGst::ElementPtr & sink);
+    void linkRemoteMemberVideoSink(const Tp::ContactPtr & contact, const QGst::ElementPtr & sink,
+                                   SinkFlags flags = NoSinkFlags);
     void unlinkRemoteMemberVideoSink(const Tp::ContactPtr & contact);
 
 private:
@@ -93,4 +149,6 @@ private:
     virtual ~VideoContentHandler() {}
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(VideoContentHandler::SinkFlags)
+
 #endif // CALL_CONTENT_HANDLER_H
@@ -0,0 +1,125 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "level-controller.h"
+#include "private/level-filter.h"
+#include <QtCore/QTimer>
+
+using namespace KTpCallPrivate;
+
+static const double s_silence = -700.0;
+
+LevelController::LevelController(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this)),
+      m_rms(s_silence),
+      m_peak(s_silence)
+{
+    m_timer->setInterval(100);
+    connect(m_timer, SIGNAL(timeout()), SLOT(update()));
+}
+
+LevelController::~LevelController()
+{
+    setElement(QGst::ElementPtr());
+}
+
+bool LevelController::levelSupported() const
+{
+    return m_level;
+}
+
+double LevelController::rms() const
+{
+    return m_rms;
+}
+
+double LevelController::peak() const
+{
+    return m_peak;
+}
+
+int LevelController::updateInterval() const
+{
+    return m_timer->interval();
+}
+
+void LevelController::setUpdateInterval(int msec)
+{
+    m_timer->setInterval(msec);
+    if (m_level) {
+        applyInterval();
+    }
+}
+
+QGst::ElementPtr LevelController::element() const
+{
+    return m_level;
+}
+
+void LevelController::setElement(const QGst::ElementPtr & levelElement)
+{
+    bool emitChanged = (!m_level && levelElement) || (m_level && !levelElement);
+
+    if (m_level) {
+        LevelFilter::detach(m_level);
+        m_state.clear();
+        m_timer->stop();
+    }
+
+    m_level = levelElement;
+    m_rms = s_silence;
+    m_peak = s_silence;
+
+    if (m_level) {
+        m_state = LevelFilter::attach(m_level);
+        applyInterval();
+        m_level->setProperty("post-messages", true);
+        m_timer->start();
+    }
+
+    if (emitChanged) {
+        Q_EMIT levelSupportedChanged(levelSupported());
+        Q_EMIT levelChanged(m_rms, m_peak);
+    }
+}
+
+void LevelController::applyInterval()
+{
+    //there is no point in measuring more often than we report, but the
+    //element may already measure faster for someone else, e.g. the mixer
+    quint64 interval = quint64(m_timer->interval()) * 1000000;
+    if (!LevelFilter::isShared(m_level) || m_level->property("interval").get<quint64>() > interval) {
+        m_level->setProperty("interval", interval);
+    }
+}
+
+void LevelController::update()
+{
+    {
+        QMutexLocker l(&m_state->mutex);
+        if (!m_state->fresh) {
+            return;
+        }
+        m_rms = m_state->rms;
+        m_peak = m_state->peak;
+        m_state->fresh = false;
+    }
+
+    Q_EMIT levelChanged(m_rms, m_peak);
+}
+
+#include "moc_level-controller.cpp"
@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LEVEL_CONTROLLER_H
+#define LEVEL_CONTROLLER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QGst/Element>
+
+class QTimer;
+
+namespace KTpCallPrivate {
+    struct LevelState;
+}
+
+/**
+ * Reports the audio level measured by a gstreamer "level" element.
+ * Levels are in dB relative to full scale (0 is the loudest possible)
+ * and are reported at most once per update interval.
+ */
+class LevelController : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool levelSupported READ levelSupported NOTIFY levelSupportedChanged)
+    Q_PROPERTY(double rms READ rms NOTIFY levelChanged)
+    Q_PROPERTY(double peak READ peak NOTIFY levelChanged)
+public:
+    LevelController(QObject *parent = 0);
+    virtual ~LevelController();
+
+    bool levelSupported() const;
+    double rms() const;
+    double peak() const;
+
+    /** The interval in ms at which levelChanged() is emitted. Defaults to 100 */
+    int updateInterval() const;
+    void setUpdateInterval(int msec);
+
+    QGst::ElementPtr element() const;
+    void setElement(const QGst::ElementPtr & levelElement);
+
+Q_SIGNALS:
+    void levelSupportedChanged(bool isSupported);
+    void levelChanged(double rms, double peak);
+
+private Q_SLOTS:
+    void update();
+
+private:
+    void applyInterval();
+
+    QGst::ElementPtr m_level;
+    QSharedPointer<KTpCallPrivate::LevelState> m_state;
+    QTimer *m_timer;
+    double m_rms;
+    double m_peak;
+};
+
+#endif // LEVEL_CONTROLLER_H
@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "mute-controller.h"
+
+MuteController::MuteController(QObject *parent)
+    : QObject(parent),
+      m_muted(false)
+{
+}
+
+MuteController::~MuteController()
+{
+}
+
+bool MuteController::muteControlSupported() const
+{
+    return m_valve;
+}
+
+bool MuteController::isMuted() const
+{
+    return m_muted;
+}
+
+void MuteController::setMuted(bool muted)
+{
+    if (m_muted != muted) {
+        m_muted = muted;
+        updateValve();
+        Q_EMIT mutedChanged(m_muted);
+    }
+}
+
+QGst::ElementPtr MuteController::element() const
+{
+    return m_valve;
+}
+
+void MuteController::setElement(const QGst::ElementPtr & valveElement)
+{
+    bool emitChanged = (!m_valve && valveElement) || (m_valve && !valveElement);
+
+    m_valve = valveElement;
+    updateValve();
+
+    if (emitChanged) {
+        Q_EMIT muteControlSupportedChanged(muteControlSupported());
+    }
+}
+
+void MuteController::updateValve()
+{
+    if (m_valve) {
+        //the valve keeps the sticky events (caps, segment) and resends them
+        //when it opens again, so no renegotiation happens on unmute
+        m_valve->setProperty("drop", m_muted);
+    }
+}
+
+#include "moc_mute-controller.cpp"
@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MUTE_CONTROLLER_H
+#define MUTE_CONTROLLER_H
+
+#include <QtCore/QObject>
+#include <QGst/Element>
+
+/**
+ * Mutes a stream by closing a gstreamer "valve" element at the head of it.
+ * Unlike VolumeController::setMuted(), nothing downstream of the valve
+ * (conversion, encoding, sending) runs while the stream is muted.
+ *
+ * The state is kept by the controller, so it survives a change of element.
+ */
+class MuteController : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool muteControlSupported READ muteControlSupported
+                                         NOTIFY muteControlSupportedChanged)
+    Q_PROPERTY(bool muted READ isMuted WRITE setMuted NOTIFY mutedChanged)
+public:
+    MuteController(QObject *parent = 0);
+    virtual ~MuteController();
+
+    bool muteControlSupported() const;
+    bool isMuted() const;
+
+    QGst::ElementPtr element() const;
+    void setElement(const QGst::ElementPtr & valveElement);
+
+public Q_SLOTS:
+    void setMuted(bool muted);
+
+Q_SIGNALS:
+    void muteControlSupportedChanged(bool isSupported);
+    void mutedChanged(bool isMuted);
+
+private:
+    void updateValve();
+
+    QGst::ElementPtr m_valve;
+    bool m_muted;
+};
+
+#endif // MUTE_CONTROLLER_H
@@ -0,0 +1,285 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "audio-buffer-tuner.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QTimer>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+namespace KTpCallPrivate {
+
+static const int s_evaluationInterval = 5000; //ms
+//a single glitch can be a hiccup of the system; more than that in one interval is the buffer
+static const int s_glitchThreshold = 2;
+//how long a device has to run clean before a smaller buffer is tried
+static const int s_cleanIntervalsBeforeShrinking = 6;
+static const qint64 s_shrinkStep = 20000; //us
+//the period never gets larger than the 10 ms that GStreamer uses by default
+static const qint64 s_maximumPeriod = 10000; //us
+//the first buffers after a device was opened arrive while it is still starting
+static const int s_ignoredBuffers = 10;
+//do not count lateness that is within the accuracy of the clock
+static const GstClockTime s_lateTolerance = 2 * GST_MSECOND;
+
+AudioBufferTuner::AudioBufferTuner(Direction direction, QObject *parent)
+    : QObject(parent),
+      m_direction(direction),
+      m_glitches(0),
+      m_ignoredBuffers(0),
+      m_pipelineLatency(0),
+      m_bufferTime(0),
+      m_nextBufferTime(0),
+      m_cleanBufferTime(0),
+      m_tunable(false),
+      m_settled(false),
+      m_cleanIntervals(0),
+      m_probe(0)
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    m_minBufferTime = configGroup.readEntry("minaudiobuffer", 20) * qint64(1000);
+    m_maxBufferTime = qMax(m_minBufferTime, configGroup.readEntry("maxaudiobuffer", 400) * qint64(1000));
+
+    QTimer *timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), SLOT(evaluate()));
+    timer->start(s_evaluationInterval);
+}
+
+AudioBufferTuner::~AudioBufferTuner()
+{
+    if (m_probe) {
+        gst_pad_remove_probe(m_pad, m_probe);
+    }
+}
+
+QString AudioBufferTuner::deviceKey(Direction direction, const QGst::ElementPtr & element)
+{
+    QString key = direction == Playback ? QStringLiteral("playback") : QStringLiteral("capture");
+
+    GstElementFactory *factory = gst_element_get_factory(element);
+    if (factory) {
+        key += QLatin1Char('/') + QString::fromLatin1(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)));
+    }
+    if (element->findProperty("device")) {
+        QString device = element->property("device").toString();
+        if (!device.isEmpty()) {
+            key += QLatin1Char('/') + device;
+        }
+    }
+    return key;
+}
+
+void AudioBufferTuner::configure(const QGst::ElementPtr & element)
+{
+    if (!element || !element->findProperty("buffer-time") || !element->findProperty("latency-time")) {
+        return;
+    }
+
+    QString key = deviceKey(m_direction, element);
+
+    QMutexLocker l(&m_mutex);
+    if (key != m_deviceKey) {
+        //start from what this device ran on the last time, or from the element default
+        const KConfigGroup configGroup = KSharedConfig::openConfig()->group("AudioBufferSizes");
+        qint64 bufferTime = configGroup.readEntry(key, 0) * qint64(1000);
+        if (bufferTime <= 0) {
+            bufferTime = element->property("buffer-time").get<qint64>();
+        }
+
+        m_deviceKey = key;
+        m_nextBufferTime = qBound(m_minBufferTime, bufferTime, m_maxBufferTime);
+        m_cleanBufferTime = 0;
+        m_settled = false;
+        m_cleanIntervals = 0;
+    }
+
+    //a size that the last device chose only applies now that a device is opened again
+    m_bufferTime = m_nextBufferTime;
+    element->setProperty("buffer-time", m_bufferTime);
+    element->setProperty("latency-time", qMin(s_maximumPeriod, m_bufferTime / 4));
+}
+
+void AudioBufferTuner::watch(const QGst::ElementPtr & element)
+{
+    {
+        QMutexLocker l(&m_mutex);
+        if (m_probe) {
+            gst_pad_remove_probe(m_pad, m_probe);
+            m_probe = 0;
+            m_pad.clear();
+        }
+
+        m_glitches.store(0);
+        m_ignoredBuffers.store(s_ignoredBuffers);
+        m_cleanIntervals = 0;
+        m_tunable = element && element->findProperty("buffer-time")
+                && deviceKey(m_direction, element) == m_deviceKey;
+
+        if (m_tunable) {
+            m_pad = element->getStaticPad(m_direction == Playback ? "sink" : "src");
+            m_probe = gst_pad_add_probe(m_pad, GST_PAD_PROBE_TYPE_BUFFER,
+                                        &AudioBufferTuner::onBuffer, this, NULL);
+        }
+    }
+
+    Q_EMIT latencyChanged();
+}
+
+int AudioBufferTuner::latency() const
+{
+    QMutexLocker l(&m_mutex);
+    return m_tunable ? int(m_bufferTime / 1000) : 0;
+}
+
+GstPadProbeReturn AudioBufferTuner::onBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    AudioBufferTuner *self = static_cast<AudioBufferTuner*>(data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (self->m_ignoredBuffers.load() > 0) {
+        self->m_ignoredBuffers.deref();
+        return GST_PAD_PROBE_OK;
+    }
+
+    //a capture device marks the samples after an overrun as discontinuous;
+    //a playback device runs dry when a buffer arrives too late for it
+    if (self->m_direction == Capture ? GST_BUFFER_IS_DISCONT(buffer) : self->isLate(pad, buffer)) {
+        self->m_glitches.ref();
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool AudioBufferTuner::isLate(GstPad *pad, GstBuffer *buffer) const
+{
+    //the first evaluation has not seen the pipeline latency yet
+    quint64 latency = m_pipelineLatency.load();
+    if (latency == 0 || !GST_BUFFER_PTS_IS_VALID(buffer)) {
+        return false;
+    }
+
+    GstEvent *segmentEvent = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (!segmentEvent) {
+        return false;
+    }
+    const GstSegment *segment;
+    gst_event_parse_segment(segmentEvent, &segment);
+    GstClockTime runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME,
+                                                           GST_BUFFER_PTS(buffer));
+    gst_event_unref(segmentEvent);
+    if (!GST_CLOCK_TIME_IS_VALID(runningTime)) {
+        return false;
+    }
+
+    GstElement *element = GST_ELEMENT(gst_pad_get_parent(pad));
+    if (!element) {
+        return false;
+    }
+    GstClock *clock = gst_element_get_clock(element);
+    GstClockTime baseTime = gst_element_get_base_time(element);
+    gst_object_unref(element);
+    if (!clock) {
+        return false;
+    }
+    GstClockTime now = gst_clock_get_time(clock) - baseTime;
+    gst_object_unref(clock);
+
+    //the sink plays a buffer at its running time plus the pipeline latency
+    return now > runningTime + latency + s_lateTolerance;
+}
+
+void AudioBufferTuner::queryPipelineLatency()
+{
+    //the latency that the pipeline gave to its sinks is the one that the pipeline reports
+    GstObject *top = GST_OBJECT(gst_pad_get_parent(m_pad));
+    while (top && GST_OBJECT_PARENT(top)) {
+        GstObject *parent = gst_object_get_parent(top);
+        gst_object_unref(top);
+        top = parent;
+    }
+    if (!top) {
+        return;
+    }
+
+    GstQuery *query = gst_query_new_latency();
+    if (gst_element_query(GST_ELEMENT(top), query)) {
+        gboolean live;
+        GstClockTime minLatency;
+        gst_query_parse_latency(query, &live, &minLatency, NULL);
+        if (GST_CLOCK_TIME_IS_VALID(minLatency)) {
+            m_pipelineLatency.store(minLatency);
+        }
+    }
+    gst_query_unref(query);
+    gst_object_unref(top);
+}
+
+void AudioBufferTuner::evaluate()
+{
+    QMutexLocker l(&m_mutex);
+    if (!m_tunable) {
+        return;
+    }
+
+    if (m_direction == Playback) {
+        queryPipelineLatency();
+    }
+
+    int glitches = m_glitches.fetchAndStoreRelaxed(0);
+    qint64 bufferTime;
+    if (glitches >= s_glitchThreshold) {
+        //this size is too small; do not go back to it during this call
+        m_settled = true;
+        m_cleanIntervals = 0;
+        if (m_cleanBufferTime > m_bufferTime) {
+            //a smaller size was tried and failed; go back to the last one that worked
+            bufferTime = m_cleanBufferTime;
+        } else {
+            bufferTime = qMin(m_maxBufferTime, m_bufferTime * 3 / 2);
+        }
+        if (bufferTime == m_nextBufferTime) {
+            return;
+        }
+        qCDebug(LIBKTPCALL) << glitches << (m_direction == Playback ? "underruns" : "overruns")
+                            << "with" << m_bufferTime / 1000 << "ms of audio buffer; opening the device with"
+                            << bufferTime / 1000 << "ms the next time";
+    } else {
+        //one smaller size is tried per device open, once this one ran clean for a while
+        if (m_settled || m_nextBufferTime != m_bufferTime
+                || ++m_cleanIntervals < s_cleanIntervalsBeforeShrinking) {
+            return;
+        }
+        m_cleanIntervals = 0;
+        m_cleanBufferTime = m_bufferTime;
+        if (m_bufferTime <= m_minBufferTime) {
+            m_settled = true;
+            return;
+        }
+        bufferTime = qMax(m_minBufferTime, m_bufferTime - s_shrinkStep);
+        qCDebug(LIBKTPCALL) << "No glitches with" << m_bufferTime / 1000 << "ms of audio buffer;"
+                            << "opening the device with" << bufferTime / 1000 << "ms the next time";
+    }
+
+    //the device keeps running as it is; reopening it would be an audible dropout of its own
+    KConfigGroup configGroup = KSharedConfig::openConfig()->group("AudioBufferSizes");
+    configGroup.writeEntry(m_deviceKey, bufferTime / 1000);
+    configGroup.sync();
+
+    m_nextBufferTime = bufferTime;
+}
+
+} // KTpCallPrivate
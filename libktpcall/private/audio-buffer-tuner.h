@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef AUDIO_BUFFER_TUNER_H
+#define AUDIO_BUFFER_TUNER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QGst/Element>
+#include <QGst/Pad>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+/* Finds the smallest device buffer that an audio device runs on without glitches.
+ *
+ * It counts the underruns of a playback device (buffers that reach it after
+ * their playout time) or the overruns of a capture device (discontinuities in
+ * what it produces). Devices that glitch get a larger buffer-time; devices that
+ * run clean for a while are tried with a smaller one, within the configured
+ * bounds. The sizes only apply when a device is opened, at the next call or
+ * hot-swap; the tuner never reopens a device itself. The size to open a device
+ * with is remembered in the AudioBufferSizes config group. */
+class AudioBufferTuner : public QObject
+{
+    Q_OBJECT
+public:
+    enum Direction {
+        Capture,
+        Playback
+    };
+
+    explicit AudioBufferTuner(Direction direction, QObject *parent = 0);
+    virtual ~AudioBufferTuner();
+
+    /* Sets the buffer sizes for element, which must not have gone past StateReady yet.
+     * Elements that are not audiobasesink/audiobasesrc subclasses are left alone */
+    void configure(const QGst::ElementPtr & element);
+
+    /* Starts counting the glitches of element, which has to be configured first.
+     * A null element stops watching */
+    void watch(const QGst::ElementPtr & element);
+
+    /* The buffering of the watched device in ms, or 0 if it cannot be tuned */
+    int latency() const;
+
+Q_SIGNALS:
+    void latencyChanged();
+
+private Q_SLOTS:
+    void evaluate();
+
+private:
+    static GstPadProbeReturn onBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    bool isLate(GstPad *pad, GstBuffer *buffer) const;
+    void queryPipelineLatency();
+    static QString deviceKey(Direction direction, const QGst::ElementPtr & element);
+
+    const Direction m_direction;
+    qint64 m_minBufferTime; //in us, like the buffer-time property
+    qint64 m_maxBufferTime;
+
+    //these are shared with the streaming thread
+    QAtomicInt m_glitches;
+    QAtomicInt m_ignoredBuffers;
+    QAtomicInteger<quint64> m_pipelineLatency;
+
+    mutable QMutex m_mutex;
+    QString m_deviceKey; //the device that m_bufferTime was loaded for
+    qint64 m_bufferTime; //what the watched device was opened with
+    qint64 m_nextBufferTime; //what the next device open gets
+    qint64 m_cleanBufferTime; //the smallest size that ran clean, or 0
+    bool m_tunable;
+    bool m_settled; //a smaller size glitched; do not try smaller ones again for this device
+    int m_cleanIntervals;
+    QGst::PadPtr m_pad;
+    gulong m_probe;
+};
+
+} // KTpCallPrivate
+
+#endif // AUDIO_BUFFER_TUNER_H
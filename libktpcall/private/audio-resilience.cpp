@@ -0,0 +1,235 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "audio-resilience.h"
+#include "receiver-report.h"
+#include "session-elements.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QTimer>
+
+#include <farstream/fs-session.h>
+#include <gst/gst.h>
+#include <math.h>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+namespace KTpCallPrivate {
+
+//FEC goes on when the loss reaches this for more than one report, and off after
+//enough reports in a row below the other
+static const double s_fecOnLoss = 0.02;
+static const double s_fecOffLoss = 0.005;
+static const int s_cleanReportsBeforeFecOff = 3;
+//above this, FEC would mostly recover frames that the next loss takes away again
+static const int s_maxExpectedLoss = 25; //percent
+//loss this heavy is congestion, which more bits only make worse
+static const double s_congestionLoss = 0.15;
+
+static const double s_longPacketLoss = 0.08;
+static const int s_longPacketJitter = 30; //ms
+static const double s_longestPacketLoss = 0.15;
+static const int s_longestPacketJitter = 60; //ms
+
+static const int s_minBitrate = 6000; //bps, the range of opusenc
+static const int s_maxBitrate = 510000;
+
+bool AudioResiliencePolicy::Settings::operator==(const Settings & other) const
+{
+    return fec == other.fec && expectedLoss == other.expectedLoss
+            && packetTime == other.packetTime && bitrate == other.bitrate;
+}
+
+AudioResiliencePolicy::AudioResiliencePolicy(int baseBitrate, int basePacketTime)
+    : m_baseBitrate(qBound(s_minBitrate, baseBitrate, s_maxBitrate)),
+      m_basePacketTime(basePacketTime),
+      m_loss(0),
+      m_lossyReports(0),
+      m_cleanReports(0),
+      m_congested(false)
+{
+    reset();
+}
+
+void AudioResiliencePolicy::reset()
+{
+    m_loss = 0;
+    m_lossyReports = 0;
+    m_cleanReports = 0;
+    m_congested = false;
+
+    m_settings.fec = false;
+    m_settings.expectedLoss = 0;
+    m_settings.packetTime = m_basePacketTime;
+    m_settings.bitrate = m_baseBitrate;
+}
+
+bool AudioResiliencePolicy::update(double fractionLost, int jitterMs)
+{
+    //loss is followed faster than its end: lost audio is worse than some overhead
+    fractionLost = qBound(0.0, fractionLost, 1.0);
+    m_loss += (fractionLost > m_loss ? 0.5 : 0.25) * (fractionLost - m_loss);
+    m_lossyReports = fractionLost >= s_fecOnLoss ? m_lossyReports + 1 : 0;
+    m_cleanReports = fractionLost < s_fecOffLoss ? m_cleanReports + 1 : 0;
+
+    Settings settings = m_settings;
+
+    //a single report of slight loss does not switch FEC on, and a clean one never does
+    if (m_lossyReports > 0 && (m_lossyReports >= 2 || m_loss >= s_fecOnLoss)) {
+        settings.fec = true;
+    } else if (m_cleanReports >= s_cleanReportsBeforeFecOff) {
+        settings.fec = false;
+    }
+    settings.expectedLoss = settings.fec ? qBound(1, int(ceil(m_loss * 100)), s_maxExpectedLoss) : 0;
+
+    //on a busy Wi-Fi the packet rate costs more than the packet size, and every packet
+    //carries 40 bytes of headers; in between the thresholds keep what there is
+    if (m_loss >= s_longestPacketLoss || jitterMs >= s_longestPacketJitter) {
+        settings.packetTime = qMax(m_basePacketTime, 60);
+    } else if (m_loss >= s_longPacketLoss || jitterMs >= s_longPacketJitter) {
+        settings.packetTime = qMax(m_basePacketTime, 40);
+    } else if (m_loss < s_longPacketLoss / 2 && jitterMs < s_longPacketJitter * 2 / 3) {
+        settings.packetTime = m_basePacketTime;
+    }
+
+    //like the packet time, the backoff holds until the loss is well below where it started
+    if (m_loss >= s_congestionLoss) {
+        m_congested = true;
+    } else if (m_loss < s_congestionLoss / 2) {
+        m_congested = false;
+    }
+
+    int bitrate = m_baseBitrate;
+    if (m_congested) {
+        bitrate = m_baseBitrate * 3 / 4;
+    } else if (settings.fec) {
+        //the FEC data takes its bits from the primary stream
+        bitrate = int(m_baseBitrate * (1.0 + qMin(2 * m_loss, 0.5)));
+    }
+    settings.bitrate = qBound(s_minBitrate, (bitrate + 500) / 1000 * 1000, s_maxBitrate);
+
+    if (settings == m_settings) {
+        return false;
+    }
+    m_settings = settings;
+    return true;
+}
+
+AudioResilienceController::AudioResilienceController(QObject *parent)
+    : QObject(parent),
+      m_lastReportSeq(0)
+{
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), SLOT(poll()));
+}
+
+AudioResilienceController::~AudioResilienceController()
+{
+}
+
+void AudioResilienceController::setSession(const QGlib::ObjectPtr & session, const QGst::BinPtr & pipeline)
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    if (session && !configGroup.readEntry("audioresilience", true)) {
+        return;
+    }
+
+    m_session = session;
+    m_pipeline = session ? pipeline : QGst::BinPtr();
+    m_encoder.clear();
+    m_lastReportSeq = 0;
+
+    if (m_session) {
+        m_timer->start(ReceiverReport::pollInterval);
+    } else {
+        m_timer->stop();
+    }
+}
+
+void AudioResilienceController::restart()
+{
+    if (!m_encoder) {
+        return;
+    }
+
+    //the last reports before the gap say nothing about the network after it
+    const AudioResiliencePolicy::Settings settings = m_policy.settings();
+    m_policy.reset();
+    if (m_policy.settings() != settings) {
+        apply();
+    }
+}
+
+void AudioResilienceController::poll()
+{
+    FsCodec *codec = NULL;
+    g_object_get(static_cast<GObject*>(m_session), "current-send-codec", &codec, NULL);
+    if (!codec) {
+        return;
+    }
+    bool opus = g_ascii_strcasecmp(codec->encoding_name, "OPUS") == 0;
+    int clockRate = codec->clock_rate;
+    fs_codec_destroy(codec);
+
+    QGst::ElementPtr encoder = opus ? SessionElements::findSendEncoder(m_session, m_pipeline, "Audio")
+                                    : QGst::ElementPtr();
+    GstElementFactory *factory = encoder ? gst_element_get_factory(encoder) : NULL;
+    if (!factory || !g_str_equal(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "opusenc")) {
+        encoder.clear();
+    }
+    if (static_cast<GstElement*>(encoder) != static_cast<GstElement*>(m_encoder)) {
+        m_encoder = encoder;
+        if (m_encoder) {
+            gint bitrate = 0;
+            gint packetTime = 0;
+            g_object_get(static_cast<GObject*>(m_encoder), "bitrate", &bitrate, "frame-size", &packetTime, NULL);
+            m_policy = AudioResiliencePolicy(bitrate, packetTime);
+            qCDebug(LIBKTPCALL) << "Adapting the Opus encoder" << m_encoder->name()
+                                << "from" << bitrate << "bps," << packetTime << "ms packets";
+        }
+    }
+    if (!m_encoder || clockRate <= 0) {
+        return;
+    }
+
+    ReceiverReport report;
+    if (!ReceiverReport::read(m_session, clockRate, m_lastReportSeq, &report)) {
+        return;
+    }
+    m_lastReportSeq = report.sequence;
+    if (m_policy.update(report.fractionLost, report.jitterMs)) {
+        apply();
+    }
+}
+
+void AudioResilienceController::apply()
+{
+    const AudioResiliencePolicy::Settings settings = m_policy.settings();
+    qCDebug(LIBKTPCALL) << "Audio loss" << qRound(m_policy.smoothedLoss() * 100) << "%: FEC"
+                        << (settings.fec ? "on for" : "off,") << settings.expectedLoss << "% loss,"
+                        << settings.packetTime << "ms packets," << settings.bitrate << "bps";
+
+    //these may all change while the encoder is playing
+    g_object_set(static_cast<GObject*>(m_encoder),
+                 "inband-fec", gboolean(settings.fec),
+                 "packet-loss-percentage", settings.expectedLoss,
+                 "frame-size", settings.packetTime,
+                 "bitrate", settings.bitrate,
+                 NULL);
+}
+
+} // KTpCallPrivate
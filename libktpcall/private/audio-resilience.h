@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef AUDIO_RESILIENCE_H
+#define AUDIO_RESILIENCE_H
+
+#include <QtCore/QObject>
+#include <QGlib/Object>
+#include <QGst/Bin>
+#include <QGst/Element>
+
+class QTimer;
+
+namespace KTpCallPrivate {
+
+/* Decides how an Opus encoder protects the audio from the loss and jitter in
+ * the receiver reports of the remote side.
+ *
+ * In-band FEC is switched on when loss persists and off again after a few clean
+ * reports, so that a clear network does not pay for it. Under heavier loss or
+ * jitter, longer packets lower the packet rate and header overhead. The bitrate
+ * grows with the FEC share, so that the primary stream keeps its quality, and
+ * backs off when the loss looks like congestion. This does not touch GStreamer,
+ * so that it can be run against simulated loss patterns. */
+class AudioResiliencePolicy
+{
+public:
+    struct Settings
+    {
+        bool fec;
+        int expectedLoss; //percent, what the encoder plans its FEC for
+        int packetTime; //ms
+        int bitrate; //bps
+
+        bool operator==(const Settings & other) const;
+        bool operator!=(const Settings & other) const { return !operator==(other); }
+    };
+
+    /* A policy that falls back to the bitrate and packet time that were negotiated */
+    explicit AudioResiliencePolicy(int baseBitrate = 32000, int basePacketTime = 20);
+
+    /* Takes the fraction of packets lost (0 to 1) and the interarrival jitter in ms
+     * from a new receiver report; returns whether the settings changed */
+    bool update(double fractionLost, int jitterMs);
+
+    /* Forgets the reports seen so far and goes back to the base settings */
+    void reset();
+
+    Settings settings() const { return m_settings; }
+
+    /* The loss that the decisions are based on, smoothed over the recent reports */
+    double smoothedLoss() const { return m_loss; }
+
+private:
+    int m_baseBitrate;
+    int m_basePacketTime;
+    double m_loss;
+    int m_lossyReports; //in a row, at or above the FEC threshold
+    int m_cleanReports; //in a row, with next to no loss
+    bool m_congested;
+    Settings m_settings;
+};
+
+/* Applies an AudioResiliencePolicy to the Opus encoder of an fsconference session,
+ * reading the receiver reports from its RTP session whenever RTCP delivers one.
+ * Other send codecs are left alone. */
+class AudioResilienceController : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AudioResilienceController(QObject *parent = 0);
+    virtual ~AudioResilienceController();
+
+    /* Starts adapting the encoder of session, which lives in pipeline.
+     * A null session stops */
+    void setSession(const QGlib::ObjectPtr & session, const QGst::BinPtr & pipeline);
+
+    /* Starts again from the negotiated settings, for when the sending resumes
+     * after a gap in which the receiver reports did not move on */
+    void restart();
+
+private Q_SLOTS:
+    void poll();
+
+private:
+    void apply();
+
+    QGlib::ObjectPtr m_session;
+    QGst::BinPtr m_pipeline;
+    QGst::ElementPtr m_encoder;
+    AudioResiliencePolicy m_policy;
+    guint m_lastReportSeq; //the report that m_policy has already seen
+    QTimer *m_timer;
+};
+
+} // KTpCallPrivate
+
+#endif // AUDIO_RESILIENCE_H
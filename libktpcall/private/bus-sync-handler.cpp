@@ -0,0 +1,46 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "bus-sync-handler.h"
+#include "level-filter.h"
+#include "thread-scheduler.h"
+
+namespace KTpCallPrivate {
+
+void BusSyncHandler::install(const QGst::BusPtr & bus, const ThreadScheduler *scheduler)
+{
+    gst_bus_set_sync_handler(bus, &BusSyncHandler::onSyncMessage,
+                             const_cast<ThreadScheduler*>(scheduler), NULL);
+}
+
+void BusSyncHandler::uninstall(const QGst::BusPtr & bus)
+{
+    gst_bus_set_sync_handler(bus, NULL, NULL, NULL);
+}
+
+GstBusSyncReply BusSyncHandler::onSyncMessage(GstBus *bus, GstMessage *message, gpointer data)
+{
+    Q_UNUSED(bus);
+
+    //streaming threads announce themselves from the thread that just started
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS) {
+        static_cast<const ThreadScheduler*>(data)->handleStreamStatus(message);
+        return GST_BUS_PASS;
+    }
+    return LevelFilter::filter(message);
+}
+
+} // KTpCallPrivate
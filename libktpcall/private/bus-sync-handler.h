@@ -0,0 +1,43 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BUS_SYNC_HANDLER_H
+#define BUS_SYNC_HANDLER_H
+
+#include <QGst/Bus>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+class ThreadScheduler;
+
+/* The sync handler of the call pipeline bus. It runs in the streaming threads:
+ * new streaming threads get their priority from scheduler and level messages
+ * are stored by LevelFilter, so that neither reaches the main loop late. */
+class BusSyncHandler
+{
+public:
+    /* scheduler has to outlive the handler */
+    static void install(const QGst::BusPtr & bus, const ThreadScheduler *scheduler);
+    static void uninstall(const QGst::BusPtr & bus);
+
+private:
+    static GstBusSyncReply onSyncMessage(GstBus *bus, GstMessage *message, gpointer data);
+};
+
+} // KTpCallPrivate
+
+#endif // BUS_SYNC_HANDLER_H
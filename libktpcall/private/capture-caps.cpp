@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "capture-caps.h"
+#include "libktpcall_debug.h"
+
+#include <QGst/Pad>
+
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+int CaptureCaps::framerate(const QGst::CapsPtr & caps, int fallback)
+{
+    int numerator;
+    int denominator;
+    if (caps && caps->size() > 0 && gst_structure_get_fraction(
+            gst_caps_get_structure(caps, 0), "framerate", &numerator, &denominator) && denominator > 0) {
+        return qMax(1, numerator / denominator);
+    }
+    return fallback;
+}
+
+bool CaptureCaps::nativeSize(const QGst::ElementPtr & src, int *width, int *height)
+{
+    *width = 0;
+    *height = 0;
+    QGst::PadPtr srcPad = src ? src->getStaticPad("src") : QGst::PadPtr();
+    GstCaps *caps = srcPad ? gst_pad_query_caps(srcPad, NULL) : NULL;
+    if (!caps) {
+        return false;
+    }
+
+    for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+        //ranges are what a source could scale to, not what the camera captures
+        const GstStructure *s = gst_caps_get_structure(caps, i);
+        int structureWidth;
+        int structureHeight;
+        if (gst_structure_get_int(s, "width", &structureWidth) && gst_structure_get_int(s, "height", &structureHeight)
+                && qint64(structureWidth) * structureHeight > qint64(*width) * *height) {
+            *width = structureWidth;
+            *height = structureHeight;
+        }
+    }
+    gst_caps_unref(caps);
+    return *width > 0 && *height > 0;
+}
+
+bool CaptureCaps::canProduce(const QGst::ElementPtr & capsfilter, const QGst::CapsPtr & caps)
+{
+    QGst::PadPtr sinkPad = capsfilter ? capsfilter->getStaticPad("sink") : QGst::PadPtr();
+    if (!sinkPad || !caps) {
+        return false;
+    }
+
+    GstCaps *possible = gst_pad_peer_query_caps(sinkPad, caps);
+    bool ok = possible && !gst_caps_is_empty(possible);
+    if (possible) {
+        gst_caps_unref(possible);
+    }
+    return ok;
+}
+
+void CaptureCaps::renegotiate(const QGst::ElementPtr & capsfilter, const QGst::ElementPtr & videorate,
+                              const QGst::CapsPtr & caps)
+{
+    //videorate only drops frames, so it has to let the new framerate through first
+    if (videorate) {
+        videorate->setProperty("max-rate", framerate(caps, 15));
+    }
+    capsfilter->setProperty("caps", caps);
+
+    //videoconvert, videoscale, videorate and, if it can, the camera pick new caps on their next frame
+    QGst::PadPtr sinkPad = capsfilter->getStaticPad("sink");
+    if (!gst_pad_push_event(sinkPad, gst_event_new_reconfigure())) {
+        qCDebug(LIBKTPCALL) << "Nothing upstream of" << capsfilter->name() << "handled the reconfigure event";
+    }
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,50 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CAPTURE_CAPS_H
+#define CAPTURE_CAPS_H
+
+#include <QGst/Caps>
+#include <QGst/Element>
+
+namespace KTpCallPrivate {
+
+/* Changes what a video capture bin produces while it is playing, through the
+ * capsfilter and videorate at its end, without stopping the camera */
+class CaptureCaps
+{
+public:
+    /* The framerate of caps, rounded down, or fallback if it has none */
+    static int framerate(const QGst::CapsPtr & caps, int fallback);
+
+    /* The largest size in the caps of the src pad of src. A camera only reports the
+     * sizes that it has once it is in StateReady. Returns false if there are none */
+    static bool nativeSize(const QGst::ElementPtr & src, int *width, int *height);
+
+    /* Whether the elements in front of capsfilter, down to the camera, can
+     * produce caps at all, after scaling and conversion */
+    static bool canProduce(const QGst::ElementPtr & capsfilter, const QGst::CapsPtr & caps);
+
+    /* Sets caps on capsfilter and the framerate of caps on videorate, then asks the
+     * elements in front of them to renegotiate with a reconfigure event. The frames
+     * in flight go out as they are; the next ones come in the new caps */
+    static void renegotiate(const QGst::ElementPtr & capsfilter, const QGst::ElementPtr & videorate,
+                            const QGst::CapsPtr & caps);
+};
+
+} // KTpCallPrivate
+
+#endif // CAPTURE_CAPS_H
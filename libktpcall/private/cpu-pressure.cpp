@@ -0,0 +1,155 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cpu-pressure.h"
+#include "session-elements.h"
+#include "video-adaptation.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QTimer>
+
+#include <gst/gst.h>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+namespace KTpCallPrivate {
+
+static const int s_sampleInterval = 1000; //ms
+
+//a frame or two in flight is normal, a backlog is not
+static const int s_backlogFrames = 3;
+static const int s_lateFramesPerSecond = 3;
+//quick to step down, as late frames are already visible; slow to step up again
+static const int s_behindSecondsBeforeStep = 2;
+static const int s_clearSecondsBeforeStep = 15;
+//falling behind this soon after a step up means that the step was one too many
+static const int s_failedStepUpSeconds = 30;
+static const int s_maxClearSecondsBeforeStep = 240;
+
+CpuPressurePolicy::CpuPressurePolicy()
+    : m_behindSeconds(0),
+      m_clearSeconds(0),
+      m_clearSecondsBeforeStep(s_clearSecondsBeforeStep),
+      m_secondsSinceStepUp(-1)
+{
+}
+
+CpuPressurePolicy::Verdict CpuPressurePolicy::update(int queuedFrames, int lateFrames)
+{
+    if (m_secondsSinceStepUp >= 0 && ++m_secondsSinceStepUp > s_failedStepUpSeconds) {
+        m_secondsSinceStepUp = -1;
+    }
+
+    if (queuedFrames >= s_backlogFrames || lateFrames >= s_lateFramesPerSecond) {
+        m_clearSeconds = 0;
+        if (++m_behindSeconds >= s_behindSecondsBeforeStep) {
+            m_behindSeconds = 0;
+            if (m_secondsSinceStepUp >= 0) {
+                m_secondsSinceStepUp = -1;
+                m_clearSecondsBeforeStep = qMin(m_clearSecondsBeforeStep * 2, s_maxClearSecondsBeforeStep);
+            }
+            return Behind;
+        }
+    } else if (queuedFrames == 0 && lateFrames == 0) {
+        m_behindSeconds = 0;
+        if (++m_clearSeconds >= m_clearSecondsBeforeStep) {
+            m_clearSeconds = 0;
+            m_secondsSinceStepUp = 0;
+            return Headroom;
+        }
+    } else {
+        m_behindSeconds = 0;
+        m_clearSeconds = 0;
+    }
+    return Steady;
+}
+
+CpuPressureMonitor::CpuPressureMonitor(QObject *parent)
+    : QObject(parent),
+      m_lateFrames(0)
+{
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), SLOT(sample()));
+}
+
+CpuPressureMonitor::~CpuPressureMonitor()
+{
+}
+
+bool CpuPressureMonitor::isEnabled()
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    return configGroup.readEntry("cpuadaptation", true) && VideoAdaptationController::isEnabled();
+}
+
+void CpuPressureMonitor::setBin(const QGst::BinPtr & bin)
+{
+    m_bin = bin;
+    m_policy = CpuPressurePolicy();
+    m_lateFrames = 0;
+
+    if (m_bin) {
+        m_timer->start(s_sampleInterval);
+    } else {
+        m_timer->stop();
+    }
+}
+
+void CpuPressureMonitor::handleQosMessage(const QGst::QosMessagePtr & message)
+{
+    //a positive jitter is a frame that came too late to be used
+    if (m_bin && message->jitter() > 0) {
+        ++m_lateFrames;
+    }
+}
+
+void CpuPressureMonitor::sample()
+{
+    int queued = queuedFrames();
+    int late = m_lateFrames;
+    m_lateFrames = 0;
+
+    switch (m_policy.update(queued, late)) {
+    case CpuPressurePolicy::Behind:
+        qCDebug(LIBKTPCALL) << "Video send chain behind:" << queued << "frames queued,"
+                            << late << "late in the last second";
+        Q_EMIT cpuBehind();
+        break;
+    case CpuPressurePolicy::Headroom:
+        Q_EMIT cpuHeadroom();
+        break;
+    default:
+        break;
+    }
+}
+
+int CpuPressureMonitor::queuedFrames() const
+{
+    //the queues in front of the conversion and the encoder; the preview has its own bin
+    int frames = 0;
+    Q_FOREACH (const QGst::ElementPtr & element, SessionElements::children(m_bin, false)) {
+        GstElementFactory *factory = gst_element_get_factory(element);
+        if (factory && g_str_equal(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "queue")) {
+            guint buffers = 0;
+            g_object_get(static_cast<GObject*>(element), "current-level-buffers", &buffers, NULL);
+            frames += buffers;
+        }
+    }
+    return frames;
+}
+
+} // KTpCallPrivate
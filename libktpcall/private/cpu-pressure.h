@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CPU_PRESSURE_H
+#define CPU_PRESSURE_H
+
+#include <QtCore/QObject>
+#include <QGst/Bin>
+#include <QGst/Message>
+
+class QTimer;
+
+namespace KTpCallPrivate {
+
+/* Tells from one second of the video send chain whether the local CPU keeps up.
+ *
+ * It falls behind when frames wait in the queues before the conversion and the
+ * encoder, or when the elements after them report late frames with QoS messages,
+ * for a couple of seconds in a row. It has time to spare after a long stretch
+ * with neither. After each verdict the seconds are counted anew, so that the
+ * pipeline settles after a step before the next one. A step up that falls behind
+ * again soon doubles that stretch, so that a CPU at its limit does not go up and
+ * down between two tiers. */
+class CpuPressurePolicy
+{
+public:
+    enum Verdict {
+        Steady,
+        Behind,
+        Headroom
+    };
+
+    CpuPressurePolicy();
+
+    /* Takes the frames that waited in the queues at the end of the second and the
+     * frames that QoS messages reported late during it */
+    Verdict update(int queuedFrames, int lateFrames);
+
+private:
+    int m_behindSeconds;
+    int m_clearSeconds;
+    int m_clearSecondsBeforeStep;
+    int m_secondsSinceStepUp; //-1 when the last step up has held
+};
+
+/* Watches the capture bin of a video content once a second and the QoS messages
+ * of its elements, and signals the verdicts of a CpuPressurePolicy */
+class CpuPressureMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CpuPressureMonitor(QObject *parent = 0);
+    virtual ~CpuPressureMonitor();
+
+    /* Whether the video should follow the local CPU, as configured. The steps are
+     * tiers of VideoAdaptationController, so this is off when that is */
+    static bool isEnabled();
+
+    /* Starts watching the queues directly in bin. A null bin stops */
+    void setBin(const QGst::BinPtr & bin);
+
+    /* Counts a QoS message from an element of the send chain */
+    void handleQosMessage(const QGst::QosMessagePtr & message);
+
+Q_SIGNALS:
+    void cpuBehind();
+    void cpuHeadroom();
+
+private Q_SLOTS:
+    void sample();
+
+private:
+    int queuedFrames() const;
+
+    QGst::BinPtr m_bin;
+    CpuPressurePolicy m_policy;
+    int m_lateFrames;
+    QTimer *m_timer;
+};
+
+} // KTpCallPrivate
+
+#endif // CPU_PRESSURE_H
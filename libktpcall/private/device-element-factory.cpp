@@ -21,31 +21,257 @@
 #include <QGst/Bin>
 #include <QGst/ElementFactory>
 #include <QGst/Structure>
+#include <gst/gst.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
 
 #include <KSharedConfig>
 #include <KConfigGroup>
 
 namespace KTpCallPrivate {
 
-QGst::ElementPtr DeviceElementFactory::makeAudioCaptureElement()
+namespace {
+
+/* The state of a READY transition that runs in s_readyTransitionPool.
+ * It is shared with the waiting thread, which may give up before the
+ * transition finishes; in that case the runnable releases the element. */
+struct ReadyTransition
+{
+    explicit ReadyTransition(const QGst::ElementPtr & element)
+        : element(element), done(false), abandoned(false), success(false) {}
+
+    QMutex mutex;
+    QWaitCondition condition;
+    QGst::ElementPtr element;
+    bool done;
+    bool abandoned;
+    bool success;
+};
+
+class ReadyTransitionRunnable : public QRunnable
+{
+public:
+    explicit ReadyTransitionRunnable(const QSharedPointer<ReadyTransition> & transition)
+        : m_transition(transition) {}
+
+    virtual void run()
+    {
+        bool success = m_transition->element->setState(QGst::StateReady) != QGst::StateChangeFailure;
+
+        QMutexLocker l(&m_transition->mutex);
+        m_transition->success = success;
+        m_transition->done = true;
+        if (m_transition->abandoned) {
+            m_transition->element->setState(QGst::StateNull);
+        }
+        m_transition->condition.wakeAll();
+    }
+
+private:
+    QSharedPointer<ReadyTransition> m_transition;
+};
+
+/* a device that never becomes ready keeps its thread busy,
+ * so allow more threads than there are cores */
+class ReadyTransitionPool : public QThreadPool
+{
+public:
+    ReadyTransitionPool() { setMaxThreadCount(8); }
+};
+
+Q_GLOBAL_STATIC(ReadyTransitionPool, s_readyTransitionPool)
+
+/* The LastWorkingDevices config group, kept in memory for the acquisition worker
+ * threads. Changes are written back to the file from the main thread only, so that
+ * the workers of the audio and the video content never write it at the same time. */
+class LastWorkingDevices : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        QByteArray name;
+        QString device;
+        QString preference; //what the probe depended on, see devicePreference()
+    };
+
+    LastWorkingDevices();
+
+    bool find(const QByteArray & deviceClass, Entry *entry);
+    void insert(const QByteArray & deviceClass, const Entry & entry);
+    void remove(const QByteArray & deviceClass);
+
+private Q_SLOTS:
+    void writeBack();
+
+private:
+    void scheduleWriteBack();
+
+    QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries;
+    QSet<QByteArray> m_changedClasses;
+    bool m_writeBackScheduled;
+};
+
+Q_GLOBAL_STATIC(LastWorkingDevices, s_lastWorkingDevices)
+
+LastWorkingDevices::LastWorkingDevices()
+    : m_writeBackScheduled(false)
+{
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("LastWorkingDevices");
+    const char *deviceClasses[] = { "audiosrc", "audiosink", "videosrc" };
+    for (uint i = 0; i < sizeof(deviceClasses) / sizeof(deviceClasses[0]); ++i) {
+        const QString deviceClass = QString::fromLatin1(deviceClasses[i]);
+        if (configGroup.hasKey(deviceClass)) {
+            Entry entry;
+            entry.name = configGroup.readEntry(deviceClass, QByteArray());
+            entry.device = configGroup.readEntry(deviceClass + QLatin1String("device"), QString());
+            entry.preference = configGroup.readEntry(deviceClass + QLatin1String("preference"), QString());
+            m_entries.insert(deviceClasses[i], entry);
+        }
+    }
+}
+
+bool LastWorkingDevices::find(const QByteArray & deviceClass, Entry *entry)
+{
+    QMutexLocker l(&m_mutex);
+    if (!m_entries.contains(deviceClass)) {
+        return false;
+    }
+    *entry = m_entries.value(deviceClass);
+    return true;
+}
+
+void LastWorkingDevices::insert(const QByteArray & deviceClass, const Entry & entry)
+{
+    QMutexLocker l(&m_mutex);
+    if (m_entries.contains(deviceClass)) {
+        const Entry & old = m_entries[deviceClass];
+        if (old.name == entry.name && old.device == entry.device && old.preference == entry.preference) {
+            return;
+        }
+    }
+    m_entries.insert(deviceClass, entry);
+    m_changedClasses.insert(deviceClass);
+    scheduleWriteBack();
+}
+
+void LastWorkingDevices::remove(const QByteArray & deviceClass)
+{
+    QMutexLocker l(&m_mutex);
+    if (m_entries.remove(deviceClass)) {
+        m_changedClasses.insert(deviceClass);
+        scheduleWriteBack();
+    }
+}
+
+void LastWorkingDevices::scheduleWriteBack()
+{
+    //called with m_mutex held
+    if (!m_writeBackScheduled) {
+        m_writeBackScheduled = true;
+        QMetaObject::invokeMethod(this, "writeBack", Qt::QueuedConnection);
+    }
+}
+
+void LastWorkingDevices::writeBack()
+{
+    QHash<QByteArray, Entry> entries;
+    QSet<QByteArray> changedClasses;
+    {
+        QMutexLocker l(&m_mutex);
+        entries = m_entries;
+        changedClasses = m_changedClasses;
+        m_changedClasses.clear();
+        m_writeBackScheduled = false;
+    }
+
+    KConfigGroup configGroup = KSharedConfig::openConfig()->group("LastWorkingDevices");
+    Q_FOREACH (const QByteArray & deviceClass, changedClasses) {
+        const QString key = QString::fromLatin1(deviceClass);
+        if (entries.contains(deviceClass)) {
+            const Entry & entry = entries[deviceClass];
+            configGroup.writeEntry(key, entry.name);
+            configGroup.writeEntry(key + QLatin1String("device"), entry.device);
+            configGroup.writeEntry(key + QLatin1String("preference"), entry.preference);
+        } else {
+            configGroup.deleteEntry(key);
+            configGroup.deleteEntry(key + QLatin1String("device"));
+            configGroup.deleteEntry(key + QLatin1String("preference"));
+        }
+    }
+    configGroup.sync();
+}
+
+/* What the probe of a device class depends on: the session type and the
+ * devices that phonon prefers. A remembered device is only used as long as
+ * this has not changed, so that it does not override the user's choice. */
+QString devicePreference(Phonon::ObjectDescriptionType type)
+{
+    //gconf keeps the preference of non-kde environments itself
+    if (qgetenv("KDE_FULL_SESSION").isEmpty()) {
+        return QLatin1String("gconf");
+    }
+
+    QStringList devices;
+    QList<Phonon::DeviceAccessList> phononDeviceLists
+        = PhononIntegration::readDevices(type, Phonon::CommunicationCategory);
+    Q_FOREACH (const Phonon::DeviceAccessList & deviceList, phononDeviceLists) {
+        Q_FOREACH (const Phonon::DeviceAccess & device, deviceList) {
+            devices.append(QString::fromLatin1(device.first) + QLatin1Char(':') + device.second);
+        }
+    }
+    return QLatin1String("kde;") + devices.join(QLatin1String(","));
+}
+
+} // namespace
+
+QGst::ElementPtr DeviceElementFactory::makeAudioCaptureElement(int readyTimeout)
 {
     QGst::ElementPtr element;
 
     //allow overrides from the application's configuration file
-    element = tryOverrideForKey("audiosrc");
+    element = tryOverrideForKey("audiosrc", readyTimeout);
     if (element) {
         return element;
     }
 
+    //try the device that worked the last time, before probing all of them
+    const QString preference = devicePreference(Phonon::AudioCaptureDeviceType);
+    element = tryLastWorkingElement("audiosrc", preference, readyTimeout);
+    if (element) {
+        return element;
+    }
+
+    element = probeAudioCaptureElement(readyTimeout);
+    rememberWorkingElement("audiosrc", preference, element);
+    return element;
+}
+
+QGst::ElementPtr DeviceElementFactory::probeAudioCaptureElement(int readyTimeout)
+{
+    QGst::ElementPtr element;
+
     //use gconf on non-kde environments
     if (qgetenv("KDE_FULL_SESSION").isEmpty()) {
-        element = tryElement("gconfaudiosrc");
+        element = tryElement("gconfaudiosrc", QString(), readyTimeout);
         return element;
     }
 
     //for kde environments try to do what phonon does:
     //first try pulseaudio,
-    element = tryElement("pulsesrc");
+    element = tryElement("pulsesrc", QString(), readyTimeout);
     if (element) {
         addStreamProperties(element);
         return element;
@@ -61,10 +287,10 @@ QGst::ElementPtr DeviceElementFactory::makeAudioCaptureElement()
             if (device.first == "alsa") {
                 //skip x-phonon devices, we will use plughw which is always second in the list
                 if (!device.second.startsWith("x-phonon")) {
-                    element = tryElement("alsasrc", device.second);
+                    element = tryElement("alsasrc", device.second, readyTimeout);
                 }
             } else if (device.first == "oss") {
-                element = tryElement("osssrc", device.second);
+                element = tryElement("osssrc", device.second, readyTimeout);
             }
 
             if (element) {
@@ -74,23 +300,39 @@ QGst::ElementPtr DeviceElementFactory::makeAudioCaptureElement()
     }
 
     //as a last resort, try gstreamer's autodetection
-    element = tryElement("autoaudiosrc");
+    element = tryElement("autoaudiosrc", QString(), readyTimeout);
     return element;
 }
 
-QGst::ElementPtr DeviceElementFactory::makeAudioOutputElement()
+QGst::ElementPtr DeviceElementFactory::makeAudioOutputElement(int readyTimeout)
 {
     QGst::ElementPtr element;
 
     //allow overrides from the application's configuration file
-    element = tryOverrideForKey("audiosink");
+    element = tryOverrideForKey("audiosink", readyTimeout);
+    if (element) {
+        return element;
+    }
+
+    //try the device that worked the last time, before probing all of them
+    const QString preference = devicePreference(Phonon::AudioOutputDeviceType);
+    element = tryLastWorkingElement("audiosink", preference, readyTimeout);
     if (element) {
         return element;
     }
 
+    element = probeAudioOutputElement(readyTimeout);
+    rememberWorkingElement("audiosink", preference, element);
+    return element;
+}
+
+QGst::ElementPtr DeviceElementFactory::probeAudioOutputElement(int readyTimeout)
+{
+    QGst::ElementPtr element;
+
     //use gconf on non-kde environments
     if (qgetenv("KDE_FULL_SESSION").isEmpty()) {
-        element = tryElement("gconfaudiosink");
+        element = tryElement("gconfaudiosink", QString(), readyTimeout);
         if (element) {
             element->setProperty("profile", 2 /*chat*/);
         }
@@ -99,7 +341,7 @@ QGst::ElementPtr DeviceElementFactory::makeAudioOutputElement()
 
     //for kde environments try to do what phonon does:
     //first try pulseaudio,
-    element = tryElement("pulsesink");
+    element = tryElement("pulsesink", QString(), readyTimeout);
     if (element) {
         addStreamProperties(element);
         return element;
@@ -116,9 +358,9 @@ QGst::ElementPtr DeviceElementFactory::makeAudioOutputElement()
                 //use dmix instead of x-phonon, since we don't have phonon's alsa configuration file
                 QString deviceString = device.second;
                 deviceString.replace("x-phonon", "dmix");
-                element = tryElement("alsasink", deviceString);
+                element = tryElement("alsasink", deviceString, readyTimeout);
             } else if (device.first == "oss") {
-                element = tryElement("osssink", device.second);
+                element = tryElement("osssink", device.second, readyTimeout);
             }
 
             if (element) {
@@ -128,23 +370,39 @@ QGst::ElementPtr DeviceElementFactory::makeAudioOutputElement()
     }
 
     //as a last resort, try gstreamer's autodetection
-    element = tryElement("autoaudiosink");
+    element = tryElement("autoaudiosink", QString(), readyTimeout);
     return element;
 }
 
-QGst::ElementPtr DeviceElementFactory::makeVideoCaptureElement()
+QGst::ElementPtr DeviceElementFactory::makeVideoCaptureElement(int readyTimeout)
 {
     QGst::ElementPtr element;
 
     //allow overrides from the application's configuration file
-    element = tryOverrideForKey("videosrc");
+    element = tryOverrideForKey("videosrc", readyTimeout);
+    if (element) {
+        return element;
+    }
+
+    //try the device that worked the last time, before probing all of them
+    const QString preference = devicePreference(Phonon::VideoCaptureDeviceType);
+    element = tryLastWorkingElement("videosrc", preference, readyTimeout);
     if (element) {
         return element;
     }
 
+    element = probeVideoCaptureElement(readyTimeout);
+    rememberWorkingElement("videosrc", preference, element);
+    return element;
+}
+
+QGst::ElementPtr DeviceElementFactory::probeVideoCaptureElement(int readyTimeout)
+{
+    QGst::ElementPtr element;
+
     //use gconf on non-kde environments
     if (qgetenv("KDE_FULL_SESSION").isEmpty()) {
-        element = tryElement("gconfvideosrc");
+        element = tryElement("gconfvideosrc", QString(), readyTimeout);
         return element;
     }
 
@@ -156,9 +414,9 @@ QGst::ElementPtr DeviceElementFactory::makeVideoCaptureElement()
     Q_FOREACH (const Phonon::DeviceAccessList & deviceList, phononDeviceLists) {
         Q_FOREACH (const Phonon::DeviceAccess & device, deviceList) {
             if(device.first == "v4l2") {
-                element = tryElement("v4l2src", device.second);
+                element = tryElement("v4l2src", device.second, readyTimeout);
             } else if (device.first == "v4l1") {
-                element = tryElement("v4lsrc", device.second);
+                element = tryElement("v4lsrc", device.second, readyTimeout);
             }
         }
 
@@ -168,11 +426,30 @@ QGst::ElementPtr DeviceElementFactory::makeVideoCaptureElement()
     }
 
     //as a last resort, try gstreamer's autodetection
-    element = tryElement("autovideosrc");
+    element = tryElement("autovideosrc", QString(), readyTimeout);
     return element;
 }
 
-QGst::ElementPtr DeviceElementFactory::tryElement(const char *name, const QString & device)
+bool DeviceElementFactory::parallelAcquisitionEnabled()
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    return configGroup.readEntry("parallelacquisition", true);
+}
+
+int DeviceElementFactory::deviceReadyTimeout()
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    return configGroup.readEntry("devicetimeout", 3000);
+}
+
+int DeviceElementFactory::cameraStandbyTimeout()
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    return qMax(0, configGroup.readEntry("camerastandby", 0));
+}
+
+QGst::ElementPtr DeviceElementFactory::tryElement(const char *name, const QString & device,
+                                                  int readyTimeout)
 {
     QGst::ElementPtr element = QGst::ElementFactory::make(name);
     if (!element) {
@@ -188,7 +465,7 @@ QGst::ElementPtr DeviceElementFactory::tryElement(const char *name, const QStrin
         }
     }
 
-    if (!element->setState(QGst::StateReady)) {
+    if (!makeReady(element, readyTimeout)) {
         qCDebug(LIBKTPCALL) << "Element" << name << "with device string" << device << "doesn't want to become ready";
         return QGst::ElementPtr();
     }
@@ -197,7 +474,7 @@ QGst::ElementPtr DeviceElementFactory::tryElement(const char *name, const QStrin
     return element;
 }
 
-QGst::ElementPtr DeviceElementFactory::tryOverrideForKey(const char *keyName)
+QGst::ElementPtr DeviceElementFactory::tryOverrideForKey(const char *keyName, int readyTimeout)
 {
     QGst::ElementPtr element;
     const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
@@ -211,7 +488,7 @@ QGst::ElementPtr DeviceElementFactory::tryOverrideForKey(const char *keyName)
             return element;
         }
 
-        if (!element->setState(QGst::StateReady)) {
+        if (!makeReady(element, readyTimeout)) {
             qCDebug(LIBKTPCALL) << "Custom bin" << binDescription << "doesn't want to become ready";
             return QGst::ElementPtr();
         }
@@ -222,6 +499,93 @@ QGst::ElementPtr DeviceElementFactory::tryOverrideForKey(const char *keyName)
     return element;
 }
 
+bool DeviceElementFactory::makeReady(const QGst::ElementPtr & element, int readyTimeout)
+{
+    if (readyTimeout < 0) {
+        return element->setState(QGst::StateReady) != QGst::StateChangeFailure;
+    }
+
+    //opening a device can block for a long time (or forever, with a broken driver),
+    //so do it in a helper thread and give up on the device if it takes too long
+    QSharedPointer<ReadyTransition> transition(new ReadyTransition(element));
+    s_readyTransitionPool->start(new ReadyTransitionRunnable(transition));
+
+    QMutexLocker l(&transition->mutex);
+    if (!transition->done) {
+        transition->condition.wait(&transition->mutex, readyTimeout);
+    }
+
+    if (!transition->done) {
+        qCDebug(LIBKTPCALL) << "Element" << element->name() << "did not become ready within"
+                            << readyTimeout << "ms";
+        transition->abandoned = true;
+        return false;
+    }
+    return transition->success;
+}
+
+QGst::ElementPtr DeviceElementFactory::tryLastWorkingElement(const char *deviceClass,
+                                                              const QString & preference,
+                                                              int readyTimeout)
+{
+    LastWorkingDevices::Entry entry;
+    if (!s_lastWorkingDevices->find(deviceClass, &entry)) {
+        return QGst::ElementPtr();
+    }
+
+    if (entry.preference != preference) {
+        qCDebug(LIBKTPCALL) << "The" << deviceClass << "preference changed since" << entry.name
+                            << "worked, probing all devices";
+        return QGst::ElementPtr();
+    }
+
+    QGst::ElementPtr element = tryElement(entry.name.constData(), entry.device, readyTimeout);
+    if (!element) {
+        qCDebug(LIBKTPCALL) << "Last working" << deviceClass << "element" << entry.name
+                            << "failed, probing all devices";
+        return element;
+    }
+
+    setupElement(element);
+    return element;
+}
+
+void DeviceElementFactory::setupElement(const QGst::ElementPtr & element)
+{
+    //the same setup that the probe*Element() functions do
+    GstElementFactory *factory = gst_element_get_factory(element);
+    const gchar *name = factory ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)) : "";
+    if (g_str_equal(name, "pulsesrc") || g_str_equal(name, "pulsesink")) {
+        addStreamProperties(element);
+    } else if (g_str_equal(name, "gconfaudiosink")) {
+        element->setProperty("profile", 2 /*chat*/);
+    }
+}
+
+void DeviceElementFactory::rememberWorkingElement(const char *deviceClass, const QString & preference,
+                                                  const QGst::ElementPtr & element)
+{
+    if (!element) {
+        s_lastWorkingDevices->remove(deviceClass);
+        return;
+    }
+
+    GstElementFactory *factory = gst_element_get_factory(element);
+
+    LastWorkingDevices::Entry entry;
+    entry.name = gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory));
+    if (element->findProperty("device")) {
+        entry.device = element->property("device").toString();
+    }
+    entry.preference = preference;
+    s_lastWorkingDevices->insert(deviceClass, entry);
+}
+
+void DeviceElementFactory::forgetLastWorkingElement(const char *deviceClass)
+{
+    s_lastWorkingDevices->remove(deviceClass);
+}
+
 void DeviceElementFactory::addStreamProperties (QGst::ElementPtr element)
 {
     // Echo cancellation magic
@@ -232,3 +596,5 @@ void DeviceElementFactory::addStreamProperties (QGst::ElementPtr element)
 }
 
 } // KTpCallPrivate
+
+#include "device-element-factory.moc"
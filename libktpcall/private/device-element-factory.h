@@ -27,13 +27,46 @@ namespace KTpCallPrivate {
 class DeviceElementFactory
 {
 public:
-    static QGst::ElementPtr makeAudioCaptureElement();
-    static QGst::ElementPtr makeAudioOutputElement();
-    static QGst::ElementPtr makeVideoCaptureElement();
+    /* readyTimeout is the time in ms that each candidate device is given to
+     * reach StateReady before the next one is tried. -1 waits forever. */
+    static QGst::ElementPtr makeAudioCaptureElement(int readyTimeout = -1);
+    static QGst::ElementPtr makeAudioOutputElement(int readyTimeout = -1);
+    static QGst::ElementPtr makeVideoCaptureElement(int readyTimeout = -1);
+
+    /* Whether capture devices should be opened in worker threads, see PendingDeviceElement */
+    static bool parallelAcquisitionEnabled();
+    static int deviceReadyTimeout();
+
+    /* How long, in ms, a camera stays open after video stops being sent, so that
+     * sending again does not wait for the device. An open camera keeps its light
+     * on, so this is 0 unless configured: it closes right away */
+    static int cameraStandbyTimeout();
+
+    /* The setup that make*Element() gives to the elements that it makes, for an
+     * element that was made elsewhere, e.g. from a plugged device */
+    static void setupElement(const QGst::ElementPtr & element);
+
+    /* Makes the next make*Element() call probe all devices of deviceClass
+     * ("audiosrc", "audiosink" or "videosrc"), e.g. after a device was plugged */
+    static void forgetLastWorkingElement(const char *deviceClass);
 
 private:
-    static QGst::ElementPtr tryElement(const char *name, const QString & device = QString());
-    static QGst::ElementPtr tryOverrideForKey(const char *keyName);
+    static QGst::ElementPtr probeAudioCaptureElement(int readyTimeout);
+    static QGst::ElementPtr probeAudioOutputElement(int readyTimeout);
+    static QGst::ElementPtr probeVideoCaptureElement(int readyTimeout);
+
+    /* The element name and device string that were last successfully probed
+     * for each device class are kept in the LastWorkingDevices config group,
+     * along with the device preference that the probe followed */
+    static QGst::ElementPtr tryLastWorkingElement(const char *deviceClass, const QString & preference,
+                                                  int readyTimeout);
+    static void rememberWorkingElement(const char *deviceClass, const QString & preference,
+                                       const QGst::ElementPtr & element);
+
+    static QGst::ElementPtr tryElement(const char *name, const QString & device = QString(),
+                                       int readyTimeout = -1);
+    static QGst::ElementPtr tryOverrideForKey(const char *keyName, int readyTimeout = -1);
+    static bool makeReady(const QGst::ElementPtr & element, int readyTimeout);
     static void addStreamProperties(const QGst::ElementPtr element);
 };
 
@@ -0,0 +1,165 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "device-monitor.h"
+#include "../libktpcall_debug.h"
+
+#include <QGlib/Connect>
+#include <QGst/Element>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+static const char *s_classFilters[] = { "Audio/Source", "Audio/Sink", "Video/Source" };
+
+DeviceMonitor::DeviceMonitor(QObject *parent)
+    : QObject(parent),
+      m_monitor(gst_device_monitor_new()),
+      m_started(false)
+{
+    gst_device_monitor_add_filter(m_monitor, s_classFilters[AudioSource], NULL);
+    gst_device_monitor_add_filter(m_monitor, s_classFilters[AudioSink], NULL);
+    gst_device_monitor_add_filter(m_monitor, s_classFilters[VideoSource], NULL);
+
+    m_bus = QGst::BusPtr::wrap(gst_device_monitor_get_bus(m_monitor), false);
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    stop();
+    gst_object_unref(m_monitor);
+}
+
+bool DeviceMonitor::start()
+{
+    if (m_started) {
+        return true;
+    }
+
+    if (!gst_device_monitor_start(m_monitor)) {
+        qCWarning(LIBKTPCALL) << "Failed to start the device monitor; devices will not be hot-swapped";
+        return false;
+    }
+
+    GList *devices = gst_device_monitor_get_devices(m_monitor);
+    for (GList *l = devices; l; l = l->next) {
+        m_knownDevices.append(QGlib::ObjectPtr::wrap(G_OBJECT(l->data), false));
+    }
+    g_list_free(devices);
+
+    m_bus->addSignalWatch();
+    QGlib::connect(m_bus, "message", this, &DeviceMonitor::onBusMessage);
+    m_started = true;
+    return true;
+}
+
+void DeviceMonitor::stop()
+{
+    if (m_started) {
+        QGlib::disconnect(m_bus, "message", this, &DeviceMonitor::onBusMessage);
+        m_bus->removeSignalWatch();
+        gst_device_monitor_stop(m_monitor);
+        m_knownDevices.clear();
+        m_started = false;
+    }
+}
+
+QGst::ElementPtr DeviceMonitor::createElement(const QGlib::ObjectPtr & device)
+{
+    GstElement *e = gst_device_create_element(GST_DEVICE(static_cast<GObject*>(device)), NULL);
+    if (!e) {
+        qCDebug(LIBKTPCALL) << "Could not create element for device" << displayName(device);
+        return QGst::ElementPtr();
+    }
+
+    QGst::ElementPtr element = QGst::ElementPtr::wrap(e);
+    if (!element->setState(QGst::StateReady)) {
+        qCDebug(LIBKTPCALL) << "Device" << displayName(device) << "doesn't want to become ready";
+        return QGst::ElementPtr();
+    }
+
+    qCDebug(LIBKTPCALL) << "Using device" << displayName(device);
+    return element;
+}
+
+QString DeviceMonitor::displayName(const QGlib::ObjectPtr & device)
+{
+    gchar *name = gst_device_get_display_name(GST_DEVICE(static_cast<GObject*>(device)));
+    QString result = QString::fromUtf8(name);
+    g_free(name);
+    return result;
+}
+
+bool DeviceMonitor::isHeadset(const QGlib::ObjectPtr & device)
+{
+    GstStructure *properties = gst_device_get_properties(GST_DEVICE(static_cast<GObject*>(device)));
+    if (!properties) {
+        return false;
+    }
+
+    //pulsesrc devices carry the PulseAudio properties; a monitor of a headset has its form factor too
+    const gchar *formFactor = gst_structure_get_string(properties, "device.form_factor");
+    const gchar *deviceClass = gst_structure_get_string(properties, "device.class");
+    bool headset = formFactor && (g_str_equal(formFactor, "headset") || g_str_equal(formFactor, "handsfree"))
+            && !(deviceClass && g_str_equal(deviceClass, "monitor"));
+    gst_structure_free(properties);
+    return headset;
+}
+
+void DeviceMonitor::onBusMessage(const QGst::MessagePtr & message)
+{
+    GstMessage *msg = message;
+    GstDevice *gstDevice = NULL;
+
+    bool added;
+    switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_DEVICE_ADDED:
+        gst_message_parse_device_added(msg, &gstDevice);
+        added = true;
+        break;
+    case GST_MESSAGE_DEVICE_REMOVED:
+        gst_message_parse_device_removed(msg, &gstDevice);
+        added = false;
+        break;
+    default:
+        return;
+    }
+
+    QGlib::ObjectPtr device = QGlib::ObjectPtr::wrap(G_OBJECT(gstDevice), false);
+
+    if (added && m_knownDevices.contains(device)) {
+        return;
+    }
+
+    if (added) {
+        m_knownDevices.append(device);
+    } else {
+        m_knownDevices.removeAll(device);
+    }
+
+    for (int i = AudioSource; i <= VideoSource; ++i) {
+        if (gst_device_has_classes(gstDevice, s_classFilters[i])) {
+            qCDebug(LIBKTPCALL) << "Device" << (added ? "added:" : "removed:") << displayName(device);
+            if (added) {
+                Q_EMIT deviceAdded(static_cast<DeviceClass>(i), device);
+            } else {
+                Q_EMIT deviceRemoved(static_cast<DeviceClass>(i), device);
+            }
+        }
+    }
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,75 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DEVICE_MONITOR_H
+#define DEVICE_MONITOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QList>
+#include <QGlib/Object>
+#include <QGst/Bus>
+#include <QGst/Message>
+
+typedef struct _GstDeviceMonitor GstDeviceMonitor;
+
+namespace KTpCallPrivate {
+
+/* Watches GstDeviceMonitor for audio and video devices that
+ * appear or disappear while a call is in progress */
+class DeviceMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    enum DeviceClass {
+        AudioSource,
+        AudioSink,
+        VideoSource
+    };
+
+    explicit DeviceMonitor(QObject *parent = 0);
+    virtual ~DeviceMonitor();
+
+    bool start();
+    void stop();
+
+    /* Creates an element for a device reported by deviceAdded() and sets it to StateReady.
+     * Returns a null pointer if the element cannot be created or does not become ready. */
+    static QGst::ElementPtr createElement(const QGlib::ObjectPtr & device);
+    static QString displayName(const QGlib::ObjectPtr & device);
+
+    /* Whether the sound server marks device as a headset or hands-free device,
+     * as opposed to e.g. the microphone of a webcam or a monitor source */
+    static bool isHeadset(const QGlib::ObjectPtr & device);
+
+Q_SIGNALS:
+    void deviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                     const QGlib::ObjectPtr & device);
+    void deviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                       const QGlib::ObjectPtr & device);
+
+private:
+    void onBusMessage(const QGst::MessagePtr & message);
+
+    GstDeviceMonitor *m_monitor;
+    QGst::BusPtr m_bus;
+    bool m_started;
+    //devices that existed when the monitor started; they are not reported as added
+    QList<QGlib::ObjectPtr> m_knownDevices;
+};
+
+} // KTpCallPrivate
+
+#endif // DEVICE_MONITOR_H
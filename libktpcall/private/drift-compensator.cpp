@@ -0,0 +1,314 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "drift-compensator.h"
+#include "libktpcall_debug.h"
+#include <cmath>
+
+namespace KTpCallPrivate {
+
+//ignore the first seconds, while the device and the pipeline are still settling
+static const GstClockTime s_settleTime = 2 * GST_SECOND;
+//do not trust measurements over a shorter time than this
+static const GstClockTime s_minimumMeasurementTime = 10 * GST_SECOND;
+//anything faster or slower than this is not drift, but a broken clock or a stall
+static const double s_maximumDrift = 0.005;
+
+DriftCompensator::DriftCompensator(const QGst::ElementPtr & resampler, const QGst::ElementPtr & capsFilter,
+                                   const QGst::ElementPtr & src)
+    : m_probe(0),
+      m_capsFilter(capsFilter),
+      m_resetPending(0),
+      m_driftPpm(0),
+      m_sourceClock(NULL),
+      m_sourceSlaveMethod(-1),
+      m_nominalCaps(NULL),
+      m_nominalRate(0),
+      m_correctedRate(0),
+      m_startTime(GST_CLOCK_TIME_NONE),
+      m_measuring(false),
+      m_mediaTime(0)
+{
+    setSource(src);
+
+    //watch what goes into the resampler, so that we can also correct its caps
+    m_pad = resampler->getStaticPad("sink")->peer();
+    if (!m_pad) {
+        qCWarning(LIBKTPCALL) << "The resampler is not linked; no drift compensation";
+        return;
+    }
+
+    m_probe = gst_pad_add_probe(m_pad,
+            GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+            &DriftCompensator::onData, this, NULL);
+}
+
+DriftCompensator::~DriftCompensator()
+{
+    if (m_probe) {
+        gst_pad_remove_probe(m_pad, m_probe);
+    }
+    setSource(QGst::ElementPtr());
+    if (m_nominalCaps) {
+        gst_caps_unref(m_nominalCaps);
+    }
+}
+
+void DriftCompensator::reset(const QGst::ElementPtr & src)
+{
+    QMutexLocker l(&m_resetMutex);
+    m_resetSource = src;
+    m_resetPending.store(1);
+}
+
+int DriftCompensator::driftPpm() const
+{
+    return m_driftPpm.load();
+}
+
+void DriftCompensator::setSource(const QGst::ElementPtr & src)
+{
+    if (m_source && m_sourceSlaveMethod >= 0) {
+        g_object_set(G_OBJECT(static_cast<GstElement*>(m_source)), "slave-method", m_sourceSlaveMethod, NULL);
+    }
+    m_sourceSlaveMethod = -1;
+    if (m_sourceClock) {
+        gst_object_unref(m_sourceClock);
+    }
+
+    m_source = src;
+    m_sourceClock = src ? gst_element_provide_clock(src) : NULL;
+}
+
+GstPadProbeReturn DriftCompensator::onData(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    DriftCompensator *self = static_cast<DriftCompensator*>(data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        self->handleBuffer(pad, GST_PAD_PROBE_INFO_BUFFER(info));
+    } else if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_CAPS) {
+        self->handleCaps(info);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool DriftCompensator::applyPendingReset()
+{
+    if (!m_resetPending.testAndSetRelaxed(1, 0)) {
+        return false;
+    }
+
+    QGst::ElementPtr src;
+    {
+        QMutexLocker l(&m_resetMutex);
+        src = m_resetSource;
+        m_resetSource.clear();
+    }
+    setSource(src);
+
+    //the correction was for the old device
+    m_correctedRate = 0;
+    m_driftPpm.store(0);
+    m_startTime = GST_CLOCK_TIME_NONE;
+    m_mediaTime = 0;
+    return true;
+}
+
+void DriftCompensator::handleCaps(GstPadProbeInfo *info)
+{
+    //the new device sends its caps before its first buffer
+    applyPendingReset();
+
+    GstCaps *caps;
+    gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+
+    int rate = 0;
+    if (gst_caps_get_size(caps) == 0
+            || !gst_structure_get_int(gst_caps_get_structure(caps, 0), "rate", &rate)
+            || rate <= 0) {
+        return;
+    }
+
+    if (m_nominalCaps) {
+        gst_caps_unref(m_nominalCaps);
+    }
+    m_nominalCaps = gst_caps_ref(caps);
+    m_nominalRate = rate;
+    m_startTime = GST_CLOCK_TIME_NONE;
+    m_mediaTime = 0;
+
+    //keep the correction across renegotiations, the device has not changed
+    if (m_correctedRate) {
+        int correctedRate = qRound(m_nominalRate * (1.0 + m_driftPpm.load() / 1000000.0));
+        if (!outputRateFixed(correctedRate)) {
+            m_correctedRate = 0;
+            return;
+        }
+        m_correctedRate = correctedRate;
+        GstCaps *corrected = correctedCaps();
+        gst_event_unref(GST_PAD_PROBE_INFO_EVENT(info));
+        GST_PAD_PROBE_INFO_DATA(info) = gst_event_new_caps(corrected);
+        gst_caps_unref(corrected);
+    }
+}
+
+bool DriftCompensator::outputRateFixed(int rate) const
+{
+    GstCaps *caps = NULL;
+    g_object_get(G_OBJECT(static_cast<GstElement*>(m_capsFilter)), "caps", &caps, NULL);
+    if (!caps) {
+        return false;
+    }
+
+    int outputRate = 0;
+    bool fixed = !gst_caps_is_any(caps) && gst_caps_get_size(caps) > 0
+            && gst_structure_get_int(gst_caps_get_structure(caps, 0), "rate", &outputRate)
+            && outputRate != rate;
+    gst_caps_unref(caps);
+    return fixed;
+}
+
+GstCaps *DriftCompensator::correctedCaps() const
+{
+    GstCaps *caps = gst_caps_copy(m_nominalCaps);
+    gst_caps_set_simple(caps, "rate", G_TYPE_INT, m_correctedRate ? m_correctedRate : m_nominalRate, NULL);
+    return caps;
+}
+
+void DriftCompensator::setCorrectedRate(GstPad *pad, int rate)
+{
+    m_correctedRate = rate;
+
+    //resyncing on its own would fight the correction; without one, let it be
+    GObject *object = m_source ? G_OBJECT(static_cast<GstElement*>(m_source)) : NULL;
+    if (object && g_object_class_find_property(G_OBJECT_GET_CLASS(object), "slave-method")) {
+        if (rate && m_sourceSlaveMethod < 0) {
+            g_object_get(object, "slave-method", &m_sourceSlaveMethod, NULL);
+            gst_util_set_object_arg(object, "slave-method", "none");
+        } else if (!rate && m_sourceSlaveMethod >= 0) {
+            g_object_set(object, "slave-method", m_sourceSlaveMethod, NULL);
+            m_sourceSlaveMethod = -1;
+        }
+    }
+
+    //this reaches the resampler before the buffer that is being pushed
+    GstPad *peer = gst_pad_get_peer(pad);
+    if (peer) {
+        GstCaps *corrected = correctedCaps();
+        gst_pad_send_event(peer, gst_event_new_caps(corrected));
+        gst_caps_unref(corrected);
+        gst_object_unref(peer);
+    }
+}
+
+void DriftCompensator::handleBuffer(GstPad *pad, GstBuffer *buffer)
+{
+    if (applyPendingReset()) {
+        //back to the nominal rate, in case the device kept its caps
+        if (m_nominalCaps) {
+            setCorrectedRate(pad, 0);
+        }
+    }
+
+    if (!m_nominalCaps || !GST_BUFFER_DURATION_IS_VALID(buffer)) {
+        return;
+    }
+
+    //the capture rate must not get past the resampler, e.g. while the send codec is not known
+    if (m_correctedRate && !outputRateFixed(m_correctedRate)) {
+        qCDebug(LIBKTPCALL) << "The capture rate is no longer fixed after the resampler; "
+                               "dropping the drift correction";
+        setCorrectedRate(pad, 0);
+    }
+
+    GstElement *element = GST_ELEMENT(gst_pad_get_parent(pad));
+    if (!element) {
+        return;
+    }
+    GstClock *clock = gst_element_get_clock(element);
+    GstClockTime baseTime = gst_element_get_base_time(element);
+    gst_object_unref(element);
+    if (!clock) {
+        return;
+    }
+
+    //the pipeline runs on the device's own clock, so the device cannot drift from it
+    if (clock == m_sourceClock) {
+        gst_object_unref(clock);
+        if (m_correctedRate) {
+            setCorrectedRate(pad, 0);
+        }
+        m_driftPpm.store(0);
+        return;
+    }
+
+    GstClockTime now = gst_clock_get_time(clock) - baseTime;
+    gst_object_unref(clock);
+
+    //a discontinuity means lost samples, which would read as drift
+    if (GST_BUFFER_IS_DISCONT(buffer)) {
+        m_startTime = GST_CLOCK_TIME_NONE;
+        m_mediaTime = 0;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID(m_startTime)) {
+        m_startTime = now + s_settleTime;
+        m_measuring = false;
+        return;
+    }
+    if (!m_measuring) {
+        //this buffer only marks the start; the audio of the buffers after it
+        //is captured between its arrival and the arrival of the last one
+        if (now >= m_startTime) {
+            m_startTime = now;
+            m_measuring = true;
+        }
+        return;
+    }
+    //buffer durations are computed from the sample count at the nominal rate
+    m_mediaTime += GST_BUFFER_DURATION(buffer);
+
+    GstClockTime elapsed = now - m_startTime;
+    if (elapsed < s_minimumMeasurementTime) {
+        return;
+    }
+
+    //the audio counted so far was produced during the elapsed pipeline time
+    double drift = double(m_mediaTime) / elapsed - 1.0;
+    if (std::fabs(drift) > s_maximumDrift) {
+        qCDebug(LIBKTPCALL) << "Ignoring implausible capture drift of" << drift * 1000000 << "ppm";
+        m_startTime = GST_CLOCK_TIME_NONE;
+        m_mediaTime = 0;
+        return;
+    }
+    double measuredRate = m_nominalRate * (1.0 + drift);
+    m_driftPpm.store(qRound(drift * 1000000));
+
+    //the resampler takes integer rates, which is a resolution of about 20 ppm at 48 kHz
+    int correctedRate = qRound(measuredRate);
+    if (correctedRate == (m_correctedRate ? m_correctedRate : m_nominalRate)) {
+        return;
+    }
+    if (!outputRateFixed(correctedRate)) {
+        return;
+    }
+
+    qCDebug(LIBKTPCALL) << "Capture device drifts by" << m_driftPpm.load()
+                        << "ppm; resampling from" << correctedRate << "Hz";
+    setCorrectedRate(pad, correctedRate == m_nominalRate ? 0 : correctedRate);
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,87 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DRIFT_COMPENSATOR_H
+#define DRIFT_COMPENSATOR_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QGst/Element>
+#include <QGst/Pad>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+/* Keeps a capture device in step with the clock that the pipeline runs on.
+ *
+ * GstBin picks that clock itself: usually the one of the most upstream provider,
+ * which may be the capture device (then there is nothing to correct), another
+ * device, or the system clock. It counts the samples that arrive at an
+ * audioresample element against that clock and, once the device is known to run
+ * fast or slow, tells the resampler the measured rate instead of the nominal one.
+ * The resampler then produces exactly the nominal rate in pipeline time, instead
+ * of latency creeping up until the device drops or repeats samples.
+ *
+ * The measured rate never leaves the resampler: it is only used while capsFilter,
+ * right after it, fixes the rate of the output to something else. */
+class DriftCompensator
+{
+    Q_DISABLE_COPY(DriftCompensator)
+public:
+    DriftCompensator(const QGst::ElementPtr & resampler, const QGst::ElementPtr & capsFilter,
+                     const QGst::ElementPtr & src);
+    ~DriftCompensator();
+
+    /* Drops the correction and starts measuring from scratch
+     * for src, e.g. after the capture device was replaced */
+    void reset(const QGst::ElementPtr & src);
+
+    /* The last measured drift of the capture device, in parts per million */
+    int driftPpm() const;
+
+private:
+    static GstPadProbeReturn onData(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    bool applyPendingReset();
+    void handleCaps(GstPadProbeInfo *info);
+    void handleBuffer(GstPad *pad, GstBuffer *buffer);
+    bool outputRateFixed(int rate) const;
+    void setCorrectedRate(GstPad *pad, int rate);
+    GstCaps *correctedCaps() const;
+    void setSource(const QGst::ElementPtr & src);
+
+    QGst::PadPtr m_pad;
+    gulong m_probe;
+    QGst::ElementPtr m_capsFilter;
+    QAtomicInt m_resetPending;
+    QAtomicInt m_driftPpm;
+    QMutex m_resetMutex;
+    QGst::ElementPtr m_resetSource;
+
+    //only used from the streaming thread
+    QGst::ElementPtr m_source;
+    GstClock *m_sourceClock; //the clock that the device provides, if any
+    int m_sourceSlaveMethod; //-1 while the source slaves itself as it wants
+    GstCaps *m_nominalCaps;
+    int m_nominalRate;
+    int m_correctedRate;
+    GstClockTime m_startTime;
+    bool m_measuring;
+    GstClockTime m_mediaTime; //duration of the audio that arrived since m_startTime
+};
+
+} // KTpCallPrivate
+
+#endif // DRIFT_COMPENSATOR_H
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "level-filter.h"
+#include <gst/gst.h>
+#include <cmath>
+
+namespace KTpCallPrivate {
+
+static const char s_levelStateKey[] = "ktpcall-level-state";
+Q_GLOBAL_STATIC(QMutex, s_attachMutex)
+
+/* returns the loudest channel of the "rms" or "peak" field of a level message */
+static double maxChannelValue(const GstStructure *s, const char *field)
+{
+    const GValue *list = gst_structure_get_value(s, field);
+    if (!list) {
+        return -INFINITY;
+    }
+
+    double result = -INFINITY;
+    if (GST_VALUE_HOLDS_ARRAY(list)) {
+        for (guint i = 0; i < gst_value_array_get_size(list); ++i) {
+            result = qMax(result, g_value_get_double(gst_value_array_get_value(list, i)));
+        }
+    } else if (G_VALUE_HOLDS(list, G_TYPE_VALUE_ARRAY)) {
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+        GValueArray *array = static_cast<GValueArray*>(g_value_get_boxed(list));
+        for (guint i = 0; i < array->n_values; ++i) {
+            result = qMax(result, g_value_get_double(g_value_array_get_nth(array, i)));
+        }
+G_GNUC_END_IGNORE_DEPRECATIONS
+    }
+    return result;
+}
+
+static gpointer dupLevelState(gpointer data, gpointer userData)
+{
+    Q_UNUSED(userData);
+    return data ? new QSharedPointer<LevelState>(*static_cast<QSharedPointer<LevelState>*>(data)) : NULL;
+}
+
+static void destroyLevelState(gpointer data)
+{
+    delete static_cast<QSharedPointer<LevelState>*>(data);
+}
+
+GstBusSyncReply LevelFilter::filter(GstMessage *message)
+{
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_ELEMENT) {
+        return GST_BUS_PASS;
+    }
+
+    const GstStructure *s = gst_message_get_structure(message);
+    if (!s || !gst_structure_has_name(s, "level")) {
+        return GST_BUS_PASS;
+    }
+
+    //take a reference under the qdata lock, the state may be detached from the main thread
+    QSharedPointer<LevelState> *statePtr = static_cast<QSharedPointer<LevelState>*>(
+            g_object_dup_data(G_OBJECT(GST_MESSAGE_SRC(message)), s_levelStateKey,
+                              &dupLevelState, NULL));
+    if (!statePtr) {
+        return GST_BUS_PASS;
+    }
+    QSharedPointer<LevelState> state = *statePtr;
+    delete statePtr;
+
+    double rms = maxChannelValue(s, "rms");
+    double peak = maxChannelValue(s, "peak");
+
+    QMutexLocker l(&state->mutex);
+    state->rms = rms;
+    state->peak = peak;
+    state->fresh = true;
+    return GST_BUS_DROP;
+}
+
+QSharedPointer<LevelState> LevelFilter::attach(const QGst::ElementPtr & level)
+{
+    QMutexLocker l(s_attachMutex());
+    GObject *object = G_OBJECT(static_cast<GstElement*>(level));
+
+    QSharedPointer<LevelState> *existing = static_cast<QSharedPointer<LevelState>*>(
+            g_object_get_data(object, s_levelStateKey));
+    if (existing) {
+        (*existing)->users++;
+        return *existing;
+    }
+
+    QSharedPointer<LevelState> state(new LevelState);
+    state->users = 1;
+    g_object_set_data_full(object, s_levelStateKey,
+                           new QSharedPointer<LevelState>(state), &destroyLevelState);
+    return state;
+}
+
+void LevelFilter::detach(const QGst::ElementPtr & level)
+{
+    QMutexLocker l(s_attachMutex());
+    GObject *object = G_OBJECT(static_cast<GstElement*>(level));
+
+    QSharedPointer<LevelState> *existing = static_cast<QSharedPointer<LevelState>*>(
+            g_object_get_data(object, s_levelStateKey));
+    if (existing && --(*existing)->users > 0) {
+        return;
+    }
+    g_object_set_data(object, s_levelStateKey, NULL);
+}
+
+bool LevelFilter::isShared(const QGst::ElementPtr & level)
+{
+    QMutexLocker l(s_attachMutex());
+    QSharedPointer<LevelState> *existing = static_cast<QSharedPointer<LevelState>*>(
+            g_object_get_data(G_OBJECT(static_cast<GstElement*>(level)), s_levelStateKey));
+    return existing && (*existing)->users > 1;
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LEVEL_FILTER_H
+#define LEVEL_FILTER_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QGst/Element>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+/* The latest values reported by one level element */
+struct LevelState
+{
+    LevelState() : rms(0), peak(0), fresh(false), users(0) {}
+
+    QMutex mutex;
+    double rms;
+    double peak;
+    bool fresh;
+    int users; //attach() calls that have not been detached yet
+};
+
+/* Coalesces the messages of the level elements in the streaming thread.
+ * A bus sync handler stores the values of every level element that has a
+ * LevelState attached and drops the message, so that level messages never
+ * reach the main loop; LevelController polls the state at its own rate. */
+class LevelFilter
+{
+public:
+    /* For the bus sync handler; drops the level messages that it stored */
+    static GstBusSyncReply filter(GstMessage *message);
+
+    /* Several users may attach to the same element; they share one state */
+    static QSharedPointer<LevelState> attach(const QGst::ElementPtr & level);
+    static void detach(const QGst::ElementPtr & level);
+    static bool isShared(const QGst::ElementPtr & level);
+};
+
+} // KTpCallPrivate
+
+#endif // LEVEL_FILTER_H
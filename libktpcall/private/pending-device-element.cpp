@@ -0,0 +1,127 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pending-device-element.h"
+#include "device-element-factory.h"
+#include "../libktpcall_debug.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+#include <QGst/Element>
+
+namespace KTpCallPrivate {
+
+struct PendingDeviceElementData
+{
+    PendingDeviceElementData(PendingDeviceElement::DeviceType type, PendingDeviceElement *owner)
+        : type(type), owner(owner), done(false), abandoned(false) {}
+
+    PendingDeviceElement::DeviceType type;
+    PendingDeviceElement *owner; //only valid while not abandoned
+    QMutex mutex;
+    QWaitCondition condition;
+    QGst::ElementPtr element;
+    bool done;
+    bool abandoned;
+};
+
+namespace {
+
+class AcquisitionRunnable : public QRunnable
+{
+public:
+    explicit AcquisitionRunnable(const QSharedPointer<PendingDeviceElementData> & data)
+        : m_data(data) {}
+
+    virtual void run()
+    {
+        const int timeout = DeviceElementFactory::deviceReadyTimeout();
+        QGst::ElementPtr element;
+
+        switch (m_data->type) {
+        case PendingDeviceElement::AudioCapture:
+            element = DeviceElementFactory::makeAudioCaptureElement(timeout);
+            break;
+        case PendingDeviceElement::VideoCapture:
+            element = DeviceElementFactory::makeVideoCaptureElement(timeout);
+            break;
+        }
+
+        QMutexLocker l(&m_data->mutex);
+        if (m_data->abandoned) {
+            if (element) {
+                element->setState(QGst::StateNull);
+            }
+        } else {
+            m_data->element = element;
+            //queued, so that it is delivered in the owner's thread, or dropped if it is deleted by then
+            QMetaObject::invokeMethod(m_data->owner, "finished", Qt::QueuedConnection);
+        }
+        m_data->done = true;
+        m_data->condition.wakeAll();
+    }
+
+private:
+    QSharedPointer<PendingDeviceElementData> m_data;
+};
+
+/* one thread per device class, regardless of the number of cores */
+class AcquisitionPool : public QThreadPool
+{
+public:
+    AcquisitionPool() { setMaxThreadCount(4); }
+};
+
+Q_GLOBAL_STATIC(AcquisitionPool, s_acquisitionPool)
+
+} // namespace
+
+PendingDeviceElement::PendingDeviceElement(DeviceType type, QObject *parent)
+    : QObject(parent),
+      d(new PendingDeviceElementData(type, this))
+{
+    qCDebug(LIBKTPCALL) << "Starting acquisition of device type" << type;
+    s_acquisitionPool->start(new AcquisitionRunnable(d));
+}
+
+PendingDeviceElement::~PendingDeviceElement()
+{
+    QMutexLocker l(&d->mutex);
+    if (d->done) {
+        if (d->element) {
+            d->element->setState(QGst::StateNull);
+            d->element.clear();
+        }
+    } else {
+        d->abandoned = true;
+    }
+}
+
+QGst::ElementPtr PendingDeviceElement::takeElement()
+{
+    QMutexLocker l(&d->mutex);
+    while (!d->done) {
+        d->condition.wait(&d->mutex);
+    }
+
+    QGst::ElementPtr element = d->element;
+    d->element.clear();
+    return element;
+}
+
+} // KTpCallPrivate
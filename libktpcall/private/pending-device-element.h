@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PENDING_DEVICE_ELEMENT_H
+#define PENDING_DEVICE_ELEMENT_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QGst/Global>
+
+namespace KTpCallPrivate {
+
+struct PendingDeviceElementData;
+
+/* Opens a capture device through DeviceElementFactory in a worker thread.
+ * Content handlers start one of these when they are asked to send, so that
+ * the microphone and the camera are opened in parallel and away from the
+ * main thread, and finish sending when finished() is emitted. */
+class PendingDeviceElement : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PendingDeviceElement)
+public:
+    enum DeviceType {
+        AudioCapture,
+        VideoCapture
+    };
+
+    explicit PendingDeviceElement(DeviceType type, QObject *parent = 0);
+
+    /* If the element was not taken, it is released as soon as the worker finishes */
+    virtual ~PendingDeviceElement();
+
+    /* Waits for the worker thread and returns the element it made, which is left
+     * in StateReady, or a null pointer if no device could be opened.
+     * Subsequent calls return a null pointer. After finished(), this does not block. */
+    QGst::ElementPtr takeElement();
+
+Q_SIGNALS:
+    /* Emitted in the thread of this object once the worker is done */
+    void finished();
+
+private:
+    QSharedPointer<PendingDeviceElementData> d;
+};
+
+} // KTpCallPrivate
+
+#endif // PENDING_DEVICE_ELEMENT_H
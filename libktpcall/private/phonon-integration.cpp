@@ -25,23 +25,63 @@
 #include "phonon-integration.h"
 #include "../libktpcall_debug.h"
 #include <QtCore/QDataStream>
+#include <QtCore/QMutex>
 #include <QtCore/QSettings>
-#include <QtDBus/QDBusInterface>
-#include <QtDBus/QDBusReply>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
 
 Q_DECLARE_METATYPE(QList<int>)
 
 namespace KTpCallPrivate {
 
-struct PhononIntegrationPrivate
+typedef QHash<QByteArray, QVariant> DeviceProperties;
+
+/* The state of fetching the device list of one ObjectDescriptionType from phononserver.
+ * All calls are pipelined; nothing waits for a reply unless readDevices() needs the
+ * answer before it has arrived, and nothing waits with the mutex locked. */
+struct DeviceFetch
 {
+    DeviceFetch(const QDBusPendingCall & loadModuleCall, const QDBusPendingCall & indexesCall)
+        : loadModuleCall(loadModuleCall),
+          indexesCall(indexesCall),
+          propertiesRequested(false),
+          finished(false)
+    {
+    }
+
+    QDBusPendingCall loadModuleCall;
+    QDBusPendingCall indexesCall;
+    //set once the properties calls have been sent, by whoever got there first
+    QList<int> indices;
+    QList<QDBusPendingCall> propertiesCalls;
+    bool propertiesRequested;
+
+    bool finished;
+    QHash<int, DeviceProperties> properties;
+};
+
+class PhononIntegrationPrivate : public QObject
+{
+    Q_OBJECT
+public:
     PhononIntegrationPrivate()
         : phononSettings(QLatin1String("kde.org"), QLatin1String("libphonon")),
-          phononServer(QLatin1String("org.kde.kded"),
-                       QLatin1String("/modules/phononserver"),
-                       QLatin1String("org.kde.PhononServer"))
+          cacheGeneration(0)
     {
         registerMetaTypes();
+
+        QDBusConnection::sessionBus().connect(QLatin1String("org.kde.kded"),
+                                              QLatin1String("/modules/phononserver"),
+                                              QLatin1String("org.kde.PhononServer"),
+                                              QLatin1String("devicesChanged"),
+                                              this, SLOT(onDevicesChanged()));
+    }
+
+    virtual ~PhononIntegrationPrivate()
+    {
+        qDeleteAll(fetches);
     }
 
     void registerMetaTypes()
@@ -68,47 +108,56 @@ struct PhononIntegrationPrivate
         }
     }
 
+    /* Must be called with the mutex locked */
+    DeviceFetch *startFetch(Phonon::ObjectDescriptionType type, bool async);
+
+    /* Must be called with the mutex unlocked, as they wait for phononserver */
+    static bool requestProperties(Phonon::ObjectDescriptionType type,
+                                  const QDBusPendingCall & loadModuleCall,
+                                  const QDBusPendingCall & indexesCall,
+                                  QList<int> *indices, QList<QDBusPendingCall> *propertiesCalls);
+
+private Q_SLOTS:
+    void onIndexesCallFinished(QDBusPendingCallWatcher *watcher);
+    void onDevicesChanged();
+
+public:
     QSettings phononSettings;
-    QDBusInterface phononServer;
+    QMutex mutex;
+    QHash<int, DeviceFetch*> fetches;
+    uint cacheGeneration;
 };
 
 Q_GLOBAL_STATIC(PhononIntegrationPrivate, s_priv);
 
 
-QList<Phonon::DeviceAccessList> PhononIntegration::readDevices(Phonon::ObjectDescriptionType type,
-                                                               Phonon::Category category)
+static inline QDBusPendingCall phononServerCall(const QString & method, int argument)
 {
-    QDBusInterface kded (QLatin1String("org.kde.kded"),
-                                     QLatin1String("/kded"),
-                                     QLatin1String("org.kde.kded"));
-
-    QDBusReply<bool> phononLoaded = kded.call(QLatin1String("loadModule"), QLatin1String("phononserver"));
-
-    if(!phononLoaded) {
-        qWarning() << "Could not load phononserver!!";
-        return QList<Phonon::DeviceAccessList>();
-    }
+    QDBusMessage message = QDBusMessage::createMethodCall(QLatin1String("org.kde.kded"),
+                                                          QLatin1String("/modules/phononserver"),
+                                                          QLatin1String("org.kde.PhononServer"),
+                                                          method);
+    message << argument;
+    return QDBusConnection::sessionBus().asyncCall(message);
+}
 
-    switch (type) {
-    case Phonon::AudioOutputDeviceType:
-    case Phonon::AudioCaptureDeviceType:
-        return readAudioDevices(type, category);
-        break;
-    case Phonon::VideoCaptureDeviceType:
-        return readVideoDevices(type, category);
-        break;
-    default:
-        break;
+static inline QLatin1String methodName(Phonon::ObjectDescriptionType type, bool properties)
+{
+    if (type == Phonon::VideoCaptureDeviceType) {
+        return properties ? QLatin1String("videoDevicesProperties")
+                          : QLatin1String("videoDevicesIndexes");
+    } else {
+        return properties ? QLatin1String("audioDevicesProperties")
+                          : QLatin1String("audioDevicesIndexes");
     }
-
-    return QList<Phonon::DeviceAccessList>();
 }
 
 template <typename R>
-static inline R dbusCall(QDBusInterface & interface, const QString & method, int argument)
+static inline R dbusReply(QDBusPendingCall call, const QString & method)
 {
     R r;
-    QDBusReply<QByteArray> reply = interface.call(method, argument);
+    QDBusPendingReply<QByteArray> reply = call;
+    reply.waitForFinished();
     if (!reply.isValid()) {
         qWarning() << "error calling dbus" << method << reply.error();
         return r;
@@ -119,59 +168,199 @@ static inline R dbusCall(QDBusInterface & interface, const QString & method, int
     return r;
 }
 
-QList<Phonon::DeviceAccessList> PhononIntegration::readAudioDevices(Phonon::ObjectDescriptionType type,
-                                                                    Phonon::Category category)
+DeviceFetch *PhononIntegrationPrivate::startFetch(Phonon::ObjectDescriptionType type, bool async)
 {
-    QList<Phonon::DeviceAccessList> list;
+    DeviceFetch *fetch = fetches.value(type);
+    if (fetch) {
+        return fetch;
+    }
 
-    QList<int> indices = dbusCall< QList<int> >(s_priv->phononServer,
-                                                QLatin1String("audioDevicesIndexes"), type);
+    qCDebug(LIBKTPCALL) << "fetching devices of type" << type << "from phononserver";
+
+    // kded processes our messages in order, so the module is
+    // guaranteed to be loaded by the time the indexes call is handled
+    QDBusMessage loadModule = QDBusMessage::createMethodCall(QLatin1String("org.kde.kded"),
+                                                             QLatin1String("/kded"),
+                                                             QLatin1String("org.kde.kded"),
+                                                             QLatin1String("loadModule"));
+    loadModule << QLatin1String("phononserver");
+
+    fetch = new DeviceFetch(QDBusConnection::sessionBus().asyncCall(loadModule),
+                            phononServerCall(methodName(type, false), type));
+    fetches.insert(type, fetch);
+
+    if (async) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(fetch->indexesCall, this);
+        watcher->setProperty("ktpcall_device_type", static_cast<int>(type));
+        watcher->setProperty("ktpcall_cache_generation", cacheGeneration);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onIndexesCallFinished(QDBusPendingCallWatcher*)));
+    }
 
-    indices = sortDevicesByCategoryPriority(type, category, indices);
+    return fetch;
+}
 
-    for (int i=0; i < indices.size(); ++i) {
-        QHash<QByteArray, QVariant> properties =
-            dbusCall< QHash<QByteArray, QVariant> >(s_priv->phononServer,
-                                                    QLatin1String("audioDevicesProperties"),
-                                                    indices.at(i));
+bool PhononIntegrationPrivate::requestProperties(Phonon::ObjectDescriptionType type,
+                                                 const QDBusPendingCall & loadModuleCall,
+                                                 const QDBusPendingCall & indexesCall,
+                                                 QList<int> *indices,
+                                                 QList<QDBusPendingCall> *propertiesCalls)
+{
+    QDBusPendingReply<bool> phononLoaded = loadModuleCall;
+    phononLoaded.waitForFinished();
+    if (!phononLoaded.isValid() || !phononLoaded.value()) {
+        qWarning() << "Could not load phononserver!!";
+        return false;
+    }
 
-        if (hideAdvancedDevices()) {
-            const QVariant var = properties.value("isAdvanced");
-            if (var.isValid() && var.toBool()) {
-                qCDebug(LIBKTPCALL) << "hiding device" << indices.at(i)
-                         << "because it is advanced and HideAdvancedDevices is specified";
-                continue;
-            }
-        }
+    *indices = dbusReply< QList<int> >(indexesCall, methodName(type, false));
+    qCDebug(LIBKTPCALL) << "got device indices" << *indices << "for type" << type;
 
-        QVariant accessList = properties.value("deviceAccessList");
-        if (accessList.isValid()) {
-            qCDebug(LIBKTPCALL) << "appending device access list for device" << indices.at(i);
-            list.append(accessList.value<Phonon::DeviceAccessList>());
+    // send all the properties calls at once, so that we only wait for one round trip
+    Q_FOREACH (int index, *indices) {
+        propertiesCalls->append(phononServerCall(methodName(type, true), index));
+    }
+    return true;
+}
+
+void PhononIntegrationPrivate::onIndexesCallFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    Phonon::ObjectDescriptionType type = static_cast<Phonon::ObjectDescriptionType>(
+            watcher->property("ktpcall_device_type").toInt());
+    uint generation = watcher->property("ktpcall_cache_generation").toUInt();
+
+    QDBusPendingCall loadModuleCall;
+    QDBusPendingCall indexesCall;
+    {
+        QMutexLocker l(&mutex);
+        DeviceFetch *fetch = fetches.value(type);
+        // the cache may have been invalidated while this call was in flight
+        if (!fetch || generation != cacheGeneration || fetch->propertiesRequested) {
+            return;
         }
+        loadModuleCall = fetch->loadModuleCall;
+        indexesCall = fetch->indexesCall;
+    }
+
+    //both calls have finished by now, so this does not actually wait
+    QList<int> indices;
+    QList<QDBusPendingCall> propertiesCalls;
+    if (!requestProperties(type, loadModuleCall, indexesCall, &indices, &propertiesCalls)) {
+        return;
+    }
+
+    QMutexLocker l(&mutex);
+    DeviceFetch *fetch = fetches.value(type);
+    if (fetch && generation == cacheGeneration && !fetch->propertiesRequested) {
+        fetch->indices = indices;
+        fetch->propertiesCalls = propertiesCalls;
+        fetch->propertiesRequested = true;
     }
-    return list;
 }
 
-QList<Phonon::DeviceAccessList> PhononIntegration::readVideoDevices(Phonon::ObjectDescriptionType type,
-                                                                    Phonon::Category category)
+void PhononIntegrationPrivate::onDevicesChanged()
 {
-    QList<Phonon::DeviceAccessList> list;
+    qCDebug(LIBKTPCALL) << "phononserver reported a device change; refreshing the device cache";
+
+    QMutexLocker l(&mutex);
+    QList<int> types = fetches.keys();
+    qDeleteAll(fetches);
+    fetches.clear();
+    cacheGeneration++;
+
+    Q_FOREACH (int type, types) {
+        startFetch(static_cast<Phonon::ObjectDescriptionType>(type), true);
+    }
+}
 
-    QList<int> indices = dbusCall< QList<int> >(s_priv->phononServer,
-                                                QLatin1String("videoDevicesIndexes"), type);
-    qCDebug(LIBKTPCALL) << "got video device indices" << indices << "for type" << type;
 
-    indices = sortDevicesByCategoryPriority(type, category, indices);
+void PhononIntegration::prefetchDevices()
+{
+    QMutexLocker l(&s_priv->mutex);
+    s_priv->startFetch(Phonon::AudioCaptureDeviceType, true);
+    s_priv->startFetch(Phonon::AudioOutputDeviceType, true);
+    s_priv->startFetch(Phonon::VideoCaptureDeviceType, true);
+}
+
+QList<Phonon::DeviceAccessList> PhononIntegration::readDevices(Phonon::ObjectDescriptionType type,
+                                                               Phonon::Category category)
+{
+    switch (type) {
+    case Phonon::AudioOutputDeviceType:
+    case Phonon::AudioCaptureDeviceType:
+    case Phonon::VideoCaptureDeviceType:
+        break;
+    default:
+        return QList<Phonon::DeviceAccessList>();
+    }
+
+    QList<int> indices;
+    QHash<int, DeviceProperties> properties;
+    QDBusPendingCall loadModuleCall;
+    QDBusPendingCall indexesCall;
+    QList<QDBusPendingCall> propertiesCalls;
+    bool propertiesRequested;
+    uint generation;
+    {
+        QMutexLocker l(&s_priv->mutex);
+        DeviceFetch *fetch = s_priv->startFetch(type, false);
+        if (fetch->finished) {
+            return deviceAccessLists(type, category, fetch->indices, fetch->properties);
+        }
+        loadModuleCall = fetch->loadModuleCall;
+        indexesCall = fetch->indexesCall;
+        indices = fetch->indices;
+        propertiesCalls = fetch->propertiesCalls;
+        propertiesRequested = fetch->propertiesRequested;
+        generation = s_priv->cacheGeneration;
+    }
+
+    //wait for phononserver without the mutex, so that other callers only wait for
+    //the answers that they need themselves
+    bool failed = !propertiesRequested && !PhononIntegrationPrivate::requestProperties(
+            type, loadModuleCall, indexesCall, &indices, &propertiesCalls);
+    if (!failed) {
+        for (int i = 0; i < propertiesCalls.size(); ++i) {
+            properties.insert(indices.at(i),
+                              dbusReply<DeviceProperties>(propertiesCalls.at(i), methodName(type, true)));
+        }
+    }
+
+    QMutexLocker l(&s_priv->mutex);
+    DeviceFetch *fetch = s_priv->fetches.value(type);
+    if (fetch && generation == s_priv->cacheGeneration && !fetch->finished) {
+        if (failed) {
+            // do not cache failures; try again the next time
+            s_priv->fetches.remove(type);
+            delete fetch;
+        } else {
+            fetch->indices = indices;
+            fetch->properties = properties;
+            fetch->propertiesCalls.clear();
+            fetch->propertiesRequested = true;
+            fetch->finished = true;
+        }
+    }
+    if (failed) {
+        return QList<Phonon::DeviceAccessList>();
+    }
+    return deviceAccessLists(type, category, indices, properties);
+}
+
+QList<Phonon::DeviceAccessList> PhononIntegration::deviceAccessLists(Phonon::ObjectDescriptionType type,
+                                                                     Phonon::Category category,
+                                                                     const QList<int> & devices,
+                                                                     const QHash<int, QHash<QByteArray, QVariant> > & properties)
+{
+    QList<Phonon::DeviceAccessList> list;
+    QList<int> indices = sortDevicesByCategoryPriority(type, category, devices);
 
     for (int i=0; i < indices.size(); ++i) {
-        QHash<QByteArray, QVariant> properties =
-            dbusCall< QHash<QByteArray, QVariant> >(s_priv->phononServer,
-                                                    QLatin1String("videoDevicesProperties"),
-                                                    indices.at(i));
+        const DeviceProperties deviceProperties = properties.value(indices.at(i));
 
         if (hideAdvancedDevices()) {
-            const QVariant var = properties.value("isAdvanced");
+            const QVariant var = deviceProperties.value("isAdvanced");
             if (var.isValid() && var.toBool()) {
                 qCDebug(LIBKTPCALL) << "hiding device" << indices.at(i)
                          << "because it is advanced and HideAdvancedDevices is specified";
@@ -179,7 +368,7 @@ QList<Phonon::DeviceAccessList> PhononIntegration::readVideoDevices(Phonon::Obje
             }
         }
 
-        QVariant accessList = properties.value("deviceAccessList");
+        QVariant accessList = deviceProperties.value("deviceAccessList");
         if (accessList.isValid()) {
             qCDebug(LIBKTPCALL) << "appending device access list for device" << indices.at(i);
             list.append(accessList.value<Phonon::DeviceAccessList>());
@@ -213,6 +402,7 @@ QList<int> PhononIntegration::sortDevicesByCategoryPriority(Phonon::ObjectDescri
 
     if (originalList.size() <= 1) {
         // nothing to sort
+        s_priv->phononSettings.endGroup();
         return originalList;
     } else {
         // make entries unique
@@ -233,6 +423,7 @@ QList<int> PhononIntegration::sortDevicesByCategoryPriority(Phonon::ObjectDescri
         categoryKey = QLatin1String("Category_") + QString::number(static_cast<int>(Phonon::NoCategory));
         if (!s_priv->phononSettings.contains(categoryKey)) {
             // no list in config for NoCategory
+            s_priv->phononSettings.endGroup();
             return originalList;
         }
     }
@@ -256,3 +447,5 @@ QList<int> PhononIntegration::sortDevicesByCategoryPriority(Phonon::ObjectDescri
 }
 
 } // KTpCallPrivate
+
+#include "phonon-integration.moc"
@@ -27,20 +27,29 @@
 
 #include <phonon/Global>
 #include <phonon/ObjectDescription>
+#include <QtCore/QHash>
 
 namespace KTpCallPrivate {
 
 class PhononIntegration
 {
 public:
+    /* Starts fetching all device lists from phononserver in the background,
+     * so that a later readDevices() can be answered from the cache */
+    static void prefetchDevices();
+
+    /* Returns the cached device list of the given type, waiting for phononserver only
+     * if it has not been fetched yet. The cache is refreshed when phononserver
+     * announces that its devices have changed */
     static QList<Phonon::DeviceAccessList> readDevices(Phonon::ObjectDescriptionType type,
                                                        Phonon::Category category);
 
 private:
-    static QList<Phonon::DeviceAccessList> readAudioDevices(Phonon::ObjectDescriptionType type,
-                                                            Phonon::Category category);
-    static QList<Phonon::DeviceAccessList> readVideoDevices(Phonon::ObjectDescriptionType type,
-                                                            Phonon::Category category);
+    /* Must be called with the mutex locked, as the phonon settings are shared */
+    static QList<Phonon::DeviceAccessList> deviceAccessLists(Phonon::ObjectDescriptionType type,
+                                                             Phonon::Category category,
+                                                             const QList<int> & devices,
+                                                             const QHash<int, QHash<QByteArray, QVariant> > & properties);
     static bool hideAdvancedDevices();
     static QList<int> sortDevicesByCategoryPriority(Phonon::ObjectDescriptionType type,
                                                     Phonon::Category category,
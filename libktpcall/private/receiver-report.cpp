@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "receiver-report.h"
+
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+bool ReceiverReport::read(const QGlib::ObjectPtr & fsSession, int clockRate, guint lastSequence,
+                          ReceiverReport *report)
+{
+    if (!fsSession || clockRate <= 0) {
+        return false;
+    }
+
+    GObject *rtpSession = NULL;
+    g_object_get(static_cast<GObject*>(fsSession), "internal-session", &rtpSession, NULL);
+    if (!rtpSession) {
+        return false;
+    }
+
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    GValueArray *sources = NULL;
+    g_object_get(rtpSession, "sources", &sources, NULL);
+    g_object_unref(rtpSession);
+    if (!sources) {
+        return false;
+    }
+
+    //what the remote side reported about our stream is in the stats of our own source
+    bool found = false;
+    for (guint i = 0; i < sources->n_values && !found; ++i) {
+        GObject *source = G_OBJECT(g_value_get_object(g_value_array_get_nth(sources, i)));
+        GstStructure *stats = NULL;
+        g_object_get(source, "stats", &stats, NULL);
+        if (!stats) {
+            continue;
+        }
+
+        gboolean internal = FALSE;
+        gboolean haveReport = FALSE;
+        guint fraction = 0;
+        guint jitter = 0;
+        guint roundTrip = 0;
+        guint sequence = 0;
+        gst_structure_get_boolean(stats, "internal", &internal);
+        gst_structure_get_boolean(stats, "have-rb", &haveReport);
+        if (internal && haveReport
+                && gst_structure_get_uint(stats, "rb-fractionlost", &fraction)
+                && gst_structure_get_uint(stats, "rb-jitter", &jitter)
+                && gst_structure_get_uint(stats, "rb-exthighestseq", &sequence)
+                && sequence != lastSequence) {
+            //the round trip is in 1/65536 s, and 0 until the remote side echoes a sender report
+            gst_structure_get_uint(stats, "rb-round-trip", &roundTrip);
+
+            report->fractionLost = fraction / 256.0;
+            report->jitterMs = int(quint64(jitter) * 1000 / clockRate);
+            report->roundTripMs = int(quint64(roundTrip) * 1000 / 65536);
+            report->sequence = sequence;
+            found = true;
+        }
+        gst_structure_free(stats);
+    }
+    g_value_array_free(sources);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+
+    return found;
+}
+
+} // KTpCallPrivate
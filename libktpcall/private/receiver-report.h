@@ -0,0 +1,45 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RECEIVER_REPORT_H
+#define RECEIVER_REPORT_H
+
+#include <QGlib/Object>
+
+namespace KTpCallPrivate {
+
+/* What the remote side last reported in RTCP about the stream that we send */
+struct ReceiverReport
+{
+    double fractionLost; //0 to 1, since the previous report
+    int jitterMs;
+    int roundTripMs;
+    guint sequence; //the extended highest sequence number, which tells reports apart
+
+    /* How often to look for a new report, in ms; the remote side sends one every
+     * few seconds, so this is more often than that */
+    static const int pollInterval = 1000;
+
+    /* Reads the report from the RTP session of the fsconference session, using the
+     * clock rate of its send codec. Returns false if there is none, or if it is the
+     * one with lastSequence, which has already been seen */
+    static bool read(const QGlib::ObjectPtr & fsSession, int clockRate, guint lastSequence,
+                     ReceiverReport *report);
+};
+
+} // KTpCallPrivate
+
+#endif // RECEIVER_REPORT_H
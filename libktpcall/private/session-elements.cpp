@@ -0,0 +1,99 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "session-elements.h"
+
+#include <gst/gst.h>
+#include <string.h>
+
+namespace KTpCallPrivate {
+
+static bool isEncoder(const QGst::ElementPtr & element, const char *media)
+{
+    GstElementFactory *factory = element ? gst_element_get_factory(element) : NULL;
+    const gchar *klass = factory ? gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS) : NULL;
+    return klass && strstr(klass, "Encoder") && strstr(klass, media);
+}
+
+QList<QGst::ElementPtr> SessionElements::children(const QGst::BinPtr & bin, bool recurse)
+{
+    QList<QGst::ElementPtr> elements;
+    if (!bin) {
+        return elements;
+    }
+
+    GstBin *gstBin = GST_BIN(static_cast<GstElement*>(bin));
+    GstIterator *it = recurse ? gst_bin_iterate_recurse(gstBin) : gst_bin_iterate_elements(gstBin);
+    GValue item = G_VALUE_INIT;
+    bool done = false;
+    while (!done) {
+        switch (gst_iterator_next(it, &item)) {
+        case GST_ITERATOR_OK:
+            elements.append(QGst::ElementPtr::wrap(GST_ELEMENT(g_value_get_object(&item))));
+            g_value_reset(&item);
+            break;
+        case GST_ITERATOR_RESYNC:
+            //the bin changed meanwhile; start over
+            gst_iterator_resync(it);
+            elements.clear();
+            break;
+        default:
+            done = true;
+            break;
+        }
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+    return elements;
+}
+
+bool SessionElements::isSendEncoder(const QGst::ElementPtr & element, const QGlib::ObjectPtr & fsSession,
+                                    const char *media)
+{
+    if (!fsSession || !isEncoder(element, media)) {
+        return false;
+    }
+    QGst::ObjectPtr parent = element->parent();
+    if (!parent) {
+        return false;
+    }
+
+    //fsconference names the bin of each send codec send_<session id>_<payload type>
+    guint sessionId = 0;
+    g_object_get(static_cast<GObject*>(fsSession), "id", &sessionId, NULL);
+    return parent->name().startsWith(QStringLiteral("send_%1_").arg(sessionId));
+}
+
+QGst::ElementPtr SessionElements::findSendEncoder(const QGlib::ObjectPtr & fsSession, const QGst::BinPtr & pipeline,
+                                                  const char *media)
+{
+    QGst::ElementPtr onlyEncoder;
+    int encoders = 0;
+    Q_FOREACH (const QGst::ElementPtr & element, children(pipeline, true)) {
+        if (isSendEncoder(element, fsSession, media)) {
+            return element;
+        }
+        if (isEncoder(element, media)) {
+            onlyEncoder = element;
+            ++encoders;
+        }
+    }
+
+    //should fsconference name its bins differently, one encoder can still only be ours
+    return encoders == 1 ? onlyEncoder : QGst::ElementPtr();
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,47 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SESSION_ELEMENTS_H
+#define SESSION_ELEMENTS_H
+
+#include <QtCore/QList>
+#include <QGlib/Object>
+#include <QGst/Bin>
+#include <QGst/Element>
+
+namespace KTpCallPrivate {
+
+/* Finds the elements that fsconference makes for a session in the pipeline */
+class SessionElements
+{
+public:
+    /* The elements in bin, and with recurse those in the bins inside it too */
+    static QList<QGst::ElementPtr> children(const QGst::BinPtr & bin, bool recurse);
+
+    /* Whether element encodes media ("Audio" or "Video") for the send codec of fsSession */
+    static bool isSendEncoder(const QGst::ElementPtr & element, const QGlib::ObjectPtr & fsSession,
+                              const char *media);
+
+    /* The encoder of media for the send codec of fsSession in pipeline, or null.
+     * fsconference makes a new one whenever the send codec changes, so it has to
+     * be looked up again rather than kept */
+    static QGst::ElementPtr findSendEncoder(const QGlib::ObjectPtr & fsSession, const QGst::BinPtr & pipeline,
+                                            const char *media);
+};
+
+} // KTpCallPrivate
+
+#endif // SESSION_ELEMENTS_H
@@ -16,6 +16,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "sink-controllers.h"
+#include "thread-scheduler.h"
 #include "libktpcall_debug.h"
 #include <QGst/ElementFactory>
 #include <QGst/Pipeline>
@@ -57,20 +58,117 @@ void BaseSinkController::releaseFromStreamingThread(const QGst::PipelinePtr & pi
 //END BaseSinkController
 //BEGIN AudioSinkController
 
-AudioSinkController::AudioSinkController(const QGst::PadPtr & adderSinkPad)
-    : m_adderRequestPad(adderSinkPad),
-      m_volumeController(NULL)
+//below this peak level, in dB, a remote stream is considered silent
+static const double s_silenceThreshold = -50.0;
+//a stream stays in the mix this long after it was last heard, so that word endings are not cut
+static const GstClockTime s_silenceHangover = 300 * GST_MSECOND;
+//how often the level of remote streams is measured; this is also the delay
+//after which a participant that starts speaking is mixed again
+static const GstClockTime s_levelInterval = 20 * GST_MSECOND;
+
+AudioSinkController::AudioSinkController(const QGst::PadPtr & outputPad)
+    : m_outputPad(outputPad),
+      m_linkProbe(0),
+      m_volumeController(NULL),
+      m_levelController(NULL),
+      m_silenceSkipping(0),
+      m_lastActiveTime(GST_CLOCK_TIME_NONE),
+      m_mixerBufferCount(0),
+      m_skippedBufferCount(0)
 {
 }
 
 AudioSinkController::~AudioSinkController()
 {
     delete m_volumeController;
+    delete m_levelController;
 }
 
-QGst::PadPtr AudioSinkController::adderRequestPad() const
+QGst::PadPtr AudioSinkController::outputPad() const
 {
-    return m_adderRequestPad;
+    return m_outputPad;
+}
+
+QGst::PadPtr AudioSinkController::srcPad() const
+{
+    return m_bin->getStaticPad("src");
+}
+
+void AudioSinkController::setOutputPad(const QGst::PadPtr & outputPad)
+{
+    m_outputPad = outputPad;
+}
+
+void AudioSinkController::setSilenceSkipping(bool enabled)
+{
+    m_silenceSkipping.store(enabled ? 1 : 0);
+}
+
+quint64 AudioSinkController::mixerBufferCount() const
+{
+    return m_mixerBufferCount.load();
+}
+
+quint64 AudioSinkController::skippedBufferCount() const
+{
+    return m_skippedBufferCount.load();
+}
+
+GstPadProbeReturn AudioSinkController::onLevelSrcBuffer(GstPad *pad, GstPadProbeInfo *info,
+                                                        gpointer data)
+{
+    Q_UNUSED(pad);
+    AudioSinkController *self = static_cast<AudioSinkController*>(data);
+
+    if (!self->m_silenceSkipping.load()) {
+        return GST_PAD_PROBE_OK;
+    }
+    self->m_mixerBufferCount.fetchAndAddRelaxed(1);
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    //the decoder already marks DTX and concealment silence as gaps
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP)) {
+        self->m_skippedBufferCount.fetchAndAddRelaxed(1);
+        return GST_PAD_PROBE_OK;
+    }
+
+    //the level element has just posted the measurement that includes this buffer
+    double peak;
+    {
+        QMutexLocker l(&self->m_levelState->mutex);
+        peak = self->m_levelState->peak;
+    }
+
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (peak > s_silenceThreshold || !GST_CLOCK_TIME_IS_VALID(pts)) {
+        self->m_lastActiveTime = pts;
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID(self->m_lastActiveTime)
+            && pts < self->m_lastActiveTime + s_silenceHangover) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    buffer = gst_buffer_make_writable(buffer);
+    GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_GAP);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    self->m_skippedBufferCount.fetchAndAddRelaxed(1);
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn AudioSinkController::onFirstBuffer(GstPad *pad, GstPadProbeInfo *info,
+                                                     gpointer data)
+{
+    Q_UNUSED(info);
+    AudioSinkController *self = static_cast<AudioSinkController*>(data);
+
+    //the sticky caps and segment events follow the link, right before this buffer
+    if (gst_pad_link(pad, self->m_outputPad) != GST_PAD_LINK_OK) {
+        qCWarning(LIBKTPCALL) << "Failed to link the remote audio stream to the output";
+    }
+    self->m_linkProbe = 0;
+    return GST_PAD_PROBE_REMOVE;
 }
 
 VolumeController *AudioSinkController::volumeController() const
@@ -78,23 +176,42 @@ VolumeController *AudioSinkController::volumeController() const
     return m_volumeController;
 }
 
+LevelController *AudioSinkController::levelController() const
+{
+    return m_levelController;
+}
+
 void AudioSinkController::initFromStreamingThread(const QGst::PadPtr & srcPad,
                                                   const QGst::PipelinePtr & pipeline)
 {
+    //conversion happens after the mix, or in the mixer for the pads that need it
     m_bin = QGst::Bin::fromDescription(
         "volume ! "
-        "audioconvert ! "
-        "audioresample ! "
-        "level"
+        "level name=level"
     );
 
+    //measure often enough to notice quickly when a silent participant starts speaking
+    QGst::ElementPtr level = m_bin->getElementByName("level");
+    level->setProperty("interval", quint64(s_levelInterval));
+    level->setProperty("post-messages", true);
+    m_levelState = LevelFilter::attach(level);
+    gst_pad_add_probe(level->getStaticPad("src"), GST_PAD_PROBE_TYPE_BUFFER,
+                      &AudioSinkController::onLevelSrcBuffer, this, NULL);
+
+    //bring the bin up before any data reaches it, so that joining does not change
+    //the state of anything that the other streams go through
     pipeline->add(m_bin);
     qCDebug(LIBKTPCALL) << "add" << m_bin->name()
                         << "to" << pipeline->name();
 
     m_bin->syncStateWithParent();
 
-    m_bin->getStaticPad("src")->link(m_adderRequestPad);
+    //a live mixer waits for data on all of its pads; linking before the stream has
+    //any would hold back the mix of everybody else until the mixer times out
+    m_linkProbe = gst_pad_add_probe(m_bin->getStaticPad("src"),
+            GstPadProbeType(GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER
+                            | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+            &AudioSinkController::onFirstBuffer, this, NULL);
     srcPad->link(m_bin->getStaticPad("sink"));
 }
 
@@ -103,22 +220,50 @@ void AudioSinkController::initFromMainThread(const Tp::ContactPtr & contact)
     m_volumeController = new VolumeController;
     m_volumeController->setElement(m_bin->getElementByInterface<QGst::StreamVolume>());
 
+    m_levelController = new LevelController;
+    m_levelController->setElement(m_bin->getElementByName("level"));
+
     BaseSinkController::initFromMainThread(contact);
 }
 
 void AudioSinkController::releaseFromStreamingThread(const QGst::PipelinePtr & pipeline)
 {
-    m_bin->getStaticPad("src")->unlink(m_adderRequestPad);
-    m_adderRequestPad.clear();
+    QGst::PadPtr src = m_bin->getStaticPad("src");
+    if (m_linkProbe) {
+        //the stream ended before it had any data
+        gst_pad_remove_probe(src, m_linkProbe);
+        m_linkProbe = 0;
+    }
+
+    //the output may have been relinked since, e.g. when the output device was switched
+    QGst::PadPtr peer = src->peer();
+    if (peer) {
+        //let a mixer know that this stream has ended, so that it does not wait for it
+        //in the middle of mixing the others; with a single input, the end of the
+        //stream would end the output
+        QGst::ElementPtr mixer = peer->parentElement();
+        if (mixer && static_cast<GstElement*>(mixer)->numsinkpads > 1) {
+            gst_pad_send_event(peer, gst_event_new_eos());
+        }
+        src->unlink(peer);
+    }
+    m_outputPad.clear();
 
+    //stop the streaming thread before the silence probe loses its level state
+    QGst::ElementPtr level = m_bin->getElementByName("level");
     BaseSinkController::releaseFromStreamingThread(pipeline);
+
+    LevelFilter::detach(level);
+    m_levelState.clear();
 }
 
 //END AudioSinkController
 //BEGIN VideoSinkController
 
 VideoSinkController::VideoSinkController()
-    : m_padNameCounter(0),
+    : m_dropProbe(0),
+      m_dropping(1),
+      m_padNameCounter(0),
       m_videoSinkBin(NULL)
 {
 }
@@ -138,6 +283,7 @@ QGst::PadPtr VideoSinkController::requestSrcPad()
     ghostSrcPad->setActive(true);
     m_bin->addPad(ghostSrcPad);
     m_pads.insert(ghostSrcPad, teeSrcPad);
+    updateDropping();
 
     return ghostSrcPad;
 }
@@ -149,9 +295,10 @@ void VideoSinkController::releaseSrcPad(const QGst::PadPtr & pad)
 
     m_bin->removePad(pad);
     m_tee->releaseRequestPad(teeSrcPad);
+    updateDropping();
 }
 
-void VideoSinkController::linkVideoSink(const QGst::ElementPtr & sink)
+void VideoSinkController::linkVideoSink(const QGst::ElementPtr & sink, bool mirror)
 {
     //initFromStreamingThread() is always called before the user knows
     //anything about this content's src pad, so nobody can possibly link
@@ -160,11 +307,12 @@ void VideoSinkController::linkVideoSink(const QGst::ElementPtr & sink)
     qCDebug(LIBKTPCALL);
 
     QGst::PadPtr srcPad = m_tee->getRequestPad("src_%u");
-    m_videoSinkBin = new VideoSinkBin(sink);
+    m_videoSinkBin = new VideoSinkBin(sink, mirror);
 
     m_bin->add(m_videoSinkBin->bin());
     m_videoSinkBin->bin()->syncStateWithParent();
     srcPad->link(m_videoSinkBin->bin()->getStaticPad("sink"));
+    updateDropping();
 }
 
 void VideoSinkController::unlinkVideoSink()
@@ -187,7 +335,40 @@ void VideoSinkController::unlinkVideoSink()
         m_videoSinkBin = NULL;
 
         m_tee->releaseRequestPad(srcPad);
+        updateDropping();
+    }
+}
+
+void VideoSinkController::updateDropping()
+{
+    bool dropping = !m_videoSinkBin && m_pads.isEmpty();
+    if (m_dropping.fetchAndStoreOrdered(dropping) && !dropping) {
+        //a fresh keyframe gives the new sink a complete picture at once, instead
+        //of one that the decoder is still patching up after packet loss
+        requestKeyFrame();
+    }
+}
+
+void VideoSinkController::requestKeyFrame()
+{
+    if (!m_sinkPad) {
+        return;
     }
+
+    //what gst_video_event_new_upstream_force_key_unit() makes; fsconference
+    //turns it into a picture loss indication for the remote side
+    GstStructure *structure = gst_structure_new("GstForceKeyUnit",
+            "all-headers", G_TYPE_BOOLEAN, TRUE, NULL);
+    gst_pad_push_event(m_sinkPad, gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM, structure));
+}
+
+GstPadProbeReturn VideoSinkController::onFrame(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    VideoSinkController *self = static_cast<VideoSinkController*>(data);
+    //nobody would see the frame; spare the tee, the conversion and the sink
+    return self->m_dropping.load() ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
 }
 
 void VideoSinkController::initFromStreamingThread(const QGst::PadPtr & srcPad,
@@ -195,6 +376,8 @@ void VideoSinkController::initFromStreamingThread(const QGst::PadPtr & srcPad,
 {
     m_bin = QGst::Bin::create();
     m_tee = QGst::ElementFactory::make("tee");
+    //the queues of the video sinks start their threads in here
+    ThreadScheduler::tag(m_bin, ThreadScheduler::VideoMedia);
 
     QGst::ElementPtr fakesink = QGst::ElementFactory::make("fakesink");
     fakesink->setProperty("sync", false);
@@ -207,6 +390,9 @@ void VideoSinkController::initFromStreamingThread(const QGst::PadPtr & srcPad,
 
     QGst::PadPtr binSinkPad = QGst::GhostPad::create(m_tee->getStaticPad("sink"), "sink");
     m_bin->addPad(binSinkPad);
+    m_sinkPad = binSinkPad;
+    m_dropProbe = gst_pad_add_probe(binSinkPad, GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                                    &VideoSinkController::onFrame, this, NULL);
 
     pipeline->add(m_bin);
     m_bin->syncStateWithParent();
@@ -216,7 +402,12 @@ void VideoSinkController::initFromStreamingThread(const QGst::PadPtr & srcPad,
 
 void VideoSinkController::releaseFromStreamingThread(const QGst::PipelinePtr & pipeline)
 {
+    if (m_dropProbe) {
+        gst_pad_remove_probe(m_sinkPad, m_dropProbe);
+        m_dropProbe = 0;
+    }
     unlinkVideoSink();
+    m_sinkPad.clear();
     BaseSinkController::releaseFromStreamingThread(pipeline);
 }
 
@@ -19,7 +19,10 @@
 #define SINK_CONTROLLERS_H
 
 #include "../volume-controller.h"
+#include "../level-controller.h"
 #include "video-sink-bin.h"
+#include "level-filter.h"
+#include <QtCore/QAtomicInteger>
 #include <TelepathyQt/Contact>
 #include <QGst/Pipeline>
 #include <QGst/Pad>
@@ -47,11 +50,28 @@ protected:
 class AudioSinkController : public BaseSinkController
 {
 public:
-    AudioSinkController(const QGst::PadPtr & adderRequestPad);
+    /* outputPad is either a mixer request pad or, when this is the only
+     * remote stream, the sink pad of the output device chain. The bin is
+     * only linked to it when the first buffer of the stream arrives */
+    AudioSinkController(const QGst::PadPtr & outputPad);
     virtual ~AudioSinkController();
 
-    QGst::PadPtr adderRequestPad() const;
+    QGst::PadPtr outputPad() const;
+    QGst::PadPtr srcPad() const;
+
+    /* Records that the bin was relinked, e.g. when the mixer was inserted.
+     * Must be called from a probe on srcPad(), so that it does not race with the first buffer */
+    void setOutputPad(const QGst::PadPtr & outputPad);
+
+    /* While enabled, buffers of a silent stream are marked as gaps, which the
+     * mixer skips. Only useful while the stream goes into a mixer */
+    void setSilenceSkipping(bool enabled);
+
+    /* Buffers that reached the mixer, and how many of them it did not have to mix */
+    quint64 mixerBufferCount() const;
+    quint64 skippedBufferCount() const;
     VolumeController *volumeController() const;
+    LevelController *levelController() const;
 
     virtual void initFromStreamingThread(const QGst::PadPtr & srcPad,
                                          const QGst::PipelinePtr & pipeline);
@@ -59,8 +79,19 @@ public:
     virtual void releaseFromStreamingThread(const QGst::PipelinePtr & pipeline);
 
 private:
-    QGst::PadPtr m_adderRequestPad;
+    static GstPadProbeReturn onLevelSrcBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onFirstBuffer(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+
+    QGst::PadPtr m_outputPad;
+    gulong m_linkProbe;
     VolumeController *m_volumeController;
+    LevelController *m_levelController;
+
+    QSharedPointer<LevelState> m_levelState;
+    QAtomicInt m_silenceSkipping;
+    GstClockTime m_lastActiveTime; //only used from the streaming thread
+    QAtomicInteger<quint64> m_mixerBufferCount;
+    QAtomicInteger<quint64> m_skippedBufferCount;
 };
 
 
@@ -73,7 +104,9 @@ public:
     QGst::PadPtr requestSrcPad();
     void releaseSrcPad(const QGst::PadPtr & pad);
 
-    void linkVideoSink(const QGst::ElementPtr & sink);
+    /* Until a video sink is linked or a src pad is requested, the decoded
+     * frames are dropped as they enter the bin. See VideoSinkBin for mirror */
+    void linkVideoSink(const QGst::ElementPtr & sink, bool mirror = true);
     void unlinkVideoSink();
 
     virtual void initFromStreamingThread(const QGst::PadPtr & srcPad,
@@ -81,9 +114,17 @@ public:
     virtual void releaseFromStreamingThread(const QGst::PipelinePtr & pipeline);
 
 private:
+    static GstPadProbeReturn onFrame(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    /* Starts or stops dropping frames, depending on whether anything shows them */
+    void updateDropping();
+    void requestKeyFrame();
+
     //<ghost src pad, tee request src pad>
     QHash<QGst::PadPtr, QGst::PadPtr> m_pads;
     QGst::ElementPtr m_tee;
+    QGst::PadPtr m_sinkPad;
+    gulong m_dropProbe;
+    QAtomicInt m_dropping;
     uint m_padNameCounter;
     VideoSinkBin *m_videoSinkBin;
     QMutex m_videoSinkMutex;
@@ -19,26 +19,77 @@
 #include "tf-audio-content-handler.h"
 #include "sink-controllers.h"
 #include "device-element-factory.h"
+#include "pending-device-element.h"
+#include "drift-compensator.h"
+#include "audio-buffer-tuner.h"
+#include "audio-resilience.h"
+#include "thread-scheduler.h"
+#include "thread-topology.h"
 #include "../volume-controller.h"
+#include "../level-controller.h"
+#include "../mute-controller.h"
 #include "libktpcall_debug.h"
 
+#include <QtCore/QThread>
+
+#include <QGlib/Connect>
 #include <QGlib/Error>
+#include <QGlib/ParamSpec>
 #include <QGst/ElementFactory>
 #include <QGst/GhostPad>
+#include <QGst/Structure>
+
+#include <farstream/fs-session.h>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
 
 namespace KTpCallPrivate {
 
 TfAudioContentHandler::TfAudioContentHandler(const QTf::ContentPtr & tfContent,
                                              TfChannelHandler *parent)
     : TfContentHandler(tfContent, parent),
-      m_sinkRefCount(0)
+      m_sinkIsFallback(false),
+      m_echoProbeLinked(false),
+      m_echoProbeInsertionProbe(0),
+      m_mixerInsertionCtrl(NULL),
+      m_mixerInsertionProbe(0),
+      m_pendingMixerBlock(0),
+      m_sinkRefCount(0),
+      m_releasedMixerBufferCount(0),
+      m_releasedSkippedBufferCount(0),
+      m_pendingSinkIsFallback(false),
+      m_sinkSwapProbe(0),
+      m_pendingSrc(NULL),
+      m_driftCompensator(NULL)
 {
     m_inputVolumeController = new VolumeController(this);
     m_outputVolumeController = new VolumeController(this);
+    m_inputLevelController = new LevelController(this);
+    m_inputMuteController = new MuteController(this);
+    connect(m_inputMuteController, SIGNAL(mutedChanged(bool)), SLOT(updateSrcCapture()));
+
+    m_inputBufferTuner = new AudioBufferTuner(AudioBufferTuner::Capture, this);
+    m_outputBufferTuner = new AudioBufferTuner(AudioBufferTuner::Playback, this);
+    m_resilienceController = new AudioResilienceController(this);
+    connect(m_inputBufferTuner, SIGNAL(latencyChanged()), SIGNAL(latencyChanged()));
+    connect(m_outputBufferTuner, SIGNAL(latencyChanged()), SIGNAL(latencyChanged()));
+
+    connect(this, SIGNAL(remoteSendingStateChanged(Tp::ContactPtr,bool)),
+            SLOT(onRemoteSendingStateChanged(Tp::ContactPtr,bool)));
+
+    connect(parent->deviceMonitor(),
+            SIGNAL(deviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDeviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)));
+    connect(parent->deviceMonitor(),
+            SIGNAL(deviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDeviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)));
 }
 
 TfAudioContentHandler::~TfAudioContentHandler()
 {
+    delete m_pendingSrc;
+    delete m_driftCompensator;
 }
 
 VolumeController *TfAudioContentHandler::inputVolumeController() const
@@ -51,53 +102,192 @@ VolumeController *TfAudioContentHandler::outputVolumeController() const
     return m_outputVolumeController;
 }
 
+LevelController *TfAudioContentHandler::inputLevelController() const
+{
+    return m_inputLevelController;
+}
+
+MuteController *TfAudioContentHandler::inputMuteController() const
+{
+    return m_inputMuteController;
+}
+
+int TfAudioContentHandler::inputLatency() const
+{
+    return m_inputBufferTuner->latency();
+}
+
+int TfAudioContentHandler::outputLatency() const
+{
+    return m_outputBufferTuner->latency();
+}
+
+LevelController *TfAudioContentHandler::remoteMemberLevelController(const Tp::ContactPtr & contact) const
+{
+    AudioSinkController *ctrl = static_cast<AudioSinkController*>(sinkController(contact));
+    return ctrl ? ctrl->levelController() : NULL;
+}
+
 BaseSinkController *TfAudioContentHandler::createSinkController(const QGst::PadPtr & srcPad)
 {
     refSink();
-    AudioSinkController *ctrl = new AudioSinkController(m_outputAdder->getRequestPad("sink_%u"));
+
+    QMutexLocker l(&m_mutex);
+    QGst::PadPtr outputPad;
+    if (!m_outputAdder && !m_pendingMixer && m_audioSinkControllers.isEmpty()) {
+        //the common 1:1 call; skip the mixer and its latency
+        outputPad = outputHead()->getStaticPad("sink");
+    } else {
+        if (!m_outputAdder && !m_pendingMixer) {
+            insertMixer();
+        }
+        QGst::ElementPtr mixer = m_outputAdder ? m_outputAdder : m_pendingMixer;
+        outputPad = mixer->getRequestPad("sink_%u");
+    }
+
+    AudioSinkController *ctrl = new AudioSinkController(outputPad);
+    ctrl->setSilenceSkipping(!m_outputAdder.isNull() || !m_pendingMixer.isNull());
     ctrl->initFromStreamingThread(srcPad, channelHandler()->pipeline());
+    m_audioSinkControllers.append(ctrl);
     return ctrl;
 }
 
 void TfAudioContentHandler::releaseSinkControllerData(BaseSinkController *ctrl)
 {
     AudioSinkController *actrl = static_cast<AudioSinkController*>(ctrl);
-    QGst::PadPtr adderRequestPad = actrl->adderRequestPad();
 
-    ctrl->releaseFromStreamingThread(channelHandler()->pipeline());
+    {
+        QMutexLocker l(&m_mutex);
+        m_audioSinkControllers.removeOne(actrl);
+        m_releasedMixerBufferCount += actrl->mixerBufferCount();
+        m_releasedSkippedBufferCount += actrl->skippedBufferCount();
 
-    m_outputAdder->releaseRequestPad(adderRequestPad);
-    adderRequestPad.clear();
+        //the first stream goes away before it became idle; the others still need the mixer
+        if (m_pendingMixer && actrl == m_mixerInsertionCtrl) {
+            gst_pad_remove_probe(actrl->srcPad(), m_mixerInsertionProbe);
+            finishMixerInsertion();
+        }
+
+        QGst::PadPtr outputPad = actrl->outputPad();
+        ctrl->releaseFromStreamingThread(channelHandler()->pipeline());
+
+        //once inserted, the mixer stays until the last stream is gone
+        if (m_outputAdder && outputPad && outputPad->parentElement() == m_outputAdder) {
+            m_outputAdder->releaseRequestPad(outputPad);
+        }
+    }
 
     unrefSink();
 }
 
 bool TfAudioContentHandler::startSending()
 {
-    QGst::ElementPtr src = DeviceElementFactory::makeAudioCaptureElement();
+    //open the microphone in a worker thread, in parallel with the camera of a video content
+    if (DeviceElementFactory::parallelAcquisitionEnabled()) {
+        m_pendingSrc = new PendingDeviceElement(PendingDeviceElement::AudioCapture, this);
+        connect(m_pendingSrc, SIGNAL(finished()), SLOT(onPendingSrcFinished()));
+        return true;
+    }
+
+    if (!startSendingFrom(DeviceElementFactory::makeAudioCaptureElement())) {
+        return false;
+    }
+    finishStartSending(true);
+    return true;
+}
+
+void TfAudioContentHandler::onPendingSrcFinished()
+{
+    QGst::ElementPtr src = m_pendingSrc->takeElement();
+    m_pendingSrc->deleteLater();
+    m_pendingSrc = NULL;
+
+    finishStartSending(startSendingFrom(src));
+}
+
+bool TfAudioContentHandler::startSendingFrom(const QGst::ElementPtr & src)
+{
     if (!src) {
         qCDebug(LIBKTPCALL) << "Could not initialize audio capture device";
         return false;
     }
 
+    m_inputBufferTuner->configure(src);
     if (!createSrcBin(src)) {
         src->setState(QGst::StateNull); // DeviceElementFactory usually leaves src in StateReady
         return false;
     }
+    m_src = src;
+    m_inputBufferTuner->watch(src);
+
+    //follow the send codec, so that we capture at the rate it encodes at
+    m_fsSession = tfContent()->property("fs-session").get<QGlib::ObjectPtr>();
+    if (m_fsSession) {
+        QGlib::connect(m_fsSession, "notify::current-send-codec",
+                       this, &TfAudioContentHandler::onSendCodecChanged);
+        //and protect what it sends against the loss that the remote side reports
+        m_resilienceController->setSession(m_fsSession, channelHandler()->pipeline());
+    }
 
     // link to fsconference
     channelHandler()->pipeline()->add(m_srcBin);
     m_srcBin->getStaticPad("src")->link(tfContent()->property("sink-pad").get<QGst::PadPtr>());
     m_srcBin->syncStateWithParent();
+    updateSrcCapture();
 
     return true;
 }
 
+void TfAudioContentHandler::updateSrcCapture()
+{
+    if (!m_src) {
+        return;
+    }
+
+    //while muted nothing after the valve needs the microphone; paused, it stops
+    //capturing (pulsesrc corks its stream) but stays open, so unmuting is immediate
+    if (m_inputMuteController->isMuted()) {
+        m_src->setStateLocked(true);
+        m_src->setState(QGst::StatePaused);
+        return;
+    }
+    if (!m_src->stateIsLocked()) {
+        return;
+    }
+    m_src->setStateLocked(false);
+    m_src->syncStateWithParent();
+
+    //the samples continue after a gap, which is neither drift nor an overrun
+    if (m_driftCompensator) {
+        m_driftCompensator->reset(m_src);
+    }
+    m_inputBufferTuner->watch(m_src);
+
+    //nothing was sent while muted, so no receiver report has been taken in since
+    m_resilienceController->restart();
+}
+
 void TfAudioContentHandler::stopSending()
 {
+    delete m_pendingSrc;
+    m_pendingSrc = NULL;
+
     m_inputVolumeController->setElement(QGst::StreamVolumePtr());
+    m_inputLevelController->setElement(QGst::ElementPtr());
+    m_inputMuteController->setElement(QGst::ElementPtr());
+    m_inputBufferTuner->watch(QGst::ElementPtr());
+
+    if (m_fsSession) {
+        QGlib::disconnect(m_fsSession, "notify::current-send-codec", this);
+        m_resilienceController->setSession(QGlib::ObjectPtr(), QGst::BinPtr());
+        m_fsSession.clear();
+    }
 
     if (m_srcBin) {
+        //a muted source does not follow the bin otherwise
+        if (m_src) {
+            m_src->setStateLocked(false);
+        }
         m_srcBin->setStateLocked(true);
         m_srcBin->setState(QGst::StateNull);
         m_srcBin->getStaticPad("src")->unlink(tfContent()->property("sink-pad").get<QGst::PadPtr>());
@@ -105,7 +295,13 @@ void TfAudioContentHandler::stopSending()
         if (channelHandler()->pipeline()) {
             channelHandler()->pipeline()->remove(m_srcBin);
         }
+        delete m_driftCompensator;
+        m_driftCompensator = NULL;
+
         m_srcBin.clear();
+        m_src.clear();
+        m_srcDevice.clear();
+        m_srcCapsFilter.clear();
     }
 }
 
@@ -123,44 +319,101 @@ void TfAudioContentHandler::onSinkDestroyed()
     m_outputVolumeController->setElement(QGst::StreamVolumePtr());
 }
 
+void TfAudioContentHandler::onRemoteSendingStateChanged(const Tp::ContactPtr & contact, bool sending)
+{
+    LevelController *level = remoteMemberLevelController(contact);
+    if (level && sending) {
+        connect(level, SIGNAL(levelChanged(double,double)),
+                SLOT(updateActiveSpeaker()), Qt::UniqueConnection);
+    } else if (!sending && contact == m_activeSpeaker) {
+        updateActiveSpeaker();
+    }
+}
+
+void TfAudioContentHandler::updateActiveSpeaker()
+{
+    //below this, a participant is considered silent
+    static const double speechThreshold = -45.0;
+    //the current speaker keeps the floor unless someone else is this much louder
+    static const double switchMargin = 6.0;
+
+    Tp::ContactPtr loudest;
+    double loudestLevel = speechThreshold;
+    double currentLevel = speechThreshold;
+
+    Q_FOREACH (const Tp::ContactPtr & contact, remoteMembers()) {
+        LevelController *level = remoteMemberLevelController(contact);
+        if (!level) {
+            continue;
+        }
+
+        if (contact == m_activeSpeaker) {
+            currentLevel = level->rms();
+        }
+        if (level->rms() > loudestLevel) {
+            loudest = contact;
+            loudestLevel = level->rms();
+        }
+    }
+
+    Tp::ContactPtr speaker = m_activeSpeaker;
+    if (!loudest) {
+        speaker.reset();
+    } else if (!m_activeSpeaker || currentLevel <= speechThreshold
+               || loudestLevel > currentLevel + switchMargin) {
+        speaker = loudest;
+    }
+
+    if (speaker != m_activeSpeaker) {
+        m_activeSpeaker = speaker;
+        Q_EMIT activeSpeakerChanged(m_activeSpeaker);
+    }
+}
+
 void TfAudioContentHandler::refSink()
 {
     QMutexLocker l(&m_mutex);
     if (m_sinkRefCount++ == 0) {
         m_sink = DeviceElementFactory::makeAudioOutputElement();
+        m_sinkIsFallback = !m_sink;
         if (!m_sink) {
-            qCWarning(LIBKTPCALL) << "Failed to create audio sink. Using fakesink. "
-                        "You will need to restart the call to get audio output.";
-            m_sink = QGst::ElementFactory::make("fakesink");
-            m_sink->setProperty("sync", false);
-            m_sink->setProperty("async", false);
-            m_sink->setProperty("silent", true);
-            m_sink->setProperty("enable-last-sample", false);
+            qCWarning(LIBKTPCALL) << "Failed to create audio sink. Using fakesink "
+                        "until an audio output device becomes available.";
+            m_sink = makeFallbackSink();
         }
+        m_outputBufferTuner->configure(m_sink);
 
         if (!m_sink.dynamicCast<QGst::StreamVolume>()) {
             m_outputVolume = QGst::ElementFactory::make("volume");
         }
 
-        m_outputAdder = QGst::ElementFactory::make("liveadder");
-        if (!m_outputAdder) {
-            qCWarning(LIBKTPCALL) << "Failed to create liveadder. Using adder. This may cause trouble...";
-            m_outputAdder = QGst::ElementFactory::make("adder");
+        m_outputConversion = makeOutputConversionBin();
+        if (!m_outputConversion) {
+            //only the streams that the device takes as they are will play
+            m_outputConversion = QGst::ElementFactory::make("identity");
         }
 
+        //the mixer is only inserted when a second remote stream shows up
         if (m_outputVolume) {
-            channelHandler()->pipeline()->add(m_outputAdder, m_outputVolume, m_sink);
-            QGst::Element::linkMany(m_outputAdder, m_outputVolume, m_sink);
+            channelHandler()->pipeline()->add(m_outputConversion, m_outputVolume, m_sink);
+            QGst::Element::linkMany(m_outputConversion, m_outputVolume, m_sink);
         } else {
-            channelHandler()->pipeline()->add(m_outputAdder, m_sink);
-            m_outputAdder->link(m_sink);
+            channelHandler()->pipeline()->add(m_outputConversion, m_sink);
+            m_outputConversion->link(m_sink);
         }
 
         m_sink->syncStateWithParent();
         if (m_outputVolume) {
             m_outputVolume->syncStateWithParent();
         }
-        m_outputAdder->syncStateWithParent();
+        m_outputConversion->syncStateWithParent();
+        m_outputBufferTuner->watch(m_sink);
+
+        //the remote audio passes the echo probe before it is converted for the device
+        if (m_echoProbe) {
+            m_echoProbe->link(m_outputConversion);
+            m_echoProbeLinked = true;
+        }
 
         QMetaObject::invokeMethod(this, "onSinkCreated");
     }
@@ -170,71 +423,740 @@ void TfAudioContentHandler::unrefSink()
 {
     QMutexLocker l(&m_mutex);
     if (--m_sinkRefCount == 0) {
-        m_outputAdder->setState(QGst::StateNull);
+        if (m_sinkSwapProbe) {
+            gst_pad_remove_probe(m_sinkSwapPad, m_sinkSwapProbe);
+            m_sinkSwapProbe = 0;
+            m_sinkSwapPad.clear();
+            m_pendingSink->setState(QGst::StateNull);
+            m_pendingSink.clear();
+            m_pendingSinkDevice.clear();
+        }
+
+        if (m_outputAdder) {
+            qCDebug(LIBKTPCALL) << "Skipped mixing" << m_releasedSkippedBufferCount << "of"
+                                << m_releasedMixerBufferCount << "remote audio buffers";
+            m_outputAdder->setState(QGst::StateNull);
+            m_outputAdder->unlink(outputHead());
+            channelHandler()->pipeline()->remove(m_outputAdder);
+            m_outputAdder.clear();
+        }
+
+        if (m_echoProbeInsertionProbe) {
+            gst_pad_remove_probe(m_echoProbeInsertionPad, m_echoProbeInsertionProbe);
+            m_echoProbeInsertionProbe = 0;
+            m_echoProbeInsertionPad.clear();
+        }
+        if (m_echoProbeLinked) {
+            m_echoProbe->unlink(m_outputConversion);
+            m_echoProbeLinked = false;
+        }
+
+        m_outputBufferTuner->watch(QGst::ElementPtr());
+        m_outputConversion->setState(QGst::StateNull);
         m_sink->setState(QGst::StateNull);
 
         if (m_outputVolume) {
             m_outputVolume->setState(QGst::StateNull);
-            QGst::Element::unlinkMany(m_outputAdder, m_outputVolume, m_sink);
+            QGst::Element::unlinkMany(m_outputConversion, m_outputVolume, m_sink);
             channelHandler()->pipeline()->remove(m_outputVolume);
             m_outputVolume.clear();
         } else {
-            m_outputAdder->unlink(m_sink);
+            m_outputConversion->unlink(m_sink);
         }
 
-        channelHandler()->pipeline()->remove(m_outputAdder);
+        channelHandler()->pipeline()->remove(m_outputConversion);
+        m_outputConversion.clear();
+
         channelHandler()->pipeline()->remove(m_sink);
-        m_outputAdder.clear();
         m_sink.clear();
+        m_sinkDevice.clear();
 
         QMetaObject::invokeMethod(this, "onSinkDestroyed");
     }
 }
 
+void TfAudioContentHandler::mixerStatistics(quint64 *mixerBuffers, quint64 *skippedBuffers)
+{
+    QMutexLocker l(&m_mutex);
+    *mixerBuffers = m_releasedMixerBufferCount;
+    *skippedBuffers = m_releasedSkippedBufferCount;
+    Q_FOREACH (AudioSinkController *ctrl, m_audioSinkControllers) {
+        *mixerBuffers += ctrl->mixerBufferCount();
+        *skippedBuffers += ctrl->skippedBufferCount();
+    }
+}
+
+QGst::ElementPtr TfAudioContentHandler::outputHead() const
+{
+    return m_echoProbeLinked ? m_echoProbe : m_outputConversion;
+}
+
+QGst::ElementPtr TfAudioContentHandler::makeMixer()
+{
+    //audiomixer converts only the pads whose format differs from its output,
+    //so remote streams that already match skip conversion entirely
+    QGst::ElementPtr mixer = QGst::ElementFactory::make("audiomixer");
+    bool latencyInMs = false;
+    if (!mixer) {
+        mixer = QGst::ElementFactory::make("liveadder");
+        latencyInMs = true;
+    }
+    if (!mixer) {
+        qCWarning(LIBKTPCALL) << "Failed to create audiomixer. Using adder. "
+                    "Streams with different formats will fail to mix...";
+        return QGst::ElementFactory::make("adder");
+    }
+
+    //how long the mixer waits for late streams before mixing without them
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    quint64 latencyMs = configGroup.readEntry("mixerlatency", 20);
+    if (mixer->findProperty("latency")) {
+        //audiomixer takes it in ns, liveadder in ms
+        if (latencyInMs) {
+            mixer->setProperty("latency", uint(latencyMs));
+        } else {
+            mixer->setProperty("latency", latencyMs * GST_MSECOND);
+        }
+    }
+    return mixer;
+}
+
+QGst::BinPtr TfAudioContentHandler::makeOutputConversionBin()
+{
+    //one conversion for all remote streams, after the mix
+    QGst::BinPtr bin;
+    try {
+        bin = QGst::Bin::fromDescription("audioconvert ! audioresample");
+    } catch (const QGlib::Error & err) {
+        qCWarning(LIBKTPCALL) << "Failed to create audio output conversion bin" << err;
+    }
+    return bin;
+}
+
+void TfAudioContentHandler::insertMixer()
+{
+    m_pendingMixer = makeMixer();
+    //hold what it mixes until its src pad is linked to the output, instead of erroring out
+    m_pendingMixerBlock = gst_pad_add_probe(m_pendingMixer->getStaticPad("src"),
+                                            GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+                                            &TfAudioContentHandler::onPendingMixerBlocked, NULL, NULL);
+    channelHandler()->pipeline()->add(m_pendingMixer);
+    m_pendingMixer->syncStateWithParent();
+
+    //relink the direct stream once it is between two buffers, so that no audio is lost.
+    //the idle probe runs right away in this thread if the pad is idle, otherwise from
+    //the first stream's thread as soon as the buffer that it pushes has reached the sink.
+    //nothing waits for that here, the new stream links to the mixer in the meantime
+    m_mixerInsertionCtrl = m_audioSinkControllers.first();
+    m_mixerInsertionThread.store(QThread::currentThread());
+    m_mixerInsertionProbe = gst_pad_add_probe(m_mixerInsertionCtrl->srcPad(), GST_PAD_PROBE_TYPE_IDLE,
+                                              &TfAudioContentHandler::onMixerInsertionPadIdle, this, NULL);
+    m_mixerInsertionThread.store(NULL);
+}
+
+GstPadProbeReturn TfAudioContentHandler::onMixerInsertionPadIdle(GstPad *pad, GstPadProbeInfo *info,
+                                                                 gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    TfAudioContentHandler *self = static_cast<TfAudioContentHandler*>(data);
+
+    //from insertMixer(), m_mutex is already held by this thread
+    if (self->m_mixerInsertionThread.load() == QThread::currentThread()) {
+        self->finishMixerInsertion();
+        return GST_PAD_PROBE_REMOVE;
+    }
+
+    //the mutex may be held by a thread that waits for this one,
+    //so try again the next time the pad is idle instead of blocking
+    if (!self->m_mutex.tryLock(100)) {
+        return GST_PAD_PROBE_OK;
+    }
+    //releaseSinkControllerData() may have finished the insertion already
+    if (self->m_pendingMixer) {
+        self->finishMixerInsertion();
+    }
+    self->m_mutex.unlock();
+    return GST_PAD_PROBE_REMOVE;
+}
+
+GstPadProbeReturn TfAudioContentHandler::onPendingMixerBlocked(GstPad *pad, GstPadProbeInfo *info,
+                                                               gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    Q_UNUSED(data);
+    return GST_PAD_PROBE_OK;
+}
+
+void TfAudioContentHandler::finishMixerInsertion()
+{
+    AudioSinkController *ctrl = m_mixerInsertionCtrl;
+    QGst::ElementPtr mixer = m_pendingMixer;
+    m_pendingMixer.clear();
+    m_mixerInsertionCtrl = NULL;
+    m_mixerInsertionProbe = 0;
+
+    QGst::PadPtr srcPad = ctrl->srcPad();
+    QGst::PadPtr outputPad = ctrl->outputPad();
+    //a stream that has not had its first buffer yet links to its output pad by itself
+    bool linked = !srcPad->peer().isNull();
+    if (linked) {
+        srcPad->unlink(outputPad);
+    }
+
+    mixer->getStaticPad("src")->link(outputPad);
+    QGst::PadPtr mixerPad = mixer->getRequestPad("sink_%u");
+    if (linked) {
+        srcPad->link(mixerPad);
+    }
+    ctrl->setOutputPad(mixerPad);
+    ctrl->setSilenceSkipping(true);
+    m_outputAdder = mixer;
+    gst_pad_remove_probe(mixer->getStaticPad("src"), m_pendingMixerBlock);
+    m_pendingMixerBlock = 0;
+
+    //the mixer adds latency that the sink has to know about
+    GstElement *mixerElement = static_cast<GstElement*>(mixer);
+    gst_element_post_message(mixerElement, gst_message_new_latency(GST_OBJECT(mixerElement)));
+    qCDebug(LIBKTPCALL) << "Inserted" << mixer->name() << "for a second remote stream";
+}
+
+void TfAudioContentHandler::cleanup()
+{
+    TfContentHandler::cleanup();
+
+    if (m_echoProbe) {
+        m_echoProbe->setState(QGst::StateNull);
+        if (channelHandler()->pipeline()) {
+            channelHandler()->pipeline()->remove(m_echoProbe);
+        }
+        m_echoProbe.clear();
+    }
+}
+
+void TfAudioContentHandler::handleErrorMessage(const QGst::ErrorMessagePtr & message)
+{
+    QGst::ObjectPtr source = message->source();
+
+    if (m_src && isElementOrChild(source, m_src)) {
+        qCWarning(LIBKTPCALL) << "Audio capture device failed:" << message->error()
+                              << "- trying to open another one";
+        QGst::ElementPtr src = DeviceElementFactory::makeAudioCaptureElement();
+        if (src) {
+            replaceSrc(src, QGlib::ObjectPtr());
+        }
+        return;
+    }
+
+    QGst::ElementPtr sink;
+    bool sinkIsFallback;
+    {
+        QMutexLocker l(&m_mutex);
+        sink = m_sink;
+        sinkIsFallback = m_sinkIsFallback;
+    }
+
+    if (sink && !sinkIsFallback && isElementOrChild(source, sink)) {
+        qCWarning(LIBKTPCALL) << "Audio output device failed:" << message->error()
+                              << "- trying to open another one";
+        replaceSink(DeviceElementFactory::makeAudioOutputElement(), QGlib::ObjectPtr());
+    }
+}
+
+void TfAudioContentHandler::onDeviceAdded(DeviceMonitor::DeviceClass deviceClass,
+                                          const QGlib::ObjectPtr & device)
+{
+    //a headset that is plugged in during the call is what the user wants to talk into
+    //right now; a webcam or another sound card brings a microphone of its own, which is not
+    if (deviceClass == DeviceMonitor::AudioSource && m_srcBin && DeviceMonitor::isHeadset(device)) {
+        QGst::ElementPtr src = DeviceMonitor::createElement(device);
+        if (src) {
+            replaceSrc(src, device);
+        }
+    } else if (deviceClass == DeviceMonitor::AudioSink) {
+        bool haveSink;
+        {
+            QMutexLocker l(&m_mutex);
+            haveSink = m_sinkRefCount > 0;
+        }
+
+        if (haveSink) {
+            QGst::ElementPtr sink = DeviceMonitor::createElement(device);
+            if (sink) {
+                replaceSink(sink, device);
+            }
+        }
+    }
+}
+
+void TfAudioContentHandler::onDeviceRemoved(DeviceMonitor::DeviceClass deviceClass,
+                                            const QGlib::ObjectPtr & device)
+{
+    if (deviceClass == DeviceMonitor::AudioSource && m_srcDevice == device) {
+        qCDebug(LIBKTPCALL) << "The audio capture device was removed";
+        QGst::ElementPtr src = DeviceElementFactory::makeAudioCaptureElement();
+        if (src) {
+            replaceSrc(src, QGlib::ObjectPtr());
+        }
+    } else if (deviceClass == DeviceMonitor::AudioSink) {
+        bool wasOurDevice;
+        {
+            QMutexLocker l(&m_mutex);
+            wasOurDevice = m_sinkRefCount > 0 && m_sinkDevice == device;
+        }
+
+        if (wasOurDevice) {
+            qCDebug(LIBKTPCALL) << "The audio output device was removed";
+            replaceSink(DeviceElementFactory::makeAudioOutputElement(), QGlib::ObjectPtr());
+        }
+    }
+}
+
+void TfAudioContentHandler::replaceSink(const QGst::ElementPtr & newSink, const QGlib::ObjectPtr & device)
+{
+    QMutexLocker l(&m_mutex);
+
+    if (m_sinkRefCount == 0) {
+        if (newSink) {
+            newSink->setState(QGst::StateNull);
+        }
+        return;
+    }
+
+    if (!newSink && m_sinkIsFallback) {
+        return;
+    }
+
+    if (m_pendingSink) {
+        m_pendingSink->setState(QGst::StateNull);
+    }
+
+    if (newSink) {
+        DeviceElementFactory::setupElement(newSink);
+        m_outputBufferTuner->configure(newSink);
+        m_pendingSink = newSink;
+        m_pendingSinkDevice = device;
+        m_pendingSinkIsFallback = false;
+    } else {
+        qCWarning(LIBKTPCALL) << "No audio output device available. Using fakesink "
+                    "until an audio output device becomes available.";
+        m_pendingSink = makeFallbackSink();
+        m_pendingSinkDevice.clear();
+        m_pendingSinkIsFallback = true;
+    }
+
+    if (m_sinkSwapProbe) {
+        //a swap is already pending; it will use the newer sink
+        return;
+    }
+
+    //whatever feeds the sink pushes from a streaming thread; wait until it is blocked before relinking
+    QGst::PadPtr upstreamPad = m_sink->getStaticPad("sink")->peer();
+    if (!upstreamPad) {
+        //no remote stream is linked yet, so nothing can be flowing
+        swapSink();
+        QMetaObject::invokeMethod(this, "onSinkCreated", Qt::QueuedConnection);
+        return;
+    }
+
+    m_sinkSwapPad = upstreamPad;
+    m_sinkSwapProbe = gst_pad_add_probe(m_sinkSwapPad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+                                        &TfAudioContentHandler::onSinkSwapPadBlocked, this, NULL);
+}
+
+GstPadProbeReturn TfAudioContentHandler::onSinkSwapPadBlocked(GstPad *pad, GstPadProbeInfo *info,
+                                                              gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    if (!static_cast<TfAudioContentHandler*>(data)->replaceSinkFromStreamingThread()) {
+        //let this buffer through to the old sink and try again on the next one,
+        //so that the probe and m_sinkSwapProbe stay in sync
+        return GST_PAD_PROBE_PASS;
+    }
+    return GST_PAD_PROBE_REMOVE;
+}
+
+bool TfAudioContentHandler::replaceSinkFromStreamingThread()
+{
+    //the mutex may be held for a while by another thread, e.g. by unrefSink() while it
+    //waits for this thread to stop, which removes the probe anyway; don't block on it
+    if (!m_mutex.tryLock(100)) {
+        return false;
+    }
+
+    if (!m_sinkSwapProbe) {
+        m_mutex.unlock();
+        return true;
+    }
+
+    m_sinkSwapPad.clear();
+    m_sinkSwapProbe = 0;
+    swapSink();
+    m_mutex.unlock();
+
+    QMetaObject::invokeMethod(this, "onSinkCreated", Qt::QueuedConnection);
+    return true;
+}
+
+void TfAudioContentHandler::swapSink()
+{
+    QGst::PipelinePtr pipeline = channelHandler()->pipeline();
+
+    //this is the mixer, the output volume or the bin of the only remote stream
+    QGst::PadPtr upstreamPad = m_sink->getStaticPad("sink")->peer();
+    if (upstreamPad) {
+        upstreamPad->unlink(m_sink->getStaticPad("sink"));
+    }
+    m_sink->setState(QGst::StateNull);
+    pipeline->remove(m_sink);
+
+    m_sink = m_pendingSink;
+    m_sinkDevice = m_pendingSinkDevice;
+    m_sinkIsFallback = m_pendingSinkIsFallback;
+    m_pendingSink.clear();
+    m_pendingSinkDevice.clear();
+
+    pipeline->add(m_sink);
+
+    //the old sink may have been doing the volume control
+    if (!m_outputVolume && !m_sink.dynamicCast<QGst::StreamVolume>()) {
+        m_outputVolume = QGst::ElementFactory::make("volume");
+        pipeline->add(m_outputVolume);
+        m_outputVolume->link(m_sink);
+        if (upstreamPad) {
+            upstreamPad->link(m_outputVolume->getStaticPad("sink"));
+        }
+        m_sink->syncStateWithParent();
+        m_outputVolume->syncStateWithParent();
+    } else {
+        if (upstreamPad) {
+            upstreamPad->link(m_sink->getStaticPad("sink"));
+        }
+        m_sink->syncStateWithParent();
+    }
+
+    m_outputBufferTuner->watch(m_sink);
+    qCDebug(LIBKTPCALL) << "Audio output switched to" << m_sink->name();
+}
+
+void TfAudioContentHandler::replaceSrc(const QGst::ElementPtr & newSrc, const QGlib::ObjectPtr & device)
+{
+    //e.g. the echo cancellation of PulseAudio, for a device from DeviceMonitor
+    DeviceElementFactory::setupElement(newSrc);
+    m_inputBufferTuner->configure(newSrc);
+
+    if (!m_srcBin || !replaceSourceElement(m_srcBin, m_src, newSrc)) {
+        newSrc->setState(QGst::StateNull);
+        return;
+    }
+
+    //the new device has a clock of its own
+    if (m_driftCompensator) {
+        m_driftCompensator->reset(newSrc);
+    }
+
+    qCDebug(LIBKTPCALL) << "Audio capture switched to" << newSrc->name();
+    m_src = newSrc;
+    m_srcDevice = device;
+    m_inputBufferTuner->watch(newSrc);
+    updateSrcCapture();
+}
+
+QGst::ElementPtr TfAudioContentHandler::makeFallbackSink()
+{
+    QGst::ElementPtr sink = QGst::ElementFactory::make("fakesink");
+    sink->setProperty("sync", false);
+    sink->setProperty("async", false);
+    sink->setProperty("silent", true);
+    sink->setProperty("enable-last-sample", false);
+    return sink;
+}
+
 bool TfAudioContentHandler::createSrcBin(const QGst::ElementPtr & src)
 {
     //some unique id for this content - use the name that the CM gives to the content object
     QString id = tfContent()->property("object-path").toString().section(QLatin1Char('/'), -1);
 
+    QString echoProbeName;
+    if (wantsEchoCanceller(src) && addEchoProbe()) {
+        echoProbeName = m_echoProbe->name();
+    }
+
+    QGst::BinPtr bin = makeSrcBin(src, id, captureCaps(), echoProbeName);
+    if (!bin) {
+        return false;
+    }
+
+    // keep the capsfilter, to follow send codec changes
+    m_srcCapsFilter = bin->getElementByName(
+            QString(QLatin1String("input_caps_%1")).arg(id).toLatin1());
+
+    // keep the volume element
+    QGst::ElementPtr volume = bin->getElementByName(
+            QString(QLatin1String("input_volume_%1")).arg(id).toLatin1());
+    m_inputVolumeController->setElement(volume.dynamicCast<QGst::StreamVolume>());
+
+    // and the level element
+    QGst::ElementPtr level = bin->getElementByName(
+            QString(QLatin1String("input_level_%1")).arg(id).toLatin1());
+    m_inputLevelController->setElement(level);
+
+    // and the valve that mutes everything after the source
+    QGst::ElementPtr valve = bin->getElementByName(
+            QString(QLatin1String("input_valve_%1")).arg(id).toLatin1());
+    m_inputMuteController->setElement(valve);
+
+    // let the resampler absorb the drift between the microphone and the pipeline clock
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    if (configGroup.readEntry("driftcompensation", true)) {
+        m_driftCompensator = new DriftCompensator(
+                bin->getElementByName(QString(QLatin1String("input_resample_%1")).arg(id).toLatin1()),
+                m_srcCapsFilter, src);
+    }
+
+    // its queue starts a thread that only carries the microphone
+    ThreadScheduler::tag(bin, ThreadScheduler::AudioMedia);
+
+    qCDebug(LIBKTPCALL) << "create bin name " << bin->name();
+    m_srcBin = bin;
+    return true;
+}
+
+bool TfAudioContentHandler::wantsEchoCanceller(const QGst::ElementPtr & src) const
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    QString mode = configGroup.readEntry("echocancellation", QStringLiteral("auto"));
+    if (mode == QLatin1String("off")) {
+        return false;
+    } else if (mode == QLatin1String("on")) {
+        return true;
+    }
+
+    //pulsesrc gets echo cancellation from the pulseaudio server; see DeviceElementFactory
+    QGst::ElementFactoryPtr factory = src->factory();
+    return !factory || factory->name() != QLatin1String("pulsesrc");
+}
+
+bool TfAudioContentHandler::addEchoProbe()
+{
+    if (m_echoProbe) {
+        return true;
+    }
+
+    //the echo canceller looks its probe up by name when it starts, so the probe
+    //has to be in the pipeline before the capture bin is, output path or not
+    QString id = tfContent()->property("object-path").toString().section(QLatin1Char('/'), -1);
+    QGst::ElementPtr probe = makeEchoProbe(QStringLiteral("echo_probe_%1").arg(id));
+    if (!probe) {
+        return false;
+    }
+    channelHandler()->pipeline()->add(probe);
+    probe->syncStateWithParent();
+
+    QMutexLocker l(&m_mutex);
+    m_echoProbe = probe;
+    if (m_sinkRefCount > 0) {
+        //remote audio may already be flowing into the output; put the probe in front of it
+        insertEchoProbe();
+    }
+    return true;
+}
+
+void TfAudioContentHandler::insertEchoProbe()
+{
+    QGst::PadPtr upstreamPad = m_outputConversion->getStaticPad("sink")->peer();
+    if (!upstreamPad) {
+        linkEchoProbe();
+        return;
+    }
+
+    m_echoProbeInsertionPad = upstreamPad;
+    m_echoProbeInsertionProbe = gst_pad_add_probe(upstreamPad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+                                                  &TfAudioContentHandler::onEchoProbePadBlocked, this, NULL);
+}
+
+GstPadProbeReturn TfAudioContentHandler::onEchoProbePadBlocked(GstPad *pad, GstPadProbeInfo *info,
+                                                               gpointer data)
+{
+    Q_UNUSED(info);
+    TfAudioContentHandler *self = static_cast<TfAudioContentHandler*>(data);
+
+    //like replaceSinkFromStreamingThread(), don't block on a mutex that may be held
+    //by a thread that waits for this one; try again on the next buffer instead
+    if (!self->m_mutex.tryLock(100)) {
+        return GST_PAD_PROBE_PASS;
+    }
+
+    if (self->m_echoProbeInsertionProbe) {
+        self->m_echoProbeInsertionProbe = 0;
+        self->m_echoProbeInsertionPad.clear();
+
+        //the mixer may have been inserted in the meantime
+        if (QGst::PadPtr::wrap(pad) == self->m_outputConversion->getStaticPad("sink")->peer()) {
+            self->linkEchoProbe();
+        } else {
+            self->insertEchoProbe();
+        }
+    }
+    self->m_mutex.unlock();
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void TfAudioContentHandler::linkEchoProbe()
+{
+    QGst::PadPtr conversionPad = m_outputConversion->getStaticPad("sink");
+    QGst::PadPtr probePad = m_echoProbe->getStaticPad("sink");
+    QGst::PadPtr upstreamPad = conversionPad->peer();
+
+    m_echoProbe->link(m_outputConversion);
+    if (upstreamPad) {
+        upstreamPad->unlink(conversionPad);
+        upstreamPad->link(probePad);
+    }
+
+    //streams that link to the output by themselves have to find the probe instead
+    Q_FOREACH (AudioSinkController *ctrl, m_audioSinkControllers) {
+        if (ctrl->outputPad() == conversionPad) {
+            ctrl->setOutputPad(probePad);
+        }
+    }
+    m_echoProbeLinked = true;
+    qCDebug(LIBKTPCALL) << "Inserted" << m_echoProbe->name() << "in front of the audio output";
+}
+
+QGst::CapsPtr TfAudioContentHandler::captureCaps() const
+{
+    FsCodec *codec = NULL;
+    QGlib::ObjectPtr session = tfContent()->property("fs-session").get<QGlib::ObjectPtr>();
+    if (session) {
+        g_object_get(static_cast<GObject*>(session), "current-send-codec", &codec, NULL);
+    }
+
+    //not negotiated yet; let the encoder pick the rate during caps negotiation
+    if (!codec) {
+        return QGst::CapsPtr();
+    }
+
+    int rate = codec->clock_rate;
+    //G.722 is advertised with an 8 kHz RTP clock for historical reasons, but samples at 16 kHz
+    if (g_ascii_strcasecmp(codec->encoding_name, "G722") == 0) {
+        rate = 16000;
+    }
+    fs_codec_destroy(codec);
+
+    if (rate <= 0) {
+        return QGst::CapsPtr();
+    }
+
+    QGst::Structure capsStruct("audio/x-raw");
+    capsStruct.setValue("rate", rate);
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+    return caps;
+}
+
+void TfAudioContentHandler::onSendCodecChanged(const QGlib::ParamSpecPtr & pspec)
+{
+    Q_UNUSED(pspec);
+    //this may be emitted from a streaming thread
+    QMetaObject::invokeMethod(this, "updateCaptureCaps", Qt::QueuedConnection);
+}
+
+void TfAudioContentHandler::updateCaptureCaps()
+{
+    if (!m_srcCapsFilter) {
+        return;
+    }
+
+    QGst::CapsPtr caps = captureCaps();
+    if (!caps) {
+        caps = QGst::Caps::createAny();
+    }
+    qCDebug(LIBKTPCALL) << "Send codec changed, capturing with caps" << caps->toString();
+    //capsfilter asks upstream to renegotiate; the device keeps running
+    m_srcCapsFilter->setProperty("caps", caps);
+}
+
+QGst::ElementPtr TfAudioContentHandler::makeEchoProbe(const QString & name)
+{
+    QGst::ElementPtr probe = QGst::ElementFactory::make("webrtcechoprobe", name.toLatin1());
+    if (!probe) {
+        qCDebug(LIBKTPCALL) << "webrtcechoprobe is not available; no echo cancellation in the pipeline";
+    }
+    return probe;
+}
+
+QGst::BinPtr TfAudioContentHandler::makeSrcBin(const QGst::ElementPtr & src, const QString & id,
+                                              const QGst::CapsPtr & caps,
+                                              const QString & echoProbeName)
+{
+    //the echo canceller works on the microphone signal before any gain is applied
+    QString echoCanceller;
+    if (!echoProbeName.isEmpty()) {
+        echoCanceller = QStringLiteral("webrtcdsp name=input_aec_%1 probe=%2 ! ")
+                .arg(id, echoProbeName);
+    }
+
+    //audioconvert and audioresample work in passthrough mode when the device
+    //already delivers what the encoder wants, so we convert at most once
     QString binDescription = QString(QLatin1String(
-        "audioconvert name=input_bin_first_element_%1 ! "
-        "audioresample ! "
+        "valve name=input_valve_%1 drop=false ! "
+        "audioconvert ! "
+        "audioresample name=input_resample_%1 ! "
+        "capsfilter name=input_caps_%1 ! "
+        "%2"
         "volume name=input_volume_%1 ! "
         "level name=input_level_%1 ! "
-        "audioconvert ! "
-        "capsfilter caps=\"audio/x-raw,rate=[8000,16000]\" ! "
         "tee name=input_tee_%1 ! "
-        "fakesink sync=false async=false silent=true enable-last-sample=true")).arg(id);
+        "fakesink sync=false async=false silent=true enable-last-sample=true")).arg(id, echoCanceller);
 
     QGst::BinPtr bin;
     try {
         bin = QGst::Bin::fromDescription(binDescription, QGst::Bin::NoGhost);
     } catch (const QGlib::Error & err) {
         qCWarning(LIBKTPCALL) << "Failed to create audio source bin" << err;
-        return false;
+        return QGst::BinPtr();
+    }
+
+    if (caps) {
+        bin->getElementByName(QStringLiteral("input_caps_%1").arg(id).toLatin1())
+            ->setProperty("caps", caps);
+    }
+
+    if (!echoProbeName.isEmpty()) {
+        //the delay between the probe and the microphone differs a lot between devices
+        QGst::ElementPtr aec = bin->getElementByName(QStringLiteral("input_aec_%1").arg(id).toLatin1());
+        if (aec->findProperty("delay-agnostic")) {
+            aec->setProperty("delay-agnostic", true);
+        }
+
+        //only cancel the echo: the input volume and level are ours to control, and
+        //webrtcdsp's gain control and noise suppression, on by default, would fight them
+        if (aec->findProperty("gain-control")) {
+            aec->setProperty("gain-control", false);
+        }
+        if (aec->findProperty("noise-suppression")) {
+            aec->setProperty("noise-suppression", false);
+        }
     }
 
     // add the source
     QGst::ElementPtr firstElement = bin->getElementByName(
-            QStringLiteral("input_bin_first_element_%1").arg(id).toLatin1());
+            QStringLiteral("input_valve_%1").arg(id).toLatin1());
     bin->add(src);
     if (!src->link(firstElement)) {
         qCWarning(LIBKTPCALL) << "Failed to link audiosrc to audio src bin";
-        return false;
+        return QGst::BinPtr();
     }
 
-    // keep the volume element
-    QGst::ElementPtr volume = bin->getElementByName(
-            QString(QLatin1String("input_volume_%1")).arg(id).toLatin1());
-    m_inputVolumeController->setElement(volume.dynamicCast<QGst::StreamVolume>());
-
-    // TODO level controller
-
-    // add queue and src pad
-    QGst::ElementPtr queue = QGst::ElementFactory::make("queue");
+    // add queue and src pad; fsconference encodes in the thread of this queue
+    QGst::ElementPtr queue = ThreadTopology::makeQueue(ThreadTopology::EncodeStage,
+                                                       ThreadScheduler::AudioMedia);
     if (!queue) {
-        qCWarning(LIBKTPCALL) << "Failed to load the 'queue' gst element";
-        return false;
+        return QGst::BinPtr();
     }
     bin->add(queue);
 
@@ -242,14 +1164,11 @@ bool TfAudioContentHandler::createSrcBin(const QGst::ElementPtr & src)
             QStringLiteral("input_tee_%1").arg(id).toLatin1());
     if (tee->getRequestPad("src_%u")->link(queue->getStaticPad("sink")) != QGst::PadLinkOk) {
         qCWarning(LIBKTPCALL) << "Failed to link tee ! queue";
-        return false;
+        return QGst::BinPtr();
     }
 
     bin->addPad(QGst::GhostPad::create(queue->getStaticPad("src"), "src"));
-
-    qCDebug(LIBKTPCALL) << "create bin name " << bin->name();
-    m_srcBin = bin;
-    return true;
+    return bin;
 }
 
 } // KTpCallPrivate
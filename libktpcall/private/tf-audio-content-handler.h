@@ -20,11 +20,23 @@
 #define TF_AUDIO_CONTENT_HANDLER_H
 
 #include "tf-content-handler.h"
+#include "device-monitor.h"
+#include <QtCore/QAtomicPointer>
+#include <gst/gst.h>
 
+class QThread;
 class VolumeController;
+class LevelController;
+class MuteController;
 
 namespace KTpCallPrivate {
 
+class PendingDeviceElement;
+class AudioSinkController;
+class DriftCompensator;
+class AudioBufferTuner;
+class AudioResilienceController;
+
 class TfAudioContentHandler : public TfContentHandler
 {
     Q_OBJECT
@@ -34,35 +46,151 @@ public:
 
     VolumeController *inputVolumeController() const;
     VolumeController *outputVolumeController() const;
+    LevelController *inputLevelController() const;
+    MuteController *inputMuteController() const;
+    LevelController *remoteMemberLevelController(const Tp::ContactPtr & contact) const;
+
+    /* The remote member that is currently speaking loudest, or a null pointer */
+    Tp::ContactPtr activeSpeaker() const { return m_activeSpeaker; }
+
+    /* The buffering of the capture and playback devices in ms, see AudioBufferTuner */
+    int inputLatency() const;
+    int outputLatency() const;
 
     // TODO audio device control
 
     virtual BaseSinkController *createSinkController(const QGst::PadPtr & srcPad);
     virtual void releaseSinkControllerData(BaseSinkController *ctrl);
 
+    /* Builds the capture bin around src. This does not depend on the TfContent,
+     * so that the benchmarks can construct the exact same bin.
+     * A null caps leaves the capture rate to be negotiated with the encoder */
+    static QGst::BinPtr makeSrcBin(const QGst::ElementPtr & src, const QString & id,
+                                   const QGst::CapsPtr & caps = QGst::CapsPtr(),
+                                   const QString & echoProbeName = QString());
+
+    /* The element that gives the echo canceller of a src bin made with
+     * echoProbeName the audio that is being played back */
+    static QGst::ElementPtr makeEchoProbe(const QString & name);
+
+    /* How many remote audio buffers went into the mixer during this content's
+     * lifetime, and how many of them were silent and did not have to be mixed */
+    void mixerStatistics(quint64 *mixerBuffers, quint64 *skippedBuffers);
+
+    /* The mixer for the remote streams, with the latency from the configuration */
+    static QGst::ElementPtr makeMixer();
+
+    /* The conversion stage that all remote streams share, after the mix, or null on failure */
+    static QGst::BinPtr makeOutputConversionBin();
+
+    virtual void handleErrorMessage(const QGst::ErrorMessagePtr & message);
+    virtual void cleanup();
+
+Q_SIGNALS:
+    void activeSpeakerChanged(const Tp::ContactPtr & contact);
+    void latencyChanged();
+
 protected:
     virtual bool startSending();
     virtual void stopSending();
 
 private Q_SLOTS:
+    void onPendingSrcFinished();
     void onSinkCreated();
     void onSinkDestroyed();
+    void onDeviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                       const QGlib::ObjectPtr & device);
+    void onDeviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                         const QGlib::ObjectPtr & device);
+    void onRemoteSendingStateChanged(const Tp::ContactPtr & contact, bool sending);
+    void updateActiveSpeaker();
+    void updateCaptureCaps();
+    void updateSrcCapture();
 
 private:
     void refSink();
     void unrefSink();
+
+    /* The element that the mixed (or the only) remote stream is linked to;
+     * this is the shared conversion stage */
+    QGst::ElementPtr outputHead() const;
+    /* Adds a mixer for the streams after the first one, and moves the stream that
+     * is linked directly to the output behind it once that stream is idle */
+    void insertMixer();
+    static GstPadProbeReturn onMixerInsertionPadIdle(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn onPendingMixerBlocked(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    /* Called with m_mutex held */
+    void finishMixerInsertion();
+    /* Builds the capture bin around src and links it to the conference */
+    bool startSendingFrom(const QGst::ElementPtr & src);
     bool createSrcBin(const QGst::ElementPtr & src);
+    bool wantsEchoCanceller(const QGst::ElementPtr & src) const;
+    /* Adds the probe of the echo canceller to the pipeline and, once it is safe,
+     * in front of the output path. False if webrtcechoprobe is not available */
+    bool addEchoProbe();
+    /* Called with m_mutex held */
+    void insertEchoProbe();
+    void linkEchoProbe();
+    static GstPadProbeReturn onEchoProbePadBlocked(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    QGst::CapsPtr captureCaps() const;
+    void onSendCodecChanged(const QGlib::ParamSpecPtr & pspec);
+
+    /* Swaps the output device once the data flow into it is blocked.
+     * A null newSink switches to a fakesink until another device appears */
+    void replaceSink(const QGst::ElementPtr & newSink, const QGlib::ObjectPtr & device);
+    /* Returns false if the swap has to be tried again on the next buffer */
+    bool replaceSinkFromStreamingThread();
+    void swapSink();
+    static GstPadProbeReturn onSinkSwapPadBlocked(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    void replaceSrc(const QGst::ElementPtr & newSrc, const QGlib::ObjectPtr & device);
+    static QGst::ElementPtr makeFallbackSink();
 
     QMutex m_mutex;
     QGst::ElementPtr m_sink;
+    QGlib::ObjectPtr m_sinkDevice; //the monitored device m_sink was made from, if any
+    bool m_sinkIsFallback;
+    //only made when the capture side has webrtcdsp; stays in the pipeline while there is no output path
+    QGst::ElementPtr m_echoProbe;
+    bool m_echoProbeLinked;
+    QGst::PadPtr m_echoProbeInsertionPad;
+    gulong m_echoProbeInsertionProbe;
+    QGst::ElementPtr m_outputConversion;
     QGst::ElementPtr m_outputVolume;
-    QGst::ElementPtr m_outputAdder;
+    QGst::ElementPtr m_outputAdder; //null while there is only one remote stream
+    //the mixer that new streams link to while the first stream is not yet moved behind it
+    QGst::ElementPtr m_pendingMixer;
+    AudioSinkController *m_mixerInsertionCtrl;
+    gulong m_mixerInsertionProbe;
+    gulong m_pendingMixerBlock; //keeps m_pendingMixer from pushing while it is unlinked
+    QAtomicPointer<QThread> m_mixerInsertionThread; //the thread that adds the idle probe
     int m_sinkRefCount;
+    QList<AudioSinkController*> m_audioSinkControllers;
+    quint64 m_releasedMixerBufferCount;
+    quint64 m_releasedSkippedBufferCount;
+
+    QGst::ElementPtr m_pendingSink;
+    QGlib::ObjectPtr m_pendingSinkDevice;
+    bool m_pendingSinkIsFallback;
+    QGst::PadPtr m_sinkSwapPad;
+    gulong m_sinkSwapProbe;
 
     QGst::BinPtr m_srcBin;
+    QGst::ElementPtr m_src;
+    QGlib::ObjectPtr m_srcDevice; //the monitored device m_src was made from, if any
+    QGst::ElementPtr m_srcCapsFilter;
+    QGlib::ObjectPtr m_fsSession;
+    PendingDeviceElement *m_pendingSrc;
+    DriftCompensator *m_driftCompensator;
+
+    AudioBufferTuner *m_inputBufferTuner;
+    AudioBufferTuner *m_outputBufferTuner;
+    AudioResilienceController *m_resilienceController;
 
     VolumeController *m_inputVolumeController;
     VolumeController *m_outputVolumeController;
+    LevelController *m_inputLevelController;
+    MuteController *m_inputMuteController;
+    Tp::ContactPtr m_activeSpeaker;
 };
 
 } // KTpCallPrivate
@@ -18,6 +18,11 @@
 
 #include "tf-channel-handler.h"
 #include "tf-content-handler.h"
+#include "device-element-factory.h"
+#include "device-monitor.h"
+#include "bus-sync-handler.h"
+#include "thread-topology.h"
+#include "phonon-integration.h"
 #include "libktpcall_debug.h"
 
 #include <QGlib/Error>
@@ -32,6 +37,8 @@ TfChannelHandler::TfChannelHandler(const Tp::CallChannelPtr & channel,
                                    QObject *parent)
     : QObject(parent),
       m_callChannel(channel),
+      m_deviceMonitor(NULL),
+      m_threadScheduler(NULL),
       m_factory(factoryCtor()),
       m_channelClosedCounter(1)
 {
@@ -43,6 +50,10 @@ TfChannelHandler::TfChannelHandler(const Tp::CallChannelPtr & channel,
 
 TfChannelHandler::~TfChannelHandler()
 {
+    if (m_pipeline) {
+        BusSyncHandler::uninstall(m_pipeline->bus());
+    }
+    delete m_threadScheduler;
     delete m_factory;
 }
 
@@ -69,6 +80,12 @@ void TfChannelHandler::init()
         return;
     }
 
+    //start reading the devices while the TfChannel is being set up,
+    //so that startSending() does not have to wait for phononserver
+    if (!qgetenv("KDE_FULL_SESSION").isEmpty()) {
+        PhononIntegration::prefetchDevices();
+    }
+
     QTf::PendingChannel *pendingChannel = new QTf::PendingChannel(m_callChannel);
     connect(pendingChannel, SIGNAL(finished(Tp::PendingOperation*)),
             this, SLOT(onPendingTfChannelFinished(Tp::PendingOperation*)));
@@ -88,12 +105,26 @@ void TfChannelHandler::onPendingTfChannelFinished(Tp::PendingOperation *op)
     m_tfChannel = qobject_cast<QTf::PendingChannel*>(op)->channel();
     m_channelClosedCounter--; // from this point on, we also need to wait for TfChannel to close
 
+    //the CPUs and the config of the process do not change during a call
+    m_threadScheduler = new ThreadScheduler(ThreadTopology::current());
+
     m_pipeline = QGst::Pipeline::create();
+    BusSyncHandler::install(m_pipeline->bus(), m_threadScheduler);
     m_pipeline->setState(QGst::StatePlaying);
 
     m_pipeline->bus()->addSignalWatch();
     QGlib::connect(m_pipeline->bus(), "message", this, &TfChannelHandler::onBusMessage);
 
+    //watch for devices that are plugged or unplugged during the call
+    m_deviceMonitor = new DeviceMonitor(this);
+    connect(m_deviceMonitor,
+            SIGNAL(deviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDevicesChanged(KTpCallPrivate::DeviceMonitor::DeviceClass)));
+    connect(m_deviceMonitor,
+            SIGNAL(deviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDevicesChanged(KTpCallPrivate::DeviceMonitor::DeviceClass)));
+    m_deviceMonitor->start();
+
     QGlib::connect(m_tfChannel, "closed",
                    this, &TfChannelHandler::onTfChannelClosed);
     QGlib::connect(m_tfChannel, "content-added",
@@ -106,6 +137,22 @@ void TfChannelHandler::onPendingTfChannelFinished(Tp::PendingOperation *op)
                    this, &TfChannelHandler::onFsConferenceRemoved);
 }
 
+void TfChannelHandler::onDevicesChanged(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass)
+{
+    //the device that worked the last time may not be the one to use anymore
+    switch (deviceClass) {
+    case DeviceMonitor::AudioSource:
+        DeviceElementFactory::forgetLastWorkingElement("audiosrc");
+        break;
+    case DeviceMonitor::AudioSink:
+        DeviceElementFactory::forgetLastWorkingElement("audiosink");
+        break;
+    case DeviceMonitor::VideoSource:
+        DeviceElementFactory::forgetLastWorkingElement("videosrc");
+        break;
+    }
+}
+
 void TfChannelHandler::onCallChannelInvalidated()
 {
     qCDebug(LIBKTPCALL) << "Tp::Channel invalidated";
@@ -122,8 +169,10 @@ void TfChannelHandler::onTfChannelClosed()
 
     Q_ASSERT(m_pipeline);
     m_pipeline->bus()->removeSignalWatch();
+    BusSyncHandler::uninstall(m_pipeline->bus());
     m_pipeline->setState(QGst::StateNull);
     m_fsElementAddedNotifiers.clear();
+    m_deviceMonitor->stop();
 
     if (++m_channelClosedCounter == 2) {
         qCDebug(LIBKTPCALL) << "emit channelClosed()";
@@ -171,6 +220,18 @@ void TfChannelHandler::onFsConferenceRemoved(const QGst::ElementPtr & conference
 
 void TfChannelHandler::onBusMessage(const QGst::MessagePtr & message)
 {
+    //give the contents a chance to recover from failing devices
+    if (message->type() == QGst::MessageError) {
+        Q_FOREACH (TfContentHandler *contentHandler, m_contents) {
+            contentHandler->handleErrorMessage(message.staticCast<QGst::ErrorMessage>());
+        }
+    } else if (message->type() == QGst::MessageQos) {
+        //and to follow what the CPU keeps up with
+        Q_FOREACH (TfContentHandler *contentHandler, m_contents) {
+            contentHandler->handleQosMessage(message.staticCast<QGst::QosMessage>());
+        }
+    }
+
     m_tfChannel->processBusMessage(message);
 }
 
@@ -20,10 +20,13 @@
 #define TF_CHANNEL_HANDLER_H
 
 #include "tf-content-handler-factory.h"
+#include "device-monitor.h"
+#include "thread-scheduler.h"
 
 #include <QList>
 #include <QHash>
 #include <QGst/Pipeline>
+#include <gst/gst.h>
 
 namespace KTpCallPrivate {
 
@@ -40,6 +43,9 @@ public:
     Tp::CallChannelPtr callChannel() const { return m_callChannel; }
     QTf::ChannelPtr tfChannel() const { return m_tfChannel; }
     QGst::PipelinePtr pipeline() const { return m_pipeline; }
+    DeviceMonitor *deviceMonitor() const { return m_deviceMonitor; }
+    /* The plan for the streaming threads of this call */
+    const ThreadTopology & threadTopology() const { return m_threadScheduler->topology(); }
 
     void shutdown();
 
@@ -52,6 +58,7 @@ private Q_SLOTS:
     void init();
     void onPendingTfChannelFinished(Tp::PendingOperation *op);
     void onCallChannelInvalidated();
+    void onDevicesChanged(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass);
 
 private:
     void onTfChannelClosed();
@@ -65,6 +72,8 @@ private:
     Tp::CallChannelPtr m_callChannel;
     QTf::ChannelPtr m_tfChannel;
     QGst::PipelinePtr m_pipeline;
+    DeviceMonitor *m_deviceMonitor;
+    ThreadScheduler *m_threadScheduler;
 
     TfContentHandlerFactory *m_factory;
 
@@ -28,7 +28,8 @@ namespace KTpCallPrivate {
 TfContentHandler::TfContentHandler(const QTf::ContentPtr & tfContent, TfChannelHandler *parent)
     : QObject(parent),
       m_tfContent(tfContent),
-      m_sending(false)
+      m_sending(false),
+      m_startingToSend(false)
 {
     qCDebug(LIBKTPCALL);
 
@@ -66,15 +67,64 @@ BaseSinkController *TfContentHandler::sinkController(const Tp::ContactPtr& conta
 void TfContentHandler::cleanup()
 {
     qCDebug(LIBKTPCALL);
-    if (m_sending) {
+    if (m_sending || m_startingToSend) {
         qCDebug(LIBKTPCALL) << "Cleanup detected we are still sending - stopping sending";
-        stopSending();
-        m_sending = false;
-        Q_EMIT localSendingStateChanged(false);
+        onStopSending();
     }
     m_sinkManager->cleanup();
 }
 
+void TfContentHandler::handleErrorMessage(const QGst::ErrorMessagePtr & message)
+{
+    Q_UNUSED(message);
+}
+
+void TfContentHandler::handleQosMessage(const QGst::QosMessagePtr & message)
+{
+    Q_UNUSED(message);
+}
+
+bool TfContentHandler::replaceSourceElement(const QGst::BinPtr & bin,
+                                            const QGst::ElementPtr & oldSrc,
+                                            const QGst::ElementPtr & newSrc)
+{
+    QGst::PadPtr oldSrcPad = oldSrc->getStaticPad("src");
+    QGst::PadPtr peer = oldSrcPad->peer();
+
+    //sources push from their own thread, so stopping them first is enough
+    //to make sure that nothing flows while they are being relinked
+    oldSrc->setState(QGst::StateNull);
+    oldSrcPad->unlink(peer);
+    bin->remove(oldSrc);
+
+    bin->add(newSrc);
+    if (newSrc->getStaticPad("src")->link(peer) != QGst::PadLinkOk) {
+        qCWarning(LIBKTPCALL) << "Failed to link the new source element" << newSrc->name();
+        bin->remove(newSrc);
+
+        //put the old source back, so that the caller's pointer to it is still valid
+        bin->add(oldSrc);
+        if (oldSrcPad->link(peer) != QGst::PadLinkOk) {
+            qCWarning(LIBKTPCALL) << "Failed to relink the old source element" << oldSrc->name();
+        }
+        oldSrc->syncStateWithParent();
+        return false;
+    }
+
+    newSrc->syncStateWithParent();
+    return true;
+}
+
+bool TfContentHandler::isElementOrChild(const QGst::ObjectPtr & object, const QGst::ElementPtr & element)
+{
+    for (QGst::ObjectPtr o = object; o; o = o->parent()) {
+        if (o == element) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void TfContentHandler::onSrcPadAdded(uint contactHandle,
                                      const QGlib::ObjectPtr & fsStream,
                                      const QGst::PadPtr & pad)
@@ -83,24 +133,49 @@ void TfContentHandler::onSrcPadAdded(uint contactHandle,
     m_sinkManager->handleNewSinkPad(contactHandle, pad);
 }
 
-bool TfContentHandler::onStartSending()
+void TfContentHandler::finishStartSending(bool success)
 {
-    qCDebug(LIBKTPCALL) << "Start sending requested";
+    if (!m_startingToSend) {
+        return;
+    }
+    m_startingToSend = false;
 
-    bool success = startSending();
     if (success) {
         qCDebug(LIBKTPCALL) << "Started sending successfully";
         m_sending = true;
         Q_EMIT localSendingStateChanged(true);
+    } else {
+        //start-sending has already returned, so the CM has to be told separately
+        qCWarning(LIBKTPCALL) << "Failed to start sending";
+        m_tfContent->sendingFailed(QStringLiteral("Could not open the capture device"));
     }
-    return success;
+}
+
+bool TfContentHandler::onStartSending()
+{
+    qCDebug(LIBKTPCALL) << "Start sending requested";
+
+    if (m_sending || m_startingToSend) {
+        return true;
+    }
+
+    m_startingToSend = true;
+    if (!startSending()) {
+        m_startingToSend = false;
+        return false;
+    }
+    return true;
 }
 
 void TfContentHandler::onStopSending()
 {
     qCDebug(LIBKTPCALL) << "Stop sending requested";
 
-    if (m_sending) {
+    if (m_startingToSend) {
+        qCDebug(LIBKTPCALL) << "Cancelling the pending start of sending";
+        stopSending();
+        m_startingToSend = false;
+    } else if (m_sending) {
         qCDebug(LIBKTPCALL) << "Stopping sending";
         stopSending();
         m_sending = false;
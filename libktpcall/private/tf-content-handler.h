@@ -51,16 +51,38 @@ public:
     /* Called from the streaming thread when the src pad associated with ctrl is unlinked */
     virtual void releaseSinkControllerData(BaseSinkController *ctrl) = 0;
 
+    /* Called when an element of the pipeline posts an error, so that
+     * the subclass can replace a device that stopped working */
+    virtual void handleErrorMessage(const QGst::ErrorMessagePtr & message);
+
+    /* Called when an element of the pipeline reports that it processes late */
+    virtual void handleQosMessage(const QGst::QosMessagePtr & message);
+
 Q_SIGNALS:
     void callContentReady(KTpCallPrivate::TfContentHandler *self);
     void localSendingStateChanged(bool sending);
     void remoteSendingStateChanged(const Tp::ContactPtr & contact, bool sending);
 
 protected:
-    /* Reimplement to handle the start-sending and stop-sending TfContent signals */
+    /* Reimplement to handle the start-sending and stop-sending TfContent signals.
+     * startSending() returns false if sending cannot start at all. Otherwise it calls
+     * finishStartSending(), right away or once the capture device is open, and until
+     * then stopSending() may be called to cancel it */
     virtual bool startSending() = 0;
     virtual void stopSending() = 0;
 
+    /* Tells the UI, or the CM on failure, how a started startSending() ended */
+    void finishStartSending(bool success);
+
+    /* Replaces the source element oldSrc inside bin with newSrc, without stopping the bin.
+     * If newSrc cannot be linked, oldSrc is put back and false is returned */
+    static bool replaceSourceElement(const QGst::BinPtr & bin,
+                                     const QGst::ElementPtr & oldSrc,
+                                     const QGst::ElementPtr & newSrc);
+
+    /* Returns true if object is element or one of its children */
+    static bool isElementOrChild(const QGst::ObjectPtr & object, const QGst::ElementPtr & element);
+
 private:
     void onSrcPadAdded(uint contactHandle,
                        const QGlib::ObjectPtr & fsStream,
@@ -86,6 +108,7 @@ private:
     QHash<uint, Tp::ContactPtr> m_handlesToContacts;
 
     bool m_sending;
+    bool m_startingToSend;
 };
 
 } // KTpCallPrivate
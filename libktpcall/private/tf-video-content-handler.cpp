@@ -18,10 +18,19 @@
 
 #include "tf-video-content-handler.h"
 #include "sink-controllers.h"
+#include "capture-caps.h"
+#include "cpu-pressure.h"
 #include "device-element-factory.h"
+#include "pending-device-element.h"
+#include "session-elements.h"
+#include "video-adaptation.h"
 #include "video-sink-bin.h"
+#include "thread-scheduler.h"
+#include "thread-topology.h"
 #include "libktpcall_debug.h"
 
+#include <QtCore/QTimer>
+
 #include <QGlib/Connect>
 #include <QGst/Clock>
 #include <QGst/ElementFactory>
@@ -29,21 +38,58 @@
 #include <QGst/FractionRange>
 #include <QGst/Fraction>
 
+#include <gst/gst.h>
+
 namespace KTpCallPrivate {
 
 TfVideoContentHandler::TfVideoContentHandler(const QTf::ContentPtr & tfContent,
                                              TfChannelHandler *parent)
     : TfContentHandler(tfContent, parent),
-      m_videoPreviewBin(NULL)
+      m_videoPreviewBin(NULL),
+      m_pendingSrc(NULL),
+      m_adaptationController(NULL),
+      m_cpuMonitor(NULL)
 {
     QGlib::connect(tfContent, "restart-source", this, &TfVideoContentHandler::onRestartSource);
+
+    m_standbyTimer = new QTimer(this);
+    m_standbyTimer->setSingleShot(true);
+    connect(m_standbyTimer, SIGNAL(timeout()), SLOT(releaseStandbySrc()));
+
+    if (VideoAdaptationController::isEnabled()) {
+        m_adaptationController = new VideoAdaptationController(this);
+
+        //on a slow CPU, the tiers that it can keep up with
+        if (CpuPressureMonitor::isEnabled()) {
+            m_cpuMonitor = new CpuPressureMonitor(this);
+            connect(m_cpuMonitor, SIGNAL(cpuBehind()), m_adaptationController, SLOT(lowerCpuLimit()));
+            connect(m_cpuMonitor, SIGNAL(cpuHeadroom()), m_adaptationController, SLOT(raiseCpuLimit()));
+        }
+    }
+
+    connect(parent->deviceMonitor(),
+            SIGNAL(deviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDeviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)));
+    connect(parent->deviceMonitor(),
+            SIGNAL(deviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)),
+            SLOT(onDeviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass,QGlib::ObjectPtr)));
 }
 
 TfVideoContentHandler::~TfVideoContentHandler()
 {
+    delete m_pendingSrc;
+    releaseStandbySrc();
 }
 
-void TfVideoContentHandler::linkVideoPreviewSink(const QGst::ElementPtr & sink)
+void TfVideoContentHandler::cleanup()
+{
+    TfContentHandler::cleanup();
+
+    //the call is over, nothing will send again
+    releaseStandbySrc();
+}
+
+void TfVideoContentHandler::linkVideoPreviewSink(const QGst::ElementPtr & sink, bool mirror)
 {
     qCDebug(LIBKTPCALL);
 
@@ -52,12 +98,18 @@ void TfVideoContentHandler::linkVideoPreviewSink(const QGst::ElementPtr & sink)
         return;
     }
 
+    //the camera is opened asynchronously, localSendingStateChanged() tells when it is there
+    if (!m_srcBin) {
+        qCWarning(LIBKTPCALL) << "not sending video yet - ignoring preview sink";
+        return;
+    }
+
     QString id = tfContent()->property("object-path").toString().section(QLatin1Char('/'), -1);
     QString teeName = QString(QLatin1String("input_tee_%1")).arg(id);
     QGst::ElementPtr tee = m_srcBin->getElementByName(teeName.toLatin1());
 
     QGst::PadPtr srcPad = tee->getRequestPad("src_%u");
-    m_videoPreviewBin = new VideoSinkBin(sink);
+    m_videoPreviewBin = new VideoSinkBin(sink, mirror);
 
     m_srcBin->add(m_videoPreviewBin->bin());
     m_videoPreviewBin->bin()->syncStateWithParent();
@@ -101,7 +153,43 @@ void TfVideoContentHandler::releaseSinkControllerData(BaseSinkController *ctrl)
 
 bool TfVideoContentHandler::startSending()
 {
-    QGst::ElementPtr src = DeviceElementFactory::makeVideoCaptureElement();
+    QGst::ElementPtr src;
+    QGlib::ObjectPtr device;
+    if (m_standbySrc) {
+        //the camera is still open from the last time
+        qCDebug(LIBKTPCALL) << "Taking the video capture device out of standby";
+        m_standbyTimer->stop();
+        src = m_standbySrc;
+        device = m_standbyDevice;
+        m_standbySrc.clear();
+        m_standbyDevice.clear();
+    } else if (DeviceElementFactory::parallelAcquisitionEnabled()) {
+        //open the camera in a worker thread, in parallel with the microphone of an audio content
+        m_pendingSrc = new PendingDeviceElement(PendingDeviceElement::VideoCapture, this);
+        connect(m_pendingSrc, SIGNAL(finished()), SLOT(onPendingSrcFinished()));
+        return true;
+    } else {
+        src = DeviceElementFactory::makeVideoCaptureElement();
+    }
+
+    if (!startSendingFrom(src, device)) {
+        return false;
+    }
+    finishStartSending(true);
+    return true;
+}
+
+void TfVideoContentHandler::onPendingSrcFinished()
+{
+    QGst::ElementPtr src = m_pendingSrc->takeElement();
+    m_pendingSrc->deleteLater();
+    m_pendingSrc = NULL;
+
+    finishStartSending(startSendingFrom(src, QGlib::ObjectPtr()));
+}
+
+bool TfVideoContentHandler::startSendingFrom(const QGst::ElementPtr & src, const QGlib::ObjectPtr & device)
+{
     if (!src) {
         qCCritical(LIBKTPCALL) << "Could not initialize video capture device";
         return false;
@@ -111,6 +199,8 @@ bool TfVideoContentHandler::startSending()
         src->setState(QGst::StateNull); // DeviceElementFactory usually leaves src in StateReady
         return false;
     }
+    m_src = src;
+    m_srcDevice = device;
 
     // link to fsconference
     channelHandler()->pipeline()->add(m_srcBin);
@@ -122,9 +212,23 @@ bool TfVideoContentHandler::startSending()
 
 void TfVideoContentHandler::stopSending()
 {
+    delete m_pendingSrc;
+    m_pendingSrc = NULL;
+
     unlinkVideoPreviewSink();
 
+    if (m_adaptationController) {
+        m_adaptationController->setSession(QGlib::ObjectPtr(), QGst::ElementPtr(), QGst::ElementPtr(),
+                                           QGst::BinPtr());
+    }
+    if (m_cpuMonitor) {
+        m_cpuMonitor->setBin(QGst::BinPtr());
+    }
+
     if (m_srcBin) {
+        //keep the camera open, so that sending again starts right away
+        parkSrc();
+
         m_srcBin->setStateLocked(true);
         m_srcBin->setState(QGst::StateNull);
         m_srcBin->getStaticPad("src")->unlink(tfContent()->property("sink-pad").get<QGst::PadPtr>());
@@ -132,6 +236,97 @@ void TfVideoContentHandler::stopSending()
             channelHandler()->pipeline()->remove(m_srcBin);
         }
         m_srcBin.clear();
+        m_src.clear();
+        m_srcDevice.clear();
+    }
+}
+
+void TfVideoContentHandler::cpuStepStatistics(int *stepsDown, int *stepsUp) const
+{
+    *stepsDown = 0;
+    *stepsUp = 0;
+    if (m_cpuMonitor) {
+        m_adaptationController->cpuStepStatistics(stepsDown, stepsUp);
+    }
+}
+
+void TfVideoContentHandler::handleErrorMessage(const QGst::ErrorMessagePtr & message)
+{
+    if (m_src && isElementOrChild(message->source(), m_src)) {
+        qCWarning(LIBKTPCALL) << "Video capture device failed:" << message->error()
+                              << "- trying to open another one";
+        QGst::ElementPtr src = DeviceElementFactory::makeVideoCaptureElement();
+        if (src) {
+            replaceSrc(src, QGlib::ObjectPtr());
+        }
+    }
+}
+
+void TfVideoContentHandler::handleQosMessage(const QGst::QosMessagePtr & message)
+{
+    //the preview sink drops frames when the display is slow, which the tiers cannot help
+    if (m_cpuMonitor && m_srcBin
+            && ((isElementOrChild(message->source(), m_srcBin)
+                 && !(m_videoPreviewBin && isElementOrChild(message->source(), m_videoPreviewBin->bin())))
+                || isOwnEncoder(message->source()))) {
+        m_cpuMonitor->handleQosMessage(message);
+    }
+}
+
+void TfVideoContentHandler::onDeviceAdded(DeviceMonitor::DeviceClass deviceClass,
+                                          const QGlib::ObjectPtr & device)
+{
+    if (deviceClass == DeviceMonitor::VideoSource && m_srcBin) {
+        QGst::ElementPtr src = DeviceMonitor::createElement(device);
+        if (src) {
+            replaceSrc(src, device);
+        }
+    }
+}
+
+void TfVideoContentHandler::onDeviceRemoved(DeviceMonitor::DeviceClass deviceClass,
+                                            const QGlib::ObjectPtr & device)
+{
+    if (deviceClass == DeviceMonitor::VideoSource && m_standbyDevice == device) {
+        releaseStandbySrc();
+    }
+    if (deviceClass == DeviceMonitor::VideoSource && m_srcDevice == device) {
+        qCDebug(LIBKTPCALL) << "The video capture device was removed";
+        QGst::ElementPtr src = DeviceElementFactory::makeVideoCaptureElement();
+        if (src) {
+            replaceSrc(src, QGlib::ObjectPtr());
+        }
+    }
+}
+
+void TfVideoContentHandler::releaseStandbySrc()
+{
+    m_standbyTimer->stop();
+    if (m_standbySrc) {
+        qCDebug(LIBKTPCALL) << "Closing the video capture device after standby";
+        m_standbySrc->setState(QGst::StateNull);
+        m_standbySrc.clear();
+        m_standbyDevice.clear();
+    }
+}
+
+void TfVideoContentHandler::replaceSrc(const QGst::ElementPtr & newSrc, const QGlib::ObjectPtr & device)
+{
+    if (!m_srcBin || !replaceSourceElement(m_srcBin, m_src, newSrc)) {
+        newSrc->setState(QGst::StateNull);
+        return;
+    }
+
+    qCDebug(LIBKTPCALL) << "Video capture switched to" << newSrc->name();
+    m_src = newSrc;
+    m_srcDevice = device;
+
+    //another camera may not capture as much as the last one
+    if (m_adaptationController) {
+        int width;
+        int height;
+        CaptureCaps::nativeSize(newSrc, &width, &height);
+        m_adaptationController->setNativeSize(width, height);
     }
 }
 
@@ -140,10 +335,75 @@ bool TfVideoContentHandler::createSrcBin(const QGst::ElementPtr & src)
     //some unique id for this content - use the name that the CM gives to the content object
     QString id = tfContent()->property("object-path").toString().section(QLatin1Char('/'), -1);
 
-    //videorate drops frames to support the 15fps restriction
-    //in the capsfilter if the camera cannot produce 15fps
-    QGst::ElementPtr videorate = QGst::ElementFactory::make("videorate");
-    videorate->setProperty("max-rate", 15);
+    //the tiers of the network stay within what the camera captures
+    if (m_adaptationController) {
+        int width;
+        int height;
+        CaptureCaps::nativeSize(src, &width, &height);
+        m_adaptationController->setNativeSize(width, height);
+        updateAdaptationLimits();
+    }
+
+    m_srcBin = makeSrcBin(src, id, contentCaps(), channelHandler()->threadTopology().splitsVideoCapture());
+    if (!m_srcBin) {
+        return false;
+    }
+
+    ThreadScheduler::tag(m_srcBin, ThreadScheduler::VideoMedia);
+
+    //from now on the receiver reports decide the resolution and framerate
+    if (m_adaptationController) {
+        QString capsfilterName = QString(QLatin1String("input_capsfilter_%1")).arg(id);
+        QString videorateName = QString(QLatin1String("input_videorate_%1")).arg(id);
+        m_adaptationController->setSession(tfContent()->property("fs-session").get<QGlib::ObjectPtr>(),
+                                           m_srcBin->getElementByName(capsfilterName.toLatin1()),
+                                           m_srcBin->getElementByName(videorateName.toLatin1()),
+                                           channelHandler()->pipeline());
+    }
+    if (m_cpuMonitor) {
+        m_cpuMonitor->setBin(m_srcBin);
+    }
+    return true;
+}
+
+void TfVideoContentHandler::parkSrc()
+{
+    int timeout = DeviceElementFactory::cameraStandbyTimeout();
+    if (!m_src || timeout == 0) {
+        return;
+    }
+
+    //out of the bin first, so that stopping the bin does not close the device
+    QGst::PadPtr srcPad = m_src->getStaticPad("src");
+    QGst::PadPtr peer = srcPad ? srcPad->peer() : QGst::PadPtr();
+    if (peer) {
+        srcPad->unlink(peer);
+    }
+    m_srcBin->remove(m_src);
+
+    //in READY the device stays open, but does not capture
+    if (m_src->setState(QGst::StateReady) == QGst::StateChangeFailure) {
+        qCDebug(LIBKTPCALL) << "The video capture device cannot stand by";
+        m_src->setState(QGst::StateNull);
+        return;
+    }
+
+    qCDebug(LIBKTPCALL) << "Keeping the video capture device open for" << timeout << "ms";
+    m_standbySrc = m_src;
+    m_standbyDevice = m_srcDevice;
+    m_standbyTimer->start(timeout);
+}
+
+QGst::BinPtr TfVideoContentHandler::makeSrcBin(const QGst::ElementPtr & src, const QString & id,
+                                               const QGst::CapsPtr & caps, bool splitCapture)
+{
+    //videorate drops frames to support the framerate restriction
+    //in the capsfilter if the camera cannot produce that framerate
+    QString videorateName = QString(QLatin1String("input_videorate_%1")).arg(id);
+    QGst::ElementPtr videorate = QGst::ElementFactory::make("videorate", videorateName.toLatin1());
+    if (videorate) {
+        videorate->setProperty("max-rate", CaptureCaps::framerate(caps, 15));
+    }
 
     //videoscale supports the 320x240 restriction in the capsfilter
     //if the camera cannot produce 320x240
@@ -153,10 +413,11 @@ bool TfVideoContentHandler::createSrcBin(const QGst::ElementPtr & src)
     //to work if the camera cannot produce yuv
     QGst::ElementPtr colorspace = QGst::ElementFactory::make("videoconvert");
 
-    //capsfilter restricts the output to 320x240 @ 15fps or whatever Content.I.VideoControl says
+    //capsfilter restricts the output to the tier of VideoAdaptationController, or
+    //to 320x240 @ 15fps or whatever Content.I.VideoControl says
     QString capsfilterName = QString(QLatin1String("input_capsfilter_%1")).arg(id);
     QGst::ElementPtr capsfilter = QGst::ElementFactory::make("capsfilter", capsfilterName.toLatin1());
-    capsfilter->setProperty("caps", contentCaps());
+    capsfilter->setProperty("caps", caps);
 
     qCDebug(LIBKTPCALL) << "Using video src caps" << capsfilter->property("caps").get<QGst::CapsPtr>();
 
@@ -171,36 +432,51 @@ bool TfVideoContentHandler::createSrcBin(const QGst::ElementPtr & src)
     fakesink->setProperty("silent", true);
     fakesink->setProperty("enable-last-sample", false);
 
-    //queue to support fsconference after the tee
-    QGst::ElementPtr queue = QGst::ElementFactory::make("queue");
+    //queue to support fsconference after the tee; the encoder runs in its thread
+    QGst::ElementPtr queue = ThreadTopology::makeQueue(ThreadTopology::EncodeStage, ThreadScheduler::VideoMedia);
 
     if (!videoscale || !colorspace || !capsfilter || !tee || !queue || !fakesink) {
         qCWarning(LIBKTPCALL) << "Failed to load basic gstreamer elements";
-        return false;
+        return QGst::BinPtr();
     }
 
     QGst::BinPtr bin = QGst::Bin::create();
     bin->add(src, videoscale, colorspace, capsfilter, tee, fakesink, queue);
 
-    // src ! (videorate) ! videoscale
+    //with CPUs to spare, the camera thread only captures and the conversion gets a thread of its own
+    QGst::ElementPtr captureEnd = src;
+    if (splitCapture) {
+        QGst::ElementPtr captureQueue = ThreadTopology::makeQueue(ThreadTopology::CaptureStage,
+                                                                  ThreadScheduler::VideoMedia);
+        if (captureQueue) {
+            bin->add(captureQueue);
+            if (!src->link(captureQueue)) {
+                qCWarning(LIBKTPCALL) << "Failed to link videosrc ! queue";
+                return QGst::BinPtr();
+            }
+            captureEnd = captureQueue;
+        }
+    }
+
+    // src ! (queue) ! (videorate) ! videoscale
     if (videorate) {
         bin->add(videorate);
-        if (!QGst::Element::linkMany(src, videorate, videoscale)) {
+        if (!QGst::Element::linkMany(captureEnd, videorate, videoscale)) {
             qCWarning(LIBKTPCALL) << "Failed to link videosrc ! videorate ! videoscale";
-            return false;
+            return QGst::BinPtr();
         }
     } else {
         qCDebug(LIBKTPCALL) << "NOT using videorate";
-        if (!src->link(videoscale)) {
+        if (!captureEnd->link(videoscale)) {
             qCWarning(LIBKTPCALL) << "Failed to link videosrc ! videoscale";
-            return false;
+            return QGst::BinPtr();
         }
     }
 
     // videoscale ! colorspace ! capsfilter
     if (!QGst::Element::linkMany(videoscale, colorspace, capsfilter)) {
         qCWarning(LIBKTPCALL) << "Failed to link videoscale ! colorspace ! capsfilter";
-        return false;
+        return QGst::BinPtr();
     }
 
     // capsfilter ! (postproc_tmpnoise) ! tee
@@ -210,40 +486,44 @@ bool TfVideoContentHandler::createSrcBin(const QGst::ElementPtr & src)
 
     if (!capsfilter->link(tee)) {
         qCWarning(LIBKTPCALL) << "Failed to link capsfilter ! tee";
-        return false;
+        return QGst::BinPtr();
     }
 
     // tee ! fakesink
     if (tee->getRequestPad("src_%u")->link(fakesink->getStaticPad("sink")) != QGst::PadLinkOk) {
         qCWarning(LIBKTPCALL) << "Failed to link tee ! fakesink";
-        return false;
+        return QGst::BinPtr();
     }
 
     // tee ! queue
     if (tee->getRequestPad("src_%u")->link(queue->getStaticPad("sink")) != QGst::PadLinkOk) {
         qCWarning(LIBKTPCALL) << "Failed to link tee ! queue";
-        return false;
+        return QGst::BinPtr();
     }
 
     // create bin's src pad
     bin->addPad(QGst::GhostPad::create(queue->getStaticPad("src"), "src"));
 
-    m_srcBin = bin;
-    return true;
+    return bin;
 }
 
 QGst::CapsPtr TfVideoContentHandler::contentCaps() const
 {
+    //whatever the remote side asks for is the most that the network may get, see updateAdaptationLimits()
+    if (m_adaptationController) {
+        return m_adaptationController->caps();
+    }
+
     // TfContent advertises the Content.I.VideoControl properties, if the interface exists,
     // otherwise it returns 0 for all of them
     int width = tfContent()->property("width").toInt();
     int height = tfContent()->property("height").toInt();
+    int framerate = tfContent()->property("framerate").toInt();
+
     if (width == 0 || height == 0) {
         width = 320;
         height = 240;
     }
-
-    int framerate = tfContent()->property("framerate").toInt();
     if (framerate == 0) {
         framerate = 15;
     }
@@ -258,15 +538,42 @@ QGst::CapsPtr TfVideoContentHandler::contentCaps() const
     return caps;
 }
 
+void TfVideoContentHandler::updateAdaptationLimits()
+{
+    m_adaptationController->setLimits(tfContent()->property("width").toInt(),
+                                      tfContent()->property("height").toInt(),
+                                      tfContent()->property("framerate").toInt());
+}
+
+bool TfVideoContentHandler::isOwnEncoder(const QGst::ObjectPtr & object) const
+{
+    return SessionElements::isSendEncoder(object.dynamicCast<QGst::Element>(),
+                                          tfContent()->property("fs-session").get<QGlib::ObjectPtr>(), "Video");
+}
+
 void TfVideoContentHandler::onRestartSource()
 {
     if (m_srcBin) {
+        if (m_adaptationController) {
+            updateAdaptationLimits();
+        }
         QGst::CapsPtr caps = contentCaps();
-        qCDebug(LIBKTPCALL) << "restarting source with new caps" << caps;
 
         QString id = tfContent()->property("object-path").toString().section(QLatin1Char('/'), -1);
         QString capsfilterName = QString(QLatin1String("input_capsfilter_%1")).arg(id);
+        QString videorateName = QString(QLatin1String("input_videorate_%1")).arg(id);
         QGst::ElementPtr capsfilter = m_srcBin->getElementByName(capsfilterName.toLatin1());
+        QGst::ElementPtr videorate = m_srcBin->getElementByName(videorateName.toLatin1());
+
+        //videoscale and videorate get almost anything from the camera to the new caps,
+        //so that it can keep streaming and only a frame is lost to the change
+        if (CaptureCaps::canProduce(capsfilter, caps)) {
+            qCDebug(LIBKTPCALL) << "renegotiating source to new caps" << caps;
+            CaptureCaps::renegotiate(capsfilter, videorate, caps);
+            return;
+        }
+
+        qCDebug(LIBKTPCALL) << "restarting source with new caps" << caps;
 
         //stop src bin
         m_srcBin->setStateLocked(true);
@@ -274,6 +581,9 @@ void TfVideoContentHandler::onRestartSource()
 
         //change caps
         capsfilter->setProperty("caps", caps);
+        if (videorate) {
+            videorate->setProperty("max-rate", CaptureCaps::framerate(caps, 15));
+        }
 
         //reset the clock
         m_srcBin->setClock(channelHandler()->pipeline()->clock());
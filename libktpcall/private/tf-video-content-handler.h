@@ -21,10 +21,16 @@
 #define TF_VIDEO_CONTENT_HANDLER_H
 
 #include "tf-content-handler.h"
+#include "device-monitor.h"
+
+class QTimer;
 
 namespace KTpCallPrivate {
 
 class VideoSinkBin;
+class PendingDeviceElement;
+class VideoAdaptationController;
+class CpuPressureMonitor;
 
 class TfVideoContentHandler : public TfContentHandler
 {
@@ -34,25 +40,64 @@ public:
     TfVideoContentHandler(const QTf::ContentPtr & tfContent, TfChannelHandler *parent);
     virtual ~TfVideoContentHandler();
 
-    void linkVideoPreviewSink(const QGst::ElementPtr & sink);
+    void linkVideoPreviewSink(const QGst::ElementPtr & sink, bool mirror = true);
     void unlinkVideoPreviewSink();
 
     // TODO camera device control
 
+    virtual void cleanup();
+
     virtual BaseSinkController *createSinkController(const QGst::PadPtr & srcPad);
     virtual void releaseSinkControllerData(BaseSinkController *ctrl);
 
+    /* Builds the capture bin around src, restricted to caps, with a thread that only
+     * captures if splitCapture. This does not depend on the TfContent, so that the
+     * benchmarks can construct the exact same bin */
+    static QGst::BinPtr makeSrcBin(const QGst::ElementPtr & src, const QString & id,
+                                   const QGst::CapsPtr & caps, bool splitCapture = false);
+
+    /* How many steps down and back up the video took during this content's lifetime
+     * because the CPU could not keep up, 0 if it does not follow the CPU */
+    void cpuStepStatistics(int *stepsDown, int *stepsUp) const;
+
+    virtual void handleErrorMessage(const QGst::ErrorMessagePtr & message);
+    virtual void handleQosMessage(const QGst::QosMessagePtr & message);
+
 protected:
     virtual bool startSending();
     virtual void stopSending();
 
+private Q_SLOTS:
+    void onPendingSrcFinished();
+    void onDeviceAdded(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                       const QGlib::ObjectPtr & device);
+    void onDeviceRemoved(KTpCallPrivate::DeviceMonitor::DeviceClass deviceClass,
+                         const QGlib::ObjectPtr & device);
+    void releaseStandbySrc();
+
 private:
+    /* Builds the capture bin around src and links it to the conference */
+    bool startSendingFrom(const QGst::ElementPtr & src, const QGlib::ObjectPtr & device);
     bool createSrcBin(const QGst::ElementPtr & src);
+    void parkSrc();
+    void replaceSrc(const QGst::ElementPtr & newSrc, const QGlib::ObjectPtr & device);
     QGst::CapsPtr contentCaps() const;
+    /* Gives m_adaptationController what Content.I.VideoControl asks for */
+    void updateAdaptationLimits();
     void onRestartSource();
+    bool isOwnEncoder(const QGst::ObjectPtr & object) const;
 
     QGst::BinPtr m_srcBin;
+    QGst::ElementPtr m_src;
+    QGlib::ObjectPtr m_srcDevice; //the monitored device m_src was made from, if any
+    //the camera of the last m_srcBin, kept open in READY for a while after sending stopped
+    QGst::ElementPtr m_standbySrc;
+    QGlib::ObjectPtr m_standbyDevice;
+    QTimer *m_standbyTimer;
     VideoSinkBin *m_videoPreviewBin;
+    PendingDeviceElement *m_pendingSrc;
+    VideoAdaptationController *m_adaptationController; //NULL if the video does not follow the network
+    CpuPressureMonitor *m_cpuMonitor; //NULL if the video does not follow the CPU
 };
 
 } // KTpCallPrivate
@@ -0,0 +1,379 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "thread-scheduler.h"
+#include "thread-topology.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include <QtDBus/QDBusVariant>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+# include <sys/syscall.h>
+#endif
+
+namespace KTpCallPrivate {
+
+static const char s_mediaKey[] = "ktpcall-thread-media";
+#ifdef Q_OS_LINUX
+//rtkit only makes threads real-time in processes that limit their real-time CPU time
+static const rlim_t s_realtimeCpuLimit = 200000; //us
+#endif
+static const int s_rtkitTimeout = 1000; //ms
+
+static QDBusMessage rtkitCall(const QString & interface, const QString & method)
+{
+    return QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.RealtimeKit1"),
+            QStringLiteral("/org/freedesktop/RealtimeKit1"), interface, method);
+}
+
+/* Makes threads real-time through rtkit, without blocking the threads that ask.
+ * The D-Bus calls are made asynchronously from the main thread, by thread id.
+ * Whether rtkit is there, and the highest priority that it gives, are asked
+ * once per process; until the answer arrives, the requests are queued. */
+class RealtimeKit : public QObject
+{
+    Q_OBJECT
+public:
+    RealtimeKit();
+
+    /* Thread safe. Returns false if rtkit is known not to be there */
+    bool makeThreadRealtime(qint64 tid, int priority);
+
+private Q_SLOTS:
+    void request(qint64 tid, int priority);
+    void onMaxPriorityReceived(QDBusPendingCallWatcher *watcher);
+    void onRequestFinished(QDBusPendingCallWatcher *watcher);
+
+private:
+    enum State {
+        Unknown,
+        Querying,
+        Available,
+        Unavailable
+    };
+
+    void send(qint64 tid, int priority);
+
+    QAtomicInt m_unavailable;
+    //only used from the main thread
+    State m_state;
+    int m_maxPriority;
+    QList<QPair<qint64, int> > m_queued;
+};
+
+Q_GLOBAL_STATIC(RealtimeKit, s_realtimeKit)
+
+RealtimeKit::RealtimeKit()
+    : m_unavailable(0),
+      m_state(Unknown),
+      m_maxPriority(0)
+{
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+bool RealtimeKit::makeThreadRealtime(qint64 tid, int priority)
+{
+    if (m_unavailable.load()) {
+        return false;
+    }
+    QMetaObject::invokeMethod(this, "request", Qt::QueuedConnection,
+                              Q_ARG(qint64, tid), Q_ARG(int, priority));
+    return true;
+}
+
+void RealtimeKit::request(qint64 tid, int priority)
+{
+    switch (m_state) {
+    case Unavailable:
+        return;
+    case Available:
+        send(tid, priority);
+        return;
+    case Unknown: {
+        m_state = Querying;
+        QDBusMessage call = rtkitCall(QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("Get"));
+        call << QStringLiteral("org.freedesktop.RealtimeKit1") << QStringLiteral("MaxRealtimePriority");
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                QDBusConnection::systemBus().asyncCall(call, s_rtkitTimeout), this);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onMaxPriorityReceived(QDBusPendingCallWatcher*)));
+    }
+        //fall through
+    case Querying:
+        m_queued.append(qMakePair(tid, priority));
+        return;
+    }
+}
+
+void RealtimeKit::onMaxPriorityReceived(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QDBusVariant> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError()) {
+        qCDebug(LIBKTPCALL) << "rtkit is not available, audio threads stay at normal priority:"
+                            << reply.error().message();
+        m_state = Unavailable;
+        m_unavailable.store(1);
+        m_queued.clear();
+        return;
+    }
+
+    m_state = Available;
+    m_maxPriority = reply.value().variant().toInt();
+    QList<QPair<qint64, int> > queued = m_queued;
+    m_queued.clear();
+    for (int i = 0; i < queued.size(); ++i) {
+        send(queued.at(i).first, queued.at(i).second);
+    }
+}
+
+void RealtimeKit::send(qint64 tid, int priority)
+{
+    QDBusMessage call = rtkitCall(QStringLiteral("org.freedesktop.RealtimeKit1"),
+                                  QStringLiteral("MakeThreadRealtime"));
+    call << quint64(tid) << quint32(qMin(priority, m_maxPriority));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            QDBusConnection::systemBus().asyncCall(call, s_rtkitTimeout), this);
+    watcher->setProperty("tid", tid);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(onRequestFinished(QDBusPendingCallWatcher*)));
+}
+
+void RealtimeKit::onRequestFinished(QDBusPendingCallWatcher *watcher)
+{
+    if (watcher->isError()) {
+        qCDebug(LIBKTPCALL) << "rtkit did not make thread" << watcher->property("tid").toLongLong()
+                            << "real-time:" << watcher->error().message();
+    } else {
+        qCDebug(LIBKTPCALL) << "rtkit made thread" << watcher->property("tid").toLongLong() << "real-time";
+    }
+    watcher->deleteLater();
+}
+
+static ThreadScheduler::Media mediaOfCaps(GstCaps *caps)
+{
+    if (!caps || gst_caps_is_any(caps) || gst_caps_is_empty(caps)) {
+        return ThreadScheduler::UnknownMedia;
+    }
+
+    ThreadScheduler::Media media = ThreadScheduler::UnknownMedia;
+    for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+        const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, i));
+        ThreadScheduler::Media structureMedia = ThreadScheduler::UnknownMedia;
+        if (g_str_has_prefix(name, "audio/")) {
+            structureMedia = ThreadScheduler::AudioMedia;
+        } else if (g_str_has_prefix(name, "video/") || g_str_has_prefix(name, "image/")) {
+            structureMedia = ThreadScheduler::VideoMedia;
+        }
+
+        if (structureMedia == ThreadScheduler::UnknownMedia
+                || (media != ThreadScheduler::UnknownMedia && structureMedia != media)) {
+            return ThreadScheduler::UnknownMedia;
+        }
+        media = structureMedia;
+    }
+    return media;
+}
+
+ThreadScheduler::ThreadScheduler(const ThreadTopology & topology)
+    : m_topology(new ThreadTopology(topology))
+{
+    //streaming threads would each read their own copy of the config
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    m_realtimeAudio = configGroup.readEntry("realtimeaudio", true);
+    m_realtimePriority = configGroup.readEntry("realtimepriority", 5);
+    m_videoNiceness = configGroup.readEntry("videoniceness", 5);
+}
+
+ThreadScheduler::~ThreadScheduler()
+{
+    delete m_topology;
+}
+
+void ThreadScheduler::tag(const QGst::ElementPtr & element, Media media)
+{
+    g_object_set_data(G_OBJECT(static_cast<GstElement*>(element)), s_mediaKey, GINT_TO_POINTER(media));
+}
+
+ThreadScheduler::Media ThreadScheduler::mediaOf(GstElement *element, GstPad *pad)
+{
+    //our own bins say what they carry
+    GstObject *object = GST_OBJECT(gst_object_ref(element));
+    while (object) {
+        int media = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(object), s_mediaKey));
+        if (media != UnknownMedia) {
+            gst_object_unref(object);
+            return Media(media);
+        }
+        GstObject *parent = gst_object_get_parent(object);
+        gst_object_unref(object);
+        object = parent;
+    }
+
+    //the caps that the thread pushes can only be audio or only video
+    if (pad) {
+        GstCaps *caps = gst_pad_get_pad_template_caps(pad);
+        Media media = mediaOfCaps(caps);
+        gst_caps_unref(caps);
+        if (media != UnknownMedia) {
+            return media;
+        }
+    }
+
+    //sources, sinks, mixers and converters are classified as "Source/Audio" etc.
+    GstElementFactory *factory = gst_element_get_factory(element);
+    const gchar *klass = factory
+            ? gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS) : NULL;
+    if (klass) {
+        bool audio = strstr(klass, "Audio");
+        bool video = strstr(klass, "Video") || strstr(klass, "Image");
+        if (audio != video) {
+            return audio ? AudioMedia : VideoMedia;
+        }
+    }
+    return UnknownMedia;
+}
+
+bool ThreadScheduler::limitRealtimeCpuTime()
+{
+#ifdef Q_OS_LINUX
+    //This limit is for the whole process, not for the audio threads only: any
+    //real-time thread of it that runs for this long without blocking gets SIGXCPU.
+    //rtkit refuses processes without it, and a real-time thread that spins must
+    //not freeze the desktop. Only the soft limit is lowered, below the hard one,
+    //so that the signal comes before the kernel kills the process.
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_RTTIME, &limit) != 0) {
+        return false;
+    }
+    rlim_t softLimit = s_realtimeCpuLimit;
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max <= softLimit) {
+        softLimit = limit.rlim_max / 2;
+    }
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > softLimit) {
+        limit.rlim_cur = softLimit;
+        return setrlimit(RLIMIT_RTTIME, &limit) == 0;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ThreadScheduler::makeRealtime(int priority)
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    int policy = SCHED_FIFO;
+#ifdef SCHED_RESET_ON_FORK
+    //children of the call process must not inherit real-time scheduling
+    policy |= SCHED_RESET_ON_FORK;
+#endif
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+bool ThreadScheduler::requestRealtime(int priority)
+{
+#ifdef Q_OS_LINUX
+    //the reply only arrives later, on the main thread
+    return s_realtimeKit()->makeThreadRealtime(syscall(SYS_gettid), priority);
+#else
+    Q_UNUSED(priority);
+    return false;
+#endif
+}
+
+bool ThreadScheduler::makeLowPriority(int niceness)
+{
+#ifdef Q_OS_LINUX
+    //on Linux, the nice value of a thread id applies to that thread only
+    return setpriority(PRIO_PROCESS, syscall(SYS_gettid), niceness) == 0;
+#else
+    Q_UNUSED(niceness);
+    return false;
+#endif
+}
+
+void ThreadScheduler::handleStreamStatus(GstMessage *message) const
+{
+    GstStreamStatusType type;
+    GstElement *owner;
+    gst_message_parse_stream_status(message, &type, &owner);
+
+    //this one is posted from the new thread itself
+    if (type != GST_STREAM_STATUS_TYPE_ENTER || !owner) {
+        return;
+    }
+
+    GstObject *source = GST_MESSAGE_SRC(message);
+    Media media = mediaOf(owner, GST_IS_PAD(source) ? GST_PAD(source) : NULL);
+    m_topology->pinCurrentThread(ThreadTopology::stageOf(owner), media);
+    if (media == UnknownMedia) {
+        return;
+    }
+
+    if (media == AudioMedia) {
+        if (!m_realtimeAudio) {
+            return;
+        }
+
+        //once per process, before its first real-time thread; this blocks any other
+        //thread that gets here in the meantime until it is done
+        static const bool limited = limitRealtimeCpuTime();
+        Q_UNUSED(limited);
+
+        if (makeRealtime(m_realtimePriority)) {
+            qCDebug(LIBKTPCALL) << "Audio thread of" << GST_ELEMENT_NAME(owner) << "is made real-time";
+        } else if (requestRealtime(m_realtimePriority)) {
+            qCDebug(LIBKTPCALL) << "Audio thread of" << GST_ELEMENT_NAME(owner)
+                                << "is requested to be made real-time";
+        } else {
+            qCDebug(LIBKTPCALL) << "Audio thread of" << GST_ELEMENT_NAME(owner)
+                                << "could not be made real-time";
+        }
+    } else {
+        if (m_videoNiceness > 0 && makeLowPriority(m_videoNiceness)) {
+            qCDebug(LIBKTPCALL) << "Video thread of" << GST_ELEMENT_NAME(owner)
+                                << "runs at nice" << m_videoNiceness;
+        }
+    }
+}
+
+} // KTpCallPrivate
+
+#include "thread-scheduler.moc"
@@ -0,0 +1,78 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef THREAD_SCHEDULER_H
+#define THREAD_SCHEDULER_H
+
+#include <QGst/Element>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+class ThreadTopology;
+
+/* Gives the streaming threads of the call pipeline a priority by the media they carry.
+ *
+ * Every streaming thread posts a stream-status message from itself when it starts.
+ * Threads that carry audio (capture, mixing, playback) are made real-time, directly
+ * if the process may do that and through rtkit otherwise, without waiting for it.
+ * Before the first one, the soft limit of real-time CPU time of the process is lowered.
+ * Threads that carry video are niced, so that under CPU contention video frames
+ * are late before audio is.
+ * Threads whose media cannot be told, e.g. the network threads, are left alone.
+ * Every thread is also pinned to the CPUs that the ThreadTopology of the call
+ * plans for it. */
+class ThreadScheduler
+{
+public:
+    enum Media {
+        UnknownMedia,
+        AudioMedia,
+        VideoMedia
+    };
+
+    /* Reads the GStreamer config group. To be made in the main thread, once per call,
+     * before the pipeline that it is for starts any thread */
+    explicit ThreadScheduler(const ThreadTopology & topology);
+    ~ThreadScheduler();
+
+    const ThreadTopology & topology() const { return *m_topology; }
+
+    /* Marks the threads that start in element or its children as carrying media,
+     * for elements that do not say so in their caps or metadata, like queues */
+    static void tag(const QGst::ElementPtr & element, Media media);
+
+    /* To be called from a bus sync handler, for every stream-status message */
+    void handleStreamStatus(GstMessage *message) const;
+
+private:
+    Q_DISABLE_COPY(ThreadScheduler)
+
+    static Media mediaOf(GstElement *element, GstPad *pad);
+    static bool limitRealtimeCpuTime();
+    static bool makeRealtime(int priority);
+    static bool requestRealtime(int priority);
+    static bool makeLowPriority(int niceness);
+
+    const ThreadTopology *m_topology;
+    bool m_realtimeAudio;
+    int m_realtimePriority;
+    int m_videoNiceness;
+};
+
+} // KTpCallPrivate
+
+#endif // THREAD_SCHEDULER_H
@@ -0,0 +1,260 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "thread-topology.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QGst/ElementFactory>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+#include <string.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+# include <sched.h>
+#endif
+
+namespace KTpCallPrivate {
+
+static const char s_stageKey[] = "ktpcall-thread-stage";
+
+/* "0,2-3" -> 0, 2, 3; "any" sets *any */
+static QList<int> parseCpuList(const QString & text, bool *any)
+{
+    QList<int> cpus;
+    *any = text.trimmed() == QLatin1String("any");
+    if (*any) {
+        return cpus;
+    }
+
+    Q_FOREACH (const QString & item, text.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        int first = item.section(QLatin1Char('-'), 0, 0).trimmed().toInt();
+        int last = item.contains(QLatin1Char('-')) ? item.section(QLatin1Char('-'), 1, 1).trimmed().toInt() : first;
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.append(cpu);
+        }
+    }
+    return cpus;
+}
+
+ThreadTopology::ThreadTopology(const QList<int> & cpus)
+    : m_allCpus(cpus)
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("Threads");
+    const int count = cpus.size();
+    m_enabled = count >= 2 && configGroup.readEntry("enabled", false);
+
+    if (count >= 2) {
+        //audio takes little CPU, but must never wait for video
+        m_audioCpus.append(cpus.first());
+    }
+    if (count >= 3) {
+        m_videoCpus = cpus.mid(1);
+    }
+
+    if (count >= 4) {
+        //the local video on one half of the other CPUs, the remote video on the other half
+        m_encodeCpus = cpus.mid(1, count / 2);
+        m_renderCpus = cpus.mid(1 + count / 2);
+        //the jitterbuffer threads decode the remote audio as well
+        m_decodeCpus = m_audioCpus + m_renderCpus;
+    } else {
+        m_encodeCpus = m_videoCpus;
+        m_renderCpus = m_videoCpus;
+    }
+    m_captureCpus = m_encodeCpus;
+
+    //with CPUs to spare, the camera does not have to wait for the conversion
+    m_splitsVideoCapture = configGroup.readEntry("splitcapture", count >= 4);
+
+    m_audioCpus = override("audiocpus", m_audioCpus);
+    m_captureCpus = override("capturecpus", m_captureCpus);
+    m_encodeCpus = override("encodecpus", m_encodeCpus);
+    m_decodeCpus = override("decodecpus", m_decodeCpus);
+    m_renderCpus = override("rendercpus", m_renderCpus);
+}
+
+QList<int> ThreadTopology::override(const char *key, const QList<int> & planned) const
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("Threads");
+    if (!configGroup.hasKey(key)) {
+        return planned;
+    }
+
+    bool any;
+    QList<int> cpus = parseCpuList(configGroup.readEntry(key, QString()), &any);
+    if (!any && cpus.isEmpty()) {
+        qCWarning(LIBKTPCALL) << "Ignoring invalid CPU list for" << key;
+        return planned;
+    }
+    return cpus;
+}
+
+ThreadTopology ThreadTopology::current()
+{
+    QList<int> cpus;
+#ifdef Q_OS_LINUX
+    //the CPUs of the process, which are those of its main thread; pooled
+    //streaming threads may still be pinned by the plan of an earlier call
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(getpid(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.isEmpty()) {
+        for (int cpu = 0; cpu < QThread::idealThreadCount(); ++cpu) {
+            cpus.append(cpu);
+        }
+    }
+    return ThreadTopology(cpus);
+}
+
+bool ThreadTopology::pinningEnabled() const
+{
+    return m_enabled;
+}
+
+void ThreadTopology::setPinningEnabled(bool enabled)
+{
+    m_enabled = enabled && m_allCpus.size() >= 2;
+}
+
+bool ThreadTopology::splitsVideoCapture() const
+{
+    return m_splitsVideoCapture;
+}
+
+QList<int> ThreadTopology::cpus(Stage stage, ThreadScheduler::Media media) const
+{
+    if (!m_enabled) {
+        return QList<int>();
+    }
+    if (media == ThreadScheduler::AudioMedia) {
+        return m_audioCpus;
+    }
+
+    switch (stage) {
+    case CaptureStage:
+        return m_captureCpus;
+    case EncodeStage:
+        return m_encodeCpus;
+    case DecodeStage:
+        return m_decodeCpus;
+    case RenderStage:
+        return m_renderCpus;
+    default:
+        return media == ThreadScheduler::VideoMedia ? m_videoCpus : QList<int>();
+    }
+}
+
+QGst::ElementPtr ThreadTopology::makeQueue(Stage stage, ThreadScheduler::Media media)
+{
+    QGst::ElementPtr queue = QGst::ElementFactory::make("queue");
+    if (!queue) {
+        qCWarning(LIBKTPCALL) << "Failed to load the 'queue' gst element";
+        return queue;
+    }
+
+    //old frames are worth nothing in a call; drop them instead of adding latency
+    //when the thread after the queue cannot keep up
+    if (media == ThreadScheduler::VideoMedia && (stage == CaptureStage || stage == RenderStage)) {
+        queue->setProperty("leaky", 2 /* downstream */);
+        queue->setProperty("max-size-buffers", 2u);
+        queue->setProperty("max-size-bytes", 0u);
+        queue->setProperty("max-size-time", quint64(0));
+    }
+
+    g_object_set_data(G_OBJECT(static_cast<GstElement*>(queue)), s_stageKey, GINT_TO_POINTER(stage));
+    if (media != ThreadScheduler::UnknownMedia) {
+        ThreadScheduler::tag(queue, media);
+    }
+    return queue;
+}
+
+ThreadTopology::Stage ThreadTopology::stageOf(GstElement *element)
+{
+    //our own queues say where they are
+    GstObject *object = GST_OBJECT(gst_object_ref(element));
+    while (object) {
+        int stage = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(object), s_stageKey));
+        if (stage != NoStage) {
+            gst_object_unref(object);
+            return Stage(stage);
+        }
+        GstObject *parent = gst_object_get_parent(object);
+        gst_object_unref(object);
+        object = parent;
+    }
+
+    GstElementFactory *factory = gst_element_get_factory(element);
+    if (!factory) {
+        return NoStage;
+    }
+
+    //depayloading and decoding happen in the thread of the jitterbuffer
+    if (g_str_equal(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "rtpjitterbuffer")) {
+        return DecodeStage;
+    }
+
+    const gchar *klass = gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS);
+    if (klass && strstr(klass, "Source")) {
+        return CaptureStage;
+    }
+    if (klass && strstr(klass, "Sink")) {
+        return RenderStage;
+    }
+    return NoStage;
+}
+
+void ThreadTopology::pinCurrentThread(Stage stage, ThreadScheduler::Media media) const
+{
+#ifdef Q_OS_LINUX
+    if (!m_enabled) {
+        return;
+    }
+
+    //threads come from a pool, so one that is not pinned now may still be pinned from its last task
+    QList<int> cpus = this->cpus(stage, media);
+    if (cpus.isEmpty()) {
+        cpus = m_allCpus;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    Q_FOREACH (int cpu, cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    //pid 0 is the calling thread
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        qCDebug(LIBKTPCALL) << "Could not pin a streaming thread to CPUs" << cpus;
+    }
+#else
+    Q_UNUSED(stage);
+    Q_UNUSED(media);
+#endif
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef THREAD_TOPOLOGY_H
+#define THREAD_TOPOLOGY_H
+
+#include "thread-scheduler.h"
+#include <QtCore/QList>
+#include <QGst/Element>
+#include <gst/gst.h>
+
+namespace KTpCallPrivate {
+
+/* Plans the streaming threads of a call for the CPUs that the process may run on.
+ *
+ * The bins mark the queues that start a thread at a stage boundary, and ask the
+ * plan whether optional ones are wanted at all. ThreadScheduler asks it which
+ * CPUs a starting thread should run on: audio gets a CPU of its own, and on
+ * larger machines video capture and encoding run on other CPUs than decoding and
+ * rendering. A plan is made once per call, from the main thread.
+ *
+ * Pinning is off unless Threads/enabled is set: it puts all the real-time audio
+ * threads on one CPU, where they queue behind each other, and it keeps the
+ * kernel from moving threads away from CPUs that other programs keep busy.
+ * Each CPU set can be overridden in the Threads config group, with lists like
+ * "2,4-5" for the audiocpus, capturecpus, encodecpus, decodecpus and rendercpus
+ * keys, or "any" for no pinning. */
+class ThreadTopology
+{
+public:
+    enum Stage {
+        NoStage,
+        CaptureStage,
+        EncodeStage,
+        DecodeStage, //fsconference decodes remote streams in its jitterbuffer threads
+        RenderStage
+    };
+
+    /* A plan for the given CPUs, which are the CPUs that the process may run on */
+    explicit ThreadTopology(const QList<int> & cpus);
+
+    /* The plan for the CPUs of the process */
+    static ThreadTopology current();
+
+    /* Whether pinCurrentThread() pins at all; Threads/enabled by default */
+    bool pinningEnabled() const;
+    void setPinningEnabled(bool enabled);
+
+    /* Whether the camera gets a thread that only captures, with the conversion
+     * to the send format in a thread of its own */
+    bool splitsVideoCapture() const;
+
+    /* The CPUs for the threads of a stage; empty for any */
+    QList<int> cpus(Stage stage, ThreadScheduler::Media media) const;
+
+    /* A queue that starts a thread for stage; its thread gets the planned CPUs */
+    static QGst::ElementPtr makeQueue(Stage stage, ThreadScheduler::Media media);
+
+    /* The stage of the thread that element starts */
+    static Stage stageOf(GstElement *element);
+
+    /* Pins the calling thread to the CPUs for stage and media, or lets it run on all of them */
+    void pinCurrentThread(Stage stage, ThreadScheduler::Media media) const;
+
+private:
+    QList<int> override(const char *key, const QList<int> & planned) const;
+
+    QList<int> m_allCpus;
+    bool m_enabled;
+    bool m_splitsVideoCapture;
+    QList<int> m_audioCpus;
+    QList<int> m_captureCpus;
+    QList<int> m_encodeCpus;
+    QList<int> m_decodeCpus;
+    QList<int> m_renderCpus;
+    QList<int> m_videoCpus;
+};
+
+} // KTpCallPrivate
+
+#endif // THREAD_TOPOLOGY_H
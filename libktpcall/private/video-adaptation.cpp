@@ -0,0 +1,395 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "video-adaptation.h"
+#include "capture-caps.h"
+#include "receiver-report.h"
+#include "session-elements.h"
+#include "libktpcall_debug.h"
+
+#include <QtCore/QTimer>
+#include <QGst/Fraction>
+#include <QGst/Structure>
+
+#include <farstream/fs-session.h>
+#include <gst/gst.h>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+namespace KTpCallPrivate {
+
+//best first, at 16:9; other aspect ratios keep the height and scale the width and bitrate
+static const VideoAdaptationPolicy::Tier s_tiers[] = {
+    { 1280, 720, 30, 1500000 },
+    { 960, 540, 30, 900000 },
+    { 854, 480, 30, 700000 },
+    { 640, 360, 30, 500000 },
+    { 640, 360, 15, 300000 },
+    { 480, 270, 15, 200000 },
+    { 320, 180, 15, 120000 },
+    { 320, 180, 10, 80000 }
+};
+static const int s_tierCount = sizeof(s_tiers) / sizeof(s_tiers[0]);
+static const double s_tierAspectRatio = 16.0 / 9;
+//what webcams capture when neither the remote side nor the camera tell
+static const double s_defaultAspectRatio = 4.0 / 3;
+
+//enough for 540p, so that a good network gets to 720p within a few reports
+static const double s_startBitrate = 1000000;
+//the estimate grows faster on a clean network than on one with a little loss
+static const double s_cleanLoss = 0.005;
+static const double s_cleanGrowth = 1.25;
+static const double s_probeLoss = 0.02;
+static const double s_probeGrowth = 1.08;
+//loss this high, or a round trip this long, means that the network queues or drops what we send
+static const double s_congestionLoss = 0.1;
+static const int s_congestionRoundTrip = 400; //ms
+static const double s_roundTripBackoff = 0.85;
+
+//a tier up needs this much room, for this many reports, and not right after a drop
+static const double s_upgradeMargin = 1.2;
+static const int s_roomyReportsBeforeUpgrade = 2;
+static const int s_holdReportsAfterDrop = 3;
+
+VideoAdaptationPolicy::VideoAdaptationPolicy()
+    : m_maxWidth(0),
+      m_maxHeight(0),
+      m_maxFramerate(0),
+      m_nativeWidth(0),
+      m_nativeHeight(0),
+      m_aspectRatio(s_defaultAspectRatio),
+      m_loss(0),
+      m_estimate(s_startBitrate),
+      m_cpuTier(0),
+      m_roomyReports(0),
+      m_holdReports(0)
+{
+    m_tier = tierFor(m_estimate);
+}
+
+void VideoAdaptationPolicy::setLimits(int maxWidth, int maxHeight, int maxFramerate)
+{
+    m_maxWidth = maxWidth;
+    m_maxHeight = maxHeight;
+    m_maxFramerate = maxFramerate;
+    updateTiers();
+}
+
+void VideoAdaptationPolicy::setNativeSize(int width, int height)
+{
+    m_nativeWidth = width;
+    m_nativeHeight = height;
+    updateTiers();
+}
+
+void VideoAdaptationPolicy::updateTiers()
+{
+    //what the remote side shows is what it asks for; the camera frames what it captures
+    if (m_maxWidth > 0 && m_maxHeight > 0) {
+        m_aspectRatio = double(m_maxWidth) / m_maxHeight;
+    } else if (m_nativeWidth > 0 && m_nativeHeight > 0) {
+        m_aspectRatio = double(m_nativeWidth) / m_nativeHeight;
+    } else {
+        m_aspectRatio = s_defaultAspectRatio;
+    }
+
+    m_tier = tierFor(m_estimate);
+    m_roomyReports = 0;
+}
+
+bool VideoAdaptationPolicy::update(double fractionLost, int roundTripMs, int allowedBitrate)
+{
+    fractionLost = qBound(0.0, fractionLost, 1.0);
+    m_loss += (fractionLost > m_loss ? 0.5 : 0.25) * (fractionLost - m_loss);
+
+    //like the loss based half of Google congestion control: some loss is just the
+    //network, more than that means that we send more than it carries
+    if (m_loss >= s_congestionLoss) {
+        m_estimate *= 1.0 - m_loss / 2;
+    } else if (roundTripMs >= s_congestionRoundTrip) {
+        m_estimate *= s_roundTripBackoff;
+    } else if (m_loss < s_cleanLoss) {
+        m_estimate *= s_cleanGrowth;
+    } else if (m_loss < s_probeLoss) {
+        m_estimate *= s_probeGrowth;
+    }
+    //what we send does not show whether there is room for more than the next tier up
+    m_estimate = qBound(double(tierAt(s_tierCount - 1).bitrate) / 2, m_estimate,
+                        tierAt(qMax(m_tier - 1, 0)).bitrate * s_upgradeMargin);
+    if (allowedBitrate > 0) {
+        m_estimate = qMin(m_estimate, double(allowedBitrate));
+    }
+
+    int tier = tierFor(m_estimate);
+    if (tier > m_tier) {
+        //down at once, to whatever fits
+        m_holdReports = s_holdReportsAfterDrop;
+        m_roomyReports = 0;
+    } else {
+        bool roomy = tier < m_tier && m_estimate >= tierAt(m_tier - 1).bitrate * s_upgradeMargin;
+        m_roomyReports = roomy ? m_roomyReports + 1 : 0;
+        tier = m_tier;
+        if (m_holdReports > 0) {
+            --m_holdReports;
+        } else if (m_roomyReports >= s_roomyReportsBeforeUpgrade) {
+            //up one tier at a time
+            tier = m_tier - 1;
+            m_roomyReports = 0;
+        }
+    }
+
+    int before = qMax(m_tier, m_cpuTier);
+    m_tier = tier;
+    return qMax(m_tier, m_cpuTier) != before;
+}
+
+bool VideoAdaptationPolicy::lowerCpuLimit()
+{
+    int tier = qMax(m_tier, m_cpuTier);
+    if (tier == s_tierCount - 1) {
+        return false;
+    }
+    m_cpuTier = tier + 1;
+    return true;
+}
+
+bool VideoAdaptationPolicy::raiseCpuLimit()
+{
+    if (m_cpuTier == 0) {
+        return false;
+    }
+    int before = qMax(m_tier, m_cpuTier);
+    --m_cpuTier;
+    //the network may have gone below the limit meanwhile
+    return qMax(m_tier, m_cpuTier) != before;
+}
+
+VideoAdaptationPolicy::Tier VideoAdaptationPolicy::tier() const
+{
+    return tierAt(qMax(m_tier, m_cpuTier));
+}
+
+VideoAdaptationPolicy::Tier VideoAdaptationPolicy::tierAt(int index) const
+{
+    Tier tier = s_tiers[index];
+    if (qAbs(m_aspectRatio - s_tierAspectRatio) > 0.01) {
+        //even, for the chroma planes of I420
+        tier.width = qMax(2, qRound(tier.height * m_aspectRatio / 2) * 2);
+        tier.bitrate = int(tier.bitrate * m_aspectRatio / s_tierAspectRatio);
+    }
+    return tier;
+}
+
+int VideoAdaptationPolicy::topTier() const
+{
+    for (int i = 0; i < s_tierCount; ++i) {
+        const Tier tier = tierAt(i);
+        if ((!m_maxWidth || tier.width <= m_maxWidth) && (!m_maxHeight || tier.height <= m_maxHeight)
+                && (!m_maxFramerate || tier.framerate <= m_maxFramerate)
+                && (!m_nativeWidth || tier.width <= m_nativeWidth)
+                && (!m_nativeHeight || tier.height <= m_nativeHeight)) {
+            return i;
+        }
+    }
+    return s_tierCount - 1;
+}
+
+int VideoAdaptationPolicy::tierFor(double bitrate) const
+{
+    int tier = topTier();
+    while (tier < s_tierCount - 1 && tierAt(tier).bitrate > bitrate) {
+        ++tier;
+    }
+    return tier;
+}
+
+VideoAdaptationController::VideoAdaptationController(QObject *parent)
+    : QObject(parent),
+      m_lastReportSeq(0),
+      m_cpuStepsDown(0),
+      m_cpuStepsUp(0)
+{
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), SLOT(poll()));
+}
+
+VideoAdaptationController::~VideoAdaptationController()
+{
+}
+
+bool VideoAdaptationController::isEnabled()
+{
+    const KConfigGroup configGroup = KSharedConfig::openConfig()->group("GStreamer");
+    return configGroup.readEntry("videoadaptation", true);
+}
+
+void VideoAdaptationController::setLimits(int maxWidth, int maxHeight, int maxFramerate)
+{
+    m_policy.setLimits(maxWidth, maxHeight, maxFramerate);
+}
+
+void VideoAdaptationController::setNativeSize(int width, int height)
+{
+    VideoAdaptationPolicy::Tier before = m_policy.tier();
+    m_policy.setNativeSize(width, height);
+    VideoAdaptationPolicy::Tier after = m_policy.tier();
+    if (before.width != after.width || before.height != after.height || before.framerate != after.framerate) {
+        apply();
+    }
+}
+
+void VideoAdaptationController::cpuStepStatistics(int *stepsDown, int *stepsUp) const
+{
+    *stepsDown = m_cpuStepsDown;
+    *stepsUp = m_cpuStepsUp;
+}
+
+QGst::CapsPtr VideoAdaptationController::caps() const
+{
+    const VideoAdaptationPolicy::Tier tier = m_policy.tier();
+
+    QGst::Structure capsStruct("video/x-raw");
+    capsStruct.setValue("width", tier.width);
+    capsStruct.setValue("height", tier.height);
+    capsStruct.setValue("framerate", QGst::Fraction(tier.framerate, 1));
+
+    QGst::CapsPtr caps = QGst::Caps::createEmpty();
+    caps->appendStructure(capsStruct);
+    return caps;
+}
+
+void VideoAdaptationController::setSession(const QGlib::ObjectPtr & session,
+                                           const QGst::ElementPtr & capsfilter,
+                                           const QGst::ElementPtr & videorate,
+                                           const QGst::BinPtr & pipeline)
+{
+    m_session = session;
+    m_capsfilter = session ? capsfilter : QGst::ElementPtr();
+    m_videorate = session ? videorate : QGst::ElementPtr();
+    m_pipeline = session ? pipeline : QGst::BinPtr();
+    m_encoder.clear();
+    m_lastReportSeq = 0;
+
+    if (m_session && m_capsfilter) {
+        m_timer->start(ReceiverReport::pollInterval);
+    } else {
+        m_timer->stop();
+    }
+}
+
+void VideoAdaptationController::poll()
+{
+    FsCodec *codec = NULL;
+    g_object_get(static_cast<GObject*>(m_session), "current-send-codec", &codec, NULL);
+    if (!codec) {
+        return;
+    }
+    int clockRate = codec->clock_rate;
+    fs_codec_destroy(codec);
+
+    QGst::ElementPtr encoder = SessionElements::findSendEncoder(m_session, m_pipeline, "Video");
+    if (static_cast<GstElement*>(encoder) != static_cast<GstElement*>(m_encoder)) {
+        m_encoder = encoder;
+        applyBitrate();
+    }
+
+    ReceiverReport report;
+    if (!ReceiverReport::read(m_session, clockRate, m_lastReportSeq, &report)) {
+        return;
+    }
+    m_lastReportSeq = report.sequence;
+    if (m_policy.update(report.fractionLost, report.roundTripMs, allowedBitrate())) {
+        apply();
+    }
+}
+
+void VideoAdaptationController::lowerCpuLimit()
+{
+    if (m_policy.lowerCpuLimit()) {
+        ++m_cpuStepsDown;
+        qCDebug(LIBKTPCALL) << "The CPU cannot keep up with the video, step down" << m_cpuStepsDown
+                            << "(" << m_cpuStepsUp << "up )";
+        apply();
+    }
+}
+
+void VideoAdaptationController::raiseCpuLimit()
+{
+    if (m_policy.raiseCpuLimit()) {
+        ++m_cpuStepsUp;
+        qCDebug(LIBKTPCALL) << "The CPU has time to spare for the video, step up" << m_cpuStepsUp
+                            << "(" << m_cpuStepsDown << "down )";
+        apply();
+    }
+}
+
+int VideoAdaptationController::allowedBitrate() const
+{
+    //the rtp sessions of fsconference have it from TFRC or from the negotiated bandwidth
+    GParamSpec *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(static_cast<GObject*>(m_session)),
+                                                    "send-bitrate");
+    if (!spec || G_PARAM_SPEC_VALUE_TYPE(spec) != G_TYPE_UINT) {
+        return 0;
+    }
+    guint bitrate = 0;
+    g_object_get(static_cast<GObject*>(m_session), "send-bitrate", &bitrate, NULL);
+    return int(qMin(bitrate, guint(G_MAXINT)));
+}
+
+void VideoAdaptationController::applyBitrate()
+{
+    if (!m_encoder) {
+        return;
+    }
+
+    //every encoder has its own name and unit for the bitrate
+    GObject *encoder = static_cast<GObject*>(m_encoder);
+    GstElementFactory *factory = gst_element_get_factory(m_encoder);
+    const gchar *name = factory ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)) : "";
+    const int bitrate = m_policy.tier().bitrate;
+    if (g_str_equal(name, "vp8enc") || g_str_equal(name, "vp9enc")) {
+        g_object_set(encoder, "target-bitrate", gint(bitrate), NULL);
+    } else if (g_str_equal(name, "x264enc")) {
+        g_object_set(encoder, "bitrate", guint(bitrate / 1000), NULL);
+    } else if (g_str_equal(name, "theoraenc")) {
+        g_object_set(encoder, "bitrate", gint(bitrate / 1000), NULL);
+    } else if (g_str_equal(name, "openh264enc")) {
+        g_object_set(encoder, "bitrate", guint(bitrate), NULL);
+    } else {
+        qCDebug(LIBKTPCALL) << "Not setting the bitrate of the video encoder" << m_encoder->name()
+                            << "(" << name << "), which is not known";
+        return;
+    }
+    qCDebug(LIBKTPCALL) << "Video encoder" << m_encoder->name() << "set to" << bitrate << "bps";
+}
+
+void VideoAdaptationController::apply()
+{
+    if (!m_capsfilter) {
+        return;
+    }
+
+    const VideoAdaptationPolicy::Tier tier = m_policy.tier();
+    qCDebug(LIBKTPCALL) << "Video estimate" << m_policy.estimatedBitrate() << "bps: sending"
+                        << tier.width << "x" << tier.height << "at" << tier.framerate << "fps";
+
+    //while playing, without stopping the camera
+    CaptureCaps::renegotiate(m_capsfilter, m_videorate, caps());
+    applyBitrate();
+}
+
+} // KTpCallPrivate
@@ -0,0 +1,154 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VIDEO_ADAPTATION_H
+#define VIDEO_ADAPTATION_H
+
+#include <QtCore/QObject>
+#include <QGlib/Object>
+#include <QGst/Bin>
+#include <QGst/Caps>
+#include <QGst/Element>
+
+class QTimer;
+
+namespace KTpCallPrivate {
+
+/* Picks the resolution and framerate of the video that we send from the receiver
+ * reports of the remote side, out of a few tiers from 720p at 30fps down to
+ * 180p at 10fps. The tiers keep the aspect ratio that the remote side asks for,
+ * or else the one of the camera, and never go above the size of the camera.
+ *
+ * The bandwidth is estimated from the loss: it grows while there is none and
+ * shrinks with the loss when that is high, or when the round trip shows queuing.
+ * The video drops to the tier that fits as soon as the estimate does, but only
+ * goes up one tier at a time, after the estimate has had room for it for a few
+ * reports. Independently, a CPU limit keeps the video below the tiers that the
+ * local CPU could not capture and encode in time. This does not touch GStreamer,
+ * so that it can be run against simulated networks. */
+class VideoAdaptationPolicy
+{
+public:
+    struct Tier
+    {
+        int width;
+        int height;
+        int framerate;
+        int bitrate; //bps that it takes to look good
+    };
+
+    VideoAdaptationPolicy();
+
+    /* Keeps the tiers within what the remote side asked for; 0 means no limit */
+    void setLimits(int maxWidth, int maxHeight, int maxFramerate);
+
+    /* Keeps the tiers within the largest size that the camera captures; 0 if unknown */
+    void setNativeSize(int width, int height);
+
+    /* Takes the fraction of packets lost (0 to 1) and the round trip in ms from a
+     * new receiver report and the bitrate that fsconference lets us send, 0 if it
+     * does not know; returns whether the tier changed */
+    bool update(double fractionLost, int roundTripMs, int allowedBitrate);
+
+    /* The CPU fell behind: sends one tier below the current one, until raiseCpuLimit.
+     * Both return whether the tier changed */
+    bool lowerCpuLimit();
+    /* The CPU has time to spare: allows one tier more again, if it was limited */
+    bool raiseCpuLimit();
+
+    Tier tier() const;
+    int estimatedBitrate() const { return int(m_estimate); }
+
+private:
+    Tier tierAt(int index) const;
+    int topTier() const;
+    int tierFor(double bitrate) const;
+    void updateTiers();
+
+    int m_maxWidth;
+    int m_maxHeight;
+    int m_maxFramerate;
+    int m_nativeWidth;
+    int m_nativeHeight;
+    double m_aspectRatio; //width / height of every tier
+    double m_loss;
+    double m_estimate;
+    int m_tier; //what the network carries
+    int m_cpuTier; //the best tier that the CPU keeps up with, 0 when it is not limited
+    int m_roomyReports; //in a row with room for the next tier up
+    int m_holdReports; //before going up again after a drop
+};
+
+/* Applies a VideoAdaptationPolicy to the capture bin of a video content: every
+ * tier change goes to its capsfilter, to its videorate for the framerate and to
+ * the encoder of the session for the bitrate.
+ * The steps taken for the CPU are counted, for the debug output. */
+class VideoAdaptationController : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VideoAdaptationController(QObject *parent = 0);
+    virtual ~VideoAdaptationController();
+
+    /* Whether the video should follow the network, as configured */
+    static bool isEnabled();
+
+    /* See VideoAdaptationPolicy::setLimits. The new tier is only in caps(); the
+     * capture bin is left for the caller to renegotiate or restart */
+    void setLimits(int maxWidth, int maxHeight, int maxFramerate);
+
+    /* See VideoAdaptationPolicy::setNativeSize. Applies the new tier, if any */
+    void setNativeSize(int width, int height);
+
+    /* How many steps down and back up the CPU made the video take since this was made */
+    void cpuStepStatistics(int *stepsDown, int *stepsUp) const;
+
+    /* The caps of the current tier */
+    QGst::CapsPtr caps() const;
+
+    /* Starts following the receiver reports of session, applying the tiers to
+     * capsfilter and videorate and to the encoder of session in pipeline. A null
+     * session stops */
+    void setSession(const QGlib::ObjectPtr & session, const QGst::ElementPtr & capsfilter,
+                    const QGst::ElementPtr & videorate, const QGst::BinPtr & pipeline);
+
+public Q_SLOTS:
+    void lowerCpuLimit();
+    void raiseCpuLimit();
+
+private Q_SLOTS:
+    void poll();
+
+private:
+    int allowedBitrate() const;
+    void apply();
+    void applyBitrate();
+
+    QGlib::ObjectPtr m_session;
+    QGst::ElementPtr m_capsfilter;
+    QGst::ElementPtr m_videorate;
+    QGst::BinPtr m_pipeline;
+    QGst::ElementPtr m_encoder; //of the current send codec
+    VideoAdaptationPolicy m_policy;
+    guint m_lastReportSeq; //the report that m_policy has already seen
+    QTimer *m_timer;
+    int m_cpuStepsDown;
+    int m_cpuStepsUp;
+};
+
+} // KTpCallPrivate
+
+#endif // VIDEO_ADAPTATION_H
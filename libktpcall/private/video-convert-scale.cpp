@@ -0,0 +1,289 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "video-convert-scale.h"
+#include "video-kernels.h"
+#include "libktpcall_debug.h"
+
+#include <QGst/ElementFactory>
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+namespace KTpCallPrivate {
+
+static const char s_factoryName[] = "ktpvideoconvertscale";
+
+#define KTPCALL_SINK_FORMATS "{ I420, YV12 }"
+#define KTPCALL_SRC_FORMATS "{ BGRx, BGRA, RGBx, RGBA }"
+static const char *const s_sinkFormats[] = { "I420", "YV12", NULL };
+static const char *const s_srcFormats[] = { "BGRx", "BGRA", "RGBx", "RGBA", NULL };
+
+static GstStaticPadTemplate s_sinkTemplate = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE(KTPCALL_SINK_FORMATS)));
+static GstStaticPadTemplate s_srcTemplate = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE(KTPCALL_SRC_FORMATS)));
+
+enum {
+    PROP_0,
+    PROP_MIRROR
+};
+
+struct KTpVideoConvertScale
+{
+    GstVideoFilter parent;
+
+    gboolean mirror; //guarded by the object lock
+    //only used from the streaming thread
+    ConvertScalePlan *plan;
+    gboolean planMirror;
+};
+
+struct KTpVideoConvertScaleClass
+{
+    GstVideoFilterClass parent_class;
+};
+
+G_DEFINE_TYPE(KTpVideoConvertScale, ktp_video_convert_scale, GST_TYPE_VIDEO_FILTER)
+
+static inline KTpVideoConvertScale *toSelf(gpointer object)
+{
+    return reinterpret_cast<KTpVideoConvertScale*>(object);
+}
+
+static void makePlan(KTpVideoConvertScale *self, const GstVideoInfo *inInfo, const GstVideoInfo *outInfo)
+{
+    GST_OBJECT_LOCK(self);
+    gboolean mirror = self->mirror;
+    GST_OBJECT_UNLOCK(self);
+
+    GstVideoFormat format = GST_VIDEO_INFO_FORMAT(outInfo);
+    bool swapRB = format == GST_VIDEO_FORMAT_RGBx || format == GST_VIDEO_FORMAT_RGBA;
+    VideoKernels::YuvMatrix matrix = VideoKernels::matrix(
+            inInfo->colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT709,
+            inInfo->colorimetry.range == GST_VIDEO_COLOR_RANGE_0_255);
+
+    delete self->plan;
+    self->plan = new ConvertScalePlan(GST_VIDEO_INFO_WIDTH(inInfo), GST_VIDEO_INFO_HEIGHT(inInfo),
+                                      GST_VIDEO_INFO_WIDTH(outInfo), GST_VIDEO_INFO_HEIGHT(outInfo),
+                                      mirror, matrix, swapRB);
+    self->planMirror = mirror;
+}
+
+static gboolean setInfo(GstVideoFilter *filter, GstCaps *incaps, GstVideoInfo *inInfo,
+                        GstCaps *outcaps, GstVideoInfo *outInfo)
+{
+    Q_UNUSED(incaps);
+    Q_UNUSED(outcaps);
+    makePlan(toSelf(filter), inInfo, outInfo);
+    return TRUE;
+}
+
+static GstFlowReturn transformFrame(GstVideoFilter *filter, GstVideoFrame *inFrame, GstVideoFrame *outFrame)
+{
+    KTpVideoConvertScale *self = toSelf(filter);
+
+    GST_OBJECT_LOCK(self);
+    bool mirrorChanged = self->mirror != self->planMirror;
+    GST_OBJECT_UNLOCK(self);
+    if (mirrorChanged) {
+        makePlan(self, &filter->in_info, &filter->out_info);
+    }
+
+    //YV12 has the planes the other way round
+    const quint8 *planes[3] = {
+        static_cast<const quint8*>(GST_VIDEO_FRAME_COMP_DATA(inFrame, GST_VIDEO_COMP_Y)),
+        static_cast<const quint8*>(GST_VIDEO_FRAME_COMP_DATA(inFrame, GST_VIDEO_COMP_U)),
+        static_cast<const quint8*>(GST_VIDEO_FRAME_COMP_DATA(inFrame, GST_VIDEO_COMP_V))
+    };
+    const int strides[3] = {
+        GST_VIDEO_FRAME_COMP_STRIDE(inFrame, GST_VIDEO_COMP_Y),
+        GST_VIDEO_FRAME_COMP_STRIDE(inFrame, GST_VIDEO_COMP_U),
+        GST_VIDEO_FRAME_COMP_STRIDE(inFrame, GST_VIDEO_COMP_V)
+    };
+
+    self->plan->run(planes, strides, static_cast<quint8*>(GST_VIDEO_FRAME_PLANE_DATA(outFrame, 0)),
+                    GST_VIDEO_FRAME_PLANE_STRIDE(outFrame, 0));
+    return GST_FLOW_OK;
+}
+
+static GstCaps *transformCaps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+    Q_UNUSED(trans);
+
+    //going downstream, what can be made of caps; going upstream, what it can be made from
+    const char *const *formats = direction == GST_PAD_SINK ? s_srcFormats : s_sinkFormats;
+    GValue formatList = G_VALUE_INIT;
+    g_value_init(&formatList, GST_TYPE_LIST);
+    for (int i = 0; formats[i]; ++i) {
+        GValue format = G_VALUE_INIT;
+        g_value_init(&format, G_TYPE_STRING);
+        g_value_set_static_string(&format, formats[i]);
+        gst_value_list_append_value(&formatList, &format);
+        g_value_unset(&format);
+    }
+
+    GstCaps *result = gst_caps_new_empty();
+    if (gst_caps_is_any(caps)) {
+        result = gst_caps_merge(result, gst_static_pad_template_get_caps(
+                direction == GST_PAD_SINK ? &s_srcTemplate : &s_sinkTemplate));
+    }
+    for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+        //the frames are read and written with the CPU
+        GstCapsFeatures *features = gst_caps_get_features(caps, i);
+        if (features && !gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY)) {
+            continue;
+        }
+
+        //any size, in any of the formats of the other side
+        GstStructure *structure = gst_structure_copy(gst_caps_get_structure(caps, i));
+        gst_structure_remove_fields(structure, "format", "colorimetry", "chroma-site", NULL);
+        gst_structure_set(structure,
+                          "width", GST_TYPE_INT_RANGE, 1, G_MAXINT,
+                          "height", GST_TYPE_INT_RANGE, 1, G_MAXINT,
+                          NULL);
+        gst_structure_set_value(structure, "format", &formatList);
+        result = gst_caps_merge_structure(result, structure);
+    }
+    g_value_unset(&formatList);
+
+    if (filter) {
+        GstCaps *intersection = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(result);
+        result = intersection;
+    }
+    return result;
+}
+
+static GstCaps *fixateCaps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps, GstCaps *othercaps)
+{
+    Q_UNUSED(trans);
+    Q_UNUSED(direction);
+
+    othercaps = gst_caps_make_writable(gst_caps_truncate(othercaps));
+    GstStructure *structure = gst_caps_get_structure(othercaps, 0);
+
+    //the same size if the other side takes it, else the same aspect ratio
+    int width;
+    int height;
+    GstStructure *fixed = gst_caps_get_structure(caps, 0);
+    if (gst_structure_get_int(fixed, "width", &width) && gst_structure_get_int(fixed, "height", &height)
+            && width > 0) {
+        gst_structure_fixate_field_nearest_int(structure, "width", width);
+        int otherWidth;
+        if (gst_structure_get_int(structure, "width", &otherWidth)) {
+            gst_structure_fixate_field_nearest_int(structure, "height", int(qint64(height) * otherWidth / width));
+        }
+    }
+    return gst_caps_fixate(othercaps);
+}
+
+static void setProperty(GObject *object, guint id, const GValue *value, GParamSpec *pspec)
+{
+    KTpVideoConvertScale *self = toSelf(object);
+    switch (id) {
+    case PROP_MIRROR:
+        GST_OBJECT_LOCK(self);
+        self->mirror = g_value_get_boolean(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        break;
+    }
+}
+
+static void getProperty(GObject *object, guint id, GValue *value, GParamSpec *pspec)
+{
+    KTpVideoConvertScale *self = toSelf(object);
+    switch (id) {
+    case PROP_MIRROR:
+        GST_OBJECT_LOCK(self);
+        g_value_set_boolean(value, self->mirror);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        break;
+    }
+}
+
+static void finalize(GObject *object)
+{
+    delete toSelf(object)->plan;
+    G_OBJECT_CLASS(ktp_video_convert_scale_parent_class)->finalize(object);
+}
+
+static void ktp_video_convert_scale_class_init(KTpVideoConvertScaleClass *klass)
+{
+    GObjectClass *objectClass = G_OBJECT_CLASS(klass);
+    objectClass->set_property = &setProperty;
+    objectClass->get_property = &getProperty;
+    objectClass->finalize = &finalize;
+    g_object_class_install_property(objectClass, PROP_MIRROR,
+            g_param_spec_boolean("mirror", "Mirror", "Mirror the picture horizontally", FALSE,
+                                 GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+
+    GstElementClass *elementClass = GST_ELEMENT_CLASS(klass);
+    gst_element_class_set_static_metadata(elementClass, "KTp video converter and scaler",
+            "Filter/Converter/Video/Scaler",
+            "Converts YUV to RGB, scales and mirrors video in one pass",
+            "KDE Telepathy developers");
+    gst_element_class_add_pad_template(elementClass, gst_static_pad_template_get(&s_sinkTemplate));
+    gst_element_class_add_pad_template(elementClass, gst_static_pad_template_get(&s_srcTemplate));
+
+    GstBaseTransformClass *transformClass = GST_BASE_TRANSFORM_CLASS(klass);
+    transformClass->transform_caps = &transformCaps;
+    transformClass->fixate_caps = &fixateCaps;
+
+    GstVideoFilterClass *filterClass = GST_VIDEO_FILTER_CLASS(klass);
+    filterClass->set_info = &setInfo;
+    filterClass->transform_frame = &transformFrame;
+}
+
+static void ktp_video_convert_scale_init(KTpVideoConvertScale *self)
+{
+    self->mirror = FALSE;
+    self->plan = NULL;
+    self->planMirror = FALSE;
+}
+
+QGst::ElementPtr VideoConvertScale::make(bool mirror)
+{
+    static gsize registered = 0;
+    if (g_once_init_enter(&registered)) {
+        //a plugin of its own would only be found through the plugin path
+        gboolean ok = gst_element_register(NULL, s_factoryName, GST_RANK_NONE, ktp_video_convert_scale_get_type());
+        g_once_init_leave(&registered, ok ? 1 : 2);
+    }
+    if (registered != 1) {
+        qCWarning(LIBKTPCALL) << "Failed to register the" << s_factoryName << "element";
+        return QGst::ElementPtr();
+    }
+
+    QGst::ElementPtr element = QGst::ElementFactory::make(s_factoryName);
+    if (element) {
+        element->setProperty("mirror", mirror);
+    }
+    return element;
+}
+
+QGst::CapsPtr VideoConvertScale::srcCaps()
+{
+    return QGst::Caps::fromString(QStringLiteral(GST_VIDEO_CAPS_MAKE(KTPCALL_SRC_FORMATS)));
+}
+
+} // KTpCallPrivate
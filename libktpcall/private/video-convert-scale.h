@@ -0,0 +1,41 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VIDEO_CONVERT_SCALE_H
+#define VIDEO_CONVERT_SCALE_H
+
+#include <QGst/Caps>
+#include <QGst/Element>
+
+namespace KTpCallPrivate {
+
+/* The ktpvideoconvertscale element: I420 or YV12 in, 32-bit RGB out, at any size
+ * and, with its "mirror" property, mirrored horizontally. It does what
+ * videoconvert ! videoscale ! videoflip do, in a single pass with ConvertScalePlan,
+ * for the video sinks that take nothing but RGB. */
+class VideoConvertScale
+{
+public:
+    /* A new element, registering it with GStreamer first if needed */
+    static QGst::ElementPtr make(bool mirror);
+
+    /* What the element produces; a sink that takes none of it needs videoconvert */
+    static QGst::CapsPtr srcCaps();
+};
+
+} // KTpCallPrivate
+
+#endif // VIDEO_CONVERT_SCALE_H
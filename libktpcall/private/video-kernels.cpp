@@ -0,0 +1,507 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "video-kernels.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+# define KTPCALL_HAVE_SSE2 1
+# include <emmintrin.h>
+#endif
+//AVX2 is compiled in per function and only used if the CPU has it
+#if defined(KTPCALL_HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define KTPCALL_HAVE_AVX2 1
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define KTPCALL_HAVE_NEON 1
+# include <arm_neon.h>
+#endif
+
+namespace KTpCallPrivate {
+namespace VideoKernels {
+
+YuvMatrix matrix(bool bt709, bool fullRange)
+{
+    //the coefficients times 64
+    static const YuvMatrix limited601 = { 16, 74, 1, 102, 25, 52, 129 };
+    static const YuvMatrix limited709 = { 16, 74, 1, 115, 14, 34, 135 };
+    static const YuvMatrix full601 = { 0, 64, 0, 90, 22, 46, 113 };
+    static const YuvMatrix full709 = { 0, 64, 0, 101, 12, 30, 119 };
+
+    if (fullRange) {
+        return bt709 ? full709 : full601;
+    }
+    return bt709 ? limited709 : limited601;
+}
+
+//BEGIN portable
+
+//the SIMD variants compute in saturating 16-bit arithmetic; this does the same
+static inline int saturate16(int value)
+{
+    return qBound(-32768, value, 32767);
+}
+
+static inline quint8 channelValue(int value)
+{
+    return quint8(qBound(0, saturate16(value + 32) >> 6, 255));
+}
+
+static void blendRowsPortable(const quint8 *a, const quint8 *b, int weight, quint8 *out, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = quint8((a[i] * (256 - weight) + b[i] * weight + 128) >> 8);
+    }
+}
+
+static void yuvToRgbRowPortable(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst,
+                                int width, const YuvMatrix & m, bool swapRB, bool reverse)
+{
+    for (int x = 0; x < width; ++x) {
+        int luma = (y[x] - m.yOffset) * m.yScale + (((y[x] - m.yOffset) * m.yHalf) >> 1);
+        int cb = u[x / 2] - 128;
+        int cr = v[x / 2] - 128;
+
+        quint8 r = channelValue(saturate16(luma + cr * m.rv));
+        quint8 g = channelValue(saturate16(saturate16(luma - cb * m.gu) - cr * m.gv));
+        quint8 b = channelValue(saturate16(luma + cb * m.bu));
+
+        quint8 *pixel = dst + 4 * (reverse ? width - 1 - x : x);
+        pixel[0] = swapRB ? r : b;
+        pixel[1] = g;
+        pixel[2] = swapRB ? b : r;
+        pixel[3] = 255;
+    }
+}
+
+static const Kernels s_portable = { "C++", &blendRowsPortable, &yuvToRgbRowPortable };
+
+//END portable
+//BEGIN SSE2
+
+#ifdef KTPCALL_HAVE_SSE2
+
+static void blendRowsSse2(const quint8 *a, const quint8 *b, int weight, quint8 *out, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weightA = _mm_set1_epi16(short(256 - weight));
+    const __m128i weightB = _mm_set1_epi16(short(weight));
+    const __m128i half = _mm_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i b8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+        //at most 255 * 256 + 128, which fits the unsigned 16-bit lanes
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a8, zero), weightA),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b8, zero), weightB));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a8, zero), weightA),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b8, zero), weightB));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(lo, hi));
+    }
+    blendRowsPortable(a + i, b + i, weight, out + i, count - i);
+}
+
+/* Stores 16 pixels from their channels, at pixel x of a row of width pixels */
+static inline void storePixelsSse2(quint8 *dst, int x, int width, __m128i first, __m128i g,
+                                   __m128i third, bool reverse)
+{
+    const __m128i alpha = _mm_set1_epi8(char(0xff));
+    __m128i fg_lo = _mm_unpacklo_epi8(first, g);
+    __m128i fg_hi = _mm_unpackhi_epi8(first, g);
+    __m128i ta_lo = _mm_unpacklo_epi8(third, alpha);
+    __m128i ta_hi = _mm_unpackhi_epi8(third, alpha);
+    __m128i pixels[4] = {
+        _mm_unpacklo_epi16(fg_lo, ta_lo),
+        _mm_unpackhi_epi16(fg_lo, ta_lo),
+        _mm_unpacklo_epi16(fg_hi, ta_hi),
+        _mm_unpackhi_epi16(fg_hi, ta_hi)
+    };
+
+    if (!reverse) {
+        quint8 *out = dst + 4 * x;
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i), pixels[i]);
+        }
+    } else {
+        //the last 4 pixels come first, each group of 4 reversed
+        quint8 *out = dst + 4 * (width - x - 16);
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i),
+                             _mm_shuffle_epi32(pixels[3 - i], _MM_SHUFFLE(0, 1, 2, 3)));
+        }
+    }
+}
+
+static inline __m128i channelSse2(__m128i value)
+{
+    return _mm_srai_epi16(_mm_adds_epi16(value, _mm_set1_epi16(32)), 6);
+}
+
+static void yuvToRgbRowSse2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst,
+                            int width, const YuvMatrix & m, bool swapRB, bool reverse)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i yOffset = _mm_set1_epi16(short(m.yOffset));
+    const __m128i yScale = _mm_set1_epi16(short(m.yScale));
+    const __m128i yHalf = _mm_set1_epi16(short(m.yHalf));
+    const __m128i rv = _mm_set1_epi16(short(m.rv));
+    const __m128i gu = _mm_set1_epi16(short(m.gu));
+    const __m128i gv = _mm_set1_epi16(short(m.gv));
+    const __m128i bu = _mm_set1_epi16(short(m.bu));
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        __m128i u16 = _mm_sub_epi16(_mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2)), zero), chromaOffset);
+        __m128i v16 = _mm_sub_epi16(_mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2)), zero), chromaOffset);
+
+        //every chroma sample covers two pixels
+        __m128i cb[2] = { _mm_unpacklo_epi16(u16, u16), _mm_unpackhi_epi16(u16, u16) };
+        __m128i cr[2] = { _mm_unpacklo_epi16(v16, v16), _mm_unpackhi_epi16(v16, v16) };
+        __m128i luma[2] = {
+            _mm_sub_epi16(_mm_unpacklo_epi8(y8, zero), yOffset),
+            _mm_sub_epi16(_mm_unpackhi_epi8(y8, zero), yOffset)
+        };
+        for (int i = 0; i < 2; ++i) {
+            luma[i] = _mm_add_epi16(_mm_mullo_epi16(luma[i], yScale),
+                                    _mm_srai_epi16(_mm_mullo_epi16(luma[i], yHalf), 1));
+        }
+
+        __m128i r[2], g[2], b[2];
+        for (int i = 0; i < 2; ++i) {
+            r[i] = channelSse2(_mm_adds_epi16(luma[i], _mm_mullo_epi16(cr[i], rv)));
+            g[i] = channelSse2(_mm_subs_epi16(_mm_subs_epi16(luma[i], _mm_mullo_epi16(cb[i], gu)),
+                                              _mm_mullo_epi16(cr[i], gv)));
+            b[i] = channelSse2(_mm_adds_epi16(luma[i], _mm_mullo_epi16(cb[i], bu)));
+        }
+
+        __m128i r8 = _mm_packus_epi16(r[0], r[1]);
+        __m128i g8 = _mm_packus_epi16(g[0], g[1]);
+        __m128i b8 = _mm_packus_epi16(b[0], b[1]);
+        storePixelsSse2(dst, x, width, swapRB ? r8 : b8, g8, swapRB ? b8 : r8, reverse);
+    }
+
+    //the rest of the row; mirrored, it goes to the start of dst
+    yuvToRgbRowPortable(y + x, u + x / 2, v + x / 2, reverse ? dst : dst + 4 * x,
+                        width - x, m, swapRB, reverse);
+}
+
+static const Kernels s_sse2 = { "SSE2", &blendRowsSse2, &yuvToRgbRowSse2 };
+
+#endif // KTPCALL_HAVE_SSE2
+
+//END SSE2
+//BEGIN AVX2
+
+#ifdef KTPCALL_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static void blendRowsAvx2(const quint8 *a, const quint8 *b, int weight, quint8 *out, int count)
+{
+    const __m256i weightA = _mm256_set1_epi16(short(256 - weight));
+    const __m256i weightB = _mm256_set1_epi16(short(weight));
+    const __m256i half = _mm256_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i sums[2];
+        for (int j = 0; j < 2; ++j) {
+            __m256i a16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16 * j)));
+            __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16 * j)));
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a16, weightA), _mm256_mullo_epi16(b16, weightB));
+            sums[j] = _mm256_srli_epi16(_mm256_add_epi16(sum, half), 8);
+        }
+        //packus works within the 128-bit lanes; put the quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sums[0], sums[1]), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+    blendRowsSse2(a + i, b + i, weight, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m128i channelAvx2(__m256i value)
+{
+    value = _mm256_srai_epi16(_mm256_adds_epi16(value, _mm256_set1_epi16(32)), 6);
+    return _mm_packus_epi16(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+}
+
+__attribute__((target("avx2")))
+static void yuvToRgbRowAvx2(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst,
+                            int width, const YuvMatrix & m, bool swapRB, bool reverse)
+{
+    const __m256i yOffset = _mm256_set1_epi16(short(m.yOffset));
+    const __m256i yScale = _mm256_set1_epi16(short(m.yScale));
+    const __m256i yHalf = _mm256_set1_epi16(short(m.yHalf));
+    const __m256i rv = _mm256_set1_epi16(short(m.rv));
+    const __m256i gu = _mm256_set1_epi16(short(m.gu));
+    const __m256i gv = _mm256_set1_epi16(short(m.gv));
+    const __m256i bu = _mm256_set1_epi16(short(m.bu));
+    const __m256i chromaOffset = _mm256_set1_epi16(128);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        //16 pixels in one register, every chroma sample twice
+        __m256i luma = _mm256_sub_epi16(_mm256_cvtepu8_epi16(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x))), yOffset);
+        luma = _mm256_add_epi16(_mm256_mullo_epi16(luma, yScale),
+                                _mm256_srai_epi16(_mm256_mullo_epi16(luma, yHalf), 1));
+        __m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2));
+        __m128i v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2));
+        __m256i cb = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)), chromaOffset);
+        __m256i cr = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), chromaOffset);
+
+        __m128i r8 = channelAvx2(_mm256_adds_epi16(luma, _mm256_mullo_epi16(cr, rv)));
+        __m128i g8 = channelAvx2(_mm256_subs_epi16(_mm256_subs_epi16(luma, _mm256_mullo_epi16(cb, gu)),
+                                                   _mm256_mullo_epi16(cr, gv)));
+        __m128i b8 = channelAvx2(_mm256_adds_epi16(luma, _mm256_mullo_epi16(cb, bu)));
+        storePixelsSse2(dst, x, width, swapRB ? r8 : b8, g8, swapRB ? b8 : r8, reverse);
+    }
+
+    yuvToRgbRowPortable(y + x, u + x / 2, v + x / 2, reverse ? dst : dst + 4 * x,
+                        width - x, m, swapRB, reverse);
+}
+
+static const Kernels s_avx2 = { "AVX2", &blendRowsAvx2, &yuvToRgbRowAvx2 };
+
+#endif // KTPCALL_HAVE_AVX2
+
+//END AVX2
+//BEGIN NEON
+
+#ifdef KTPCALL_HAVE_NEON
+
+static void blendRowsNeon(const quint8 *a, const quint8 *b, int weight, quint8 *out, int count)
+{
+    //256 - weight does not fit the 8-bit lanes
+    if (weight == 0) {
+        memcpy(out, a, count);
+        return;
+    }
+
+    const uint8x8_t weightA = vdup_n_u8(quint8(256 - weight));
+    const uint8x8_t weightB = vdup_n_u8(quint8(weight));
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t a8 = vld1q_u8(a + i);
+        uint8x16_t b8 = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a8), weightA), vget_low_u8(b8), weightB);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a8), weightA), vget_high_u8(b8), weightB);
+        //rounding shift: + 128, >> 8
+        vst1q_u8(out + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+    blendRowsPortable(a + i, b + i, weight, out + i, count - i);
+}
+
+static inline uint8x8_t channelNeon(int16x8_t value)
+{
+    return vqmovun_s16(vshrq_n_s16(vqaddq_s16(value, vdupq_n_s16(32)), 6));
+}
+
+static inline uint8x16_t reverseNeon(uint8x16_t value)
+{
+    value = vrev64q_u8(value);
+    return vcombine_u8(vget_high_u8(value), vget_low_u8(value));
+}
+
+static void yuvToRgbRowNeon(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst,
+                            int width, const YuvMatrix & m, bool swapRB, bool reverse)
+{
+    const int16x8_t yOffset = vdupq_n_s16(m.yOffset);
+    const int16x8_t chromaOffset = vdupq_n_s16(128);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t y8 = vld1q_u8(y + x);
+        int16x8_t u16 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x / 2))), chromaOffset);
+        int16x8_t v16 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x / 2))), chromaOffset);
+
+        //every chroma sample covers two pixels
+        int16x8x2_t cb = vzipq_s16(u16, u16);
+        int16x8x2_t cr = vzipq_s16(v16, v16);
+        int16x8_t luma[2] = {
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8))), yOffset),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8))), yOffset)
+        };
+        for (int i = 0; i < 2; ++i) {
+            luma[i] = vaddq_s16(vmulq_n_s16(luma[i], m.yScale), vshrq_n_s16(vmulq_n_s16(luma[i], m.yHalf), 1));
+        }
+
+        uint8x8_t r[2], g[2], b[2];
+        for (int i = 0; i < 2; ++i) {
+            r[i] = channelNeon(vqaddq_s16(luma[i], vmulq_n_s16(cr.val[i], m.rv)));
+            g[i] = channelNeon(vqsubq_s16(vqsubq_s16(luma[i], vmulq_n_s16(cb.val[i], m.gu)),
+                                          vmulq_n_s16(cr.val[i], m.gv)));
+            b[i] = channelNeon(vqaddq_s16(luma[i], vmulq_n_s16(cb.val[i], m.bu)));
+        }
+
+        uint8x16_t r8 = vcombine_u8(r[0], r[1]);
+        uint8x16_t b8 = vcombine_u8(b[0], b[1]);
+        uint8x16x4_t pixels;
+        pixels.val[0] = swapRB ? r8 : b8;
+        pixels.val[1] = vcombine_u8(g[0], g[1]);
+        pixels.val[2] = swapRB ? b8 : r8;
+        pixels.val[3] = vdupq_n_u8(255);
+
+        if (reverse) {
+            for (int i = 0; i < 3; ++i) {
+                pixels.val[i] = reverseNeon(pixels.val[i]);
+            }
+            vst4q_u8(dst + 4 * (width - x - 16), pixels);
+        } else {
+            vst4q_u8(dst + 4 * x, pixels);
+        }
+    }
+
+    yuvToRgbRowPortable(y + x, u + x / 2, v + x / 2, reverse ? dst : dst + 4 * x,
+                        width - x, m, swapRB, reverse);
+}
+
+static const Kernels s_neon = { "NEON", &blendRowsNeon, &yuvToRgbRowNeon };
+
+#endif // KTPCALL_HAVE_NEON
+
+//END NEON
+
+const Kernels & best()
+{
+#if defined(KTPCALL_HAVE_AVX2)
+    static const Kernels & kernels = __builtin_cpu_supports("avx2") ? s_avx2 : s_sse2;
+    return kernels;
+#elif defined(KTPCALL_HAVE_SSE2)
+    return s_sse2;
+#elif defined(KTPCALL_HAVE_NEON)
+    return s_neon;
+#else
+    return s_portable;
+#endif
+}
+
+const Kernels & portable()
+{
+    return s_portable;
+}
+
+} // VideoKernels
+
+//BEGIN ConvertScalePlan
+
+ConvertScalePlan::ConvertScalePlan(int srcWidth, int srcHeight, int dstWidth, int dstHeight, bool mirror,
+                                   const VideoKernels::YuvMatrix & matrix, bool swapRB,
+                                   const VideoKernels::Kernels & kernels)
+    : m_srcWidth(srcWidth),
+      m_srcHeight(srcHeight),
+      m_dstWidth(dstWidth),
+      m_dstHeight(dstHeight),
+      m_matrix(matrix),
+      m_swapRB(swapRB),
+      m_resample(srcWidth != dstWidth),
+      m_mirror(mirror),
+      m_kernels(kernels)
+{
+    const int srcChromaWidth = (srcWidth + 1) / 2;
+    const int dstChromaWidth = (dstWidth + 1) / 2;
+
+    //a chroma row covers two output rows, like in an I420 frame of the output size
+    m_rowTaps = taps(srcHeight, dstHeight, false);
+    m_chromaRowTaps = taps((srcHeight + 1) / 2, (dstHeight + 1) / 2, false);
+
+    m_blended[0].resize(srcWidth);
+    m_blended[1].resize(srcChromaWidth);
+    m_blended[2].resize(srcChromaWidth);
+
+    //without resampling, the mirror is done while converting
+    if (m_resample) {
+        m_columnTaps = taps(srcWidth, dstWidth, mirror);
+        m_chromaColumnTaps = taps(srcChromaWidth, dstChromaWidth, mirror);
+        m_resampled[0].resize(dstWidth);
+        m_resampled[1].resize(dstChromaWidth);
+        m_resampled[2].resize(dstChromaWidth);
+    }
+}
+
+QVector<ConvertScalePlan::Tap> ConvertScalePlan::taps(int srcSize, int dstSize, bool reverse)
+{
+    QVector<Tap> result(dstSize);
+    for (int i = 0; i < dstSize; ++i) {
+        int position = reverse ? dstSize - 1 - i : i;
+        //the centre of the output sample in source samples, in 8-bit fixed point
+        qint64 source = ((2 * qint64(position) + 1) * srcSize * 256) / (2 * qint64(dstSize)) - 128;
+        source = qBound(qint64(0), source, qint64(srcSize - 1) * 256);
+
+        Tap & tap = result[i];
+        tap.first = int(source >> 8);
+        tap.second = qMin(tap.first + 1, srcSize - 1);
+        tap.weight = int(source & 255);
+    }
+    return result;
+}
+
+void ConvertScalePlan::resampleRow(const quint8 *src, const QVector<Tap> & taps, quint8 *out)
+{
+    const Tap *tap = taps.constData();
+    for (int i = 0; i < taps.size(); ++i, ++tap) {
+        out[i] = quint8((src[tap->first] * (256 - tap->weight) + src[tap->second] * tap->weight + 128) >> 8);
+    }
+}
+
+const quint8 *ConvertScalePlan::sourceRow(const quint8 *plane, int stride, const Tap & tap,
+                                          quint8 *line, int width) const
+{
+    //most rows of an unscaled or an integer-scaled frame are used as they are
+    if (tap.weight == 0) {
+        return plane + tap.first * stride;
+    }
+    m_kernels.blendRows(plane + tap.first * stride, plane + tap.second * stride, tap.weight, line, width);
+    return line;
+}
+
+void ConvertScalePlan::run(const quint8 *const planes[3], const int strides[3], quint8 *dst, int dstStride)
+{
+    for (int row = 0; row < m_dstHeight; ++row) {
+        const Tap & chromaTap = m_chromaRowTaps.at(row / 2);
+        const quint8 *lines[3] = {
+            sourceRow(planes[0], strides[0], m_rowTaps.at(row), m_blended[0].data(), m_blended[0].size()),
+            sourceRow(planes[1], strides[1], chromaTap, m_blended[1].data(), m_blended[1].size()),
+            sourceRow(planes[2], strides[2], chromaTap, m_blended[2].data(), m_blended[2].size())
+        };
+
+        if (m_resample) {
+            resampleRow(lines[0], m_columnTaps, m_resampled[0].data());
+            resampleRow(lines[1], m_chromaColumnTaps, m_resampled[1].data());
+            resampleRow(lines[2], m_chromaColumnTaps, m_resampled[2].data());
+            for (int i = 0; i < 3; ++i) {
+                lines[i] = m_resampled[i].constData();
+            }
+        }
+
+        m_kernels.yuvToRgbRow(lines[0], lines[1], lines[2], dst + row * dstStride, m_dstWidth,
+                              m_matrix, m_swapRB, m_mirror && !m_resample);
+    }
+}
+
+//END ConvertScalePlan
+
+} // KTpCallPrivate
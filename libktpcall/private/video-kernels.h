@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef VIDEO_KERNELS_H
+#define VIDEO_KERNELS_H
+
+#include <QtCore/QVector>
+
+namespace KTpCallPrivate {
+
+/* The row kernels of ConvertScalePlan, in plain C++ and with SSE2, AVX2 or NEON.
+ * All variants give exactly the same output. */
+namespace VideoKernels {
+
+/* YUV to RGB in 6-bit fixed point: (Y - yOffset) * (yScale + yHalf / 2), plus the chroma terms */
+struct YuvMatrix
+{
+    int yOffset;
+    int yScale;
+    int yHalf; //1 for the .5 of the 74.5 of limited range
+    int rv;
+    int gu;
+    int gv;
+    int bu;
+};
+
+YuvMatrix matrix(bool bt709, bool fullRange);
+
+/* out = a * (256 - weight) / 256 + b * weight / 256, rounded */
+typedef void (*BlendRowsFunc)(const quint8 *a, const quint8 *b, int weight, quint8 *out, int count);
+
+/* Converts width pixels, with one u and v sample for every two pixels, to 4 bytes
+ * per pixel: B, G, R, 255 or, with swapRB, R, G, B, 255. With reverse, the pixels
+ * are written from the end of dst, mirroring the row */
+typedef void (*YuvToRgbRowFunc)(const quint8 *y, const quint8 *u, const quint8 *v, quint8 *dst,
+                                int width, const YuvMatrix & m, bool swapRB, bool reverse);
+
+struct Kernels
+{
+    const char *name;
+    BlendRowsFunc blendRows;
+    YuvToRgbRowFunc yuvToRgbRow;
+};
+
+/* The fastest kernels that the CPU runs */
+const Kernels & best();
+const Kernels & portable();
+
+} // VideoKernels
+
+/* Converts an I420 frame to 32-bit RGB, scales it bilinearly and mirrors it
+ * horizontally if asked to, in one pass over the memory of both frames.
+ *
+ * Every output row is built from the one or two source rows around it: these
+ * are blended into line buffers, resampled to the output width, with the mirror
+ * in the resampling taps, and converted straight into the output frame. */
+class ConvertScalePlan
+{
+public:
+    ConvertScalePlan(int srcWidth, int srcHeight, int dstWidth, int dstHeight, bool mirror,
+                     const VideoKernels::YuvMatrix & matrix, bool swapRB,
+                     const VideoKernels::Kernels & kernels = VideoKernels::best());
+
+    /* planes and strides are Y, U, V */
+    void run(const quint8 *const planes[3], const int strides[3], quint8 *dst, int dstStride);
+
+private:
+    struct Tap
+    {
+        int first;
+        int second;
+        int weight; //of second, out of 256
+    };
+
+    static QVector<Tap> taps(int srcSize, int dstSize, bool reverse);
+    static void resampleRow(const quint8 *src, const QVector<Tap> & taps, quint8 *out);
+    const quint8 *sourceRow(const quint8 *plane, int stride, const Tap & tap, quint8 *line, int width) const;
+
+    int m_srcWidth;
+    int m_srcHeight;
+    int m_dstWidth;
+    int m_dstHeight;
+    VideoKernels::YuvMatrix m_matrix;
+    bool m_swapRB;
+    bool m_resample; //otherwise the rows only need to be mirrored, if at all
+    bool m_mirror;
+    VideoKernels::Kernels m_kernels;
+
+    QVector<Tap> m_rowTaps;
+    QVector<Tap> m_chromaRowTaps;
+    QVector<Tap> m_columnTaps;
+    QVector<Tap> m_chromaColumnTaps;
+
+    //one row of each plane, blended at the source width and resampled to the output width
+    QVector<quint8> m_blended[3];
+    QVector<quint8> m_resampled[3];
+};
+
+} // KTpCallPrivate
+
+#endif // VIDEO_KERNELS_H
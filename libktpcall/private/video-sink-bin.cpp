@@ -16,28 +16,72 @@
 */
 
 #include "video-sink-bin.h"
+#include "thread-topology.h"
+#include "video-convert-scale.h"
 #include "libktpcall_debug.h"
 #include <QGst/ElementFactory>
 #include <QGst/GhostPad>
 
 namespace KTpCallPrivate {
 
-VideoSinkBin::VideoSinkBin(const QGst::ElementPtr & videoSink)
+static bool sinkAccepts(const QGst::ElementPtr & videoSink, const QGst::CapsPtr & caps)
+{
+    QGst::PadPtr pad = videoSink->getStaticPad("sink");
+    if (!pad || !caps) {
+        return false;
+    }
+    GstCaps *sinkCaps = gst_pad_query_caps(pad, NULL);
+    bool accepts = sinkCaps && gst_caps_can_intersect(sinkCaps, caps);
+    if (sinkCaps) {
+        gst_caps_unref(sinkCaps);
+    }
+    return accepts;
+}
+
+VideoSinkBin::VideoSinkBin(const QGst::ElementPtr & videoSink, bool mirror)
 {
     m_bin = QGst::Bin::create();
 
-    QGst::ElementPtr queue = QGst::ElementFactory::make("queue");
+    //the conversion and the rendering run in the thread of this queue
+    QGst::ElementPtr queue = ThreadTopology::makeQueue(ThreadTopology::RenderStage,
+                                                       ThreadScheduler::VideoMedia);
+    //both only touch the frames if videoSink cannot take them as they are
     QGst::ElementPtr colorspace = QGst::ElementFactory::make("videoconvert");
-    QGst::ElementPtr videoscale = QGst::ElementFactory::make("videoscale");
-    QGst::ElementPtr videoflip = QGst::ElementFactory::make("videoflip");
 
-    // 4 here represents GST_VIDEO_FLIP_METHOD_HORIZ
-    videoflip->setProperty("method", 4);
+    m_bin->add(queue, colorspace, videoSink);
+
+    //a sink that only takes RGB would have every frame converted, scaled and mirrored,
+    //one element after the other; ktpvideoconvertscale does it in one pass
+    QGst::ElementPtr convertScale;
+    if (!sinkAccepts(videoSink, QGst::Caps::fromString(QStringLiteral("video/x-raw, format=(string){ I420, YV12 }")))
+            && sinkAccepts(videoSink, VideoConvertScale::srcCaps())) {
+        convertScale = VideoConvertScale::make(mirror);
+    }
+
+    if (convertScale) {
+        //videoconvert brings anything else to I420
+        m_bin->add(convertScale);
+        if (!QGst::Element::linkMany(queue, colorspace, convertScale, videoSink)) {
+            qCDebug(LIBKTPCALL) << "queue ! colorspace ! ktpvideoconvertscale ! videoSink failed";
+        }
+    } else {
+        QGst::ElementPtr videoscale = QGst::ElementFactory::make("videoscale");
+        m_bin->add(videoscale);
+
+        if (mirror) {
+            //videoflip copies every frame, even when the sink could mirror it for free
+            QGst::ElementPtr videoflip = QGst::ElementFactory::make("videoflip");
 
-    m_bin->add(queue, colorspace, videoscale, videoflip, videoSink);
+            // 4 here represents GST_VIDEO_FLIP_METHOD_HORIZ
+            videoflip->setProperty("method", 4);
 
-    if (!QGst::Element::linkMany(queue, colorspace, videoscale, videoflip, videoSink)) {
-        qCDebug(LIBKTPCALL) << "queue ! colorspace ! videoscale ! videoflip ! videoSink failed";
+            m_bin->add(videoflip);
+            if (!QGst::Element::linkMany(queue, colorspace, videoscale, videoflip, videoSink)) {
+                qCDebug(LIBKTPCALL) << "queue ! colorspace ! videoscale ! videoflip ! videoSink failed";
+            }
+        } else if (!QGst::Element::linkMany(queue, colorspace, videoscale, videoSink)) {
+            qCDebug(LIBKTPCALL) << "queue ! colorspace ! videoscale ! videoSink failed";
+        }
     }
 
     QGst::PadPtr sinkPad = queue->getStaticPad("sink");
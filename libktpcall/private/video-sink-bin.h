@@ -21,11 +21,18 @@
 
 namespace KTpCallPrivate {
 
+/* Shows video on videoSink, mirrored horizontally like a mirror image.
+ *
+ * The conversion and scaling are passthrough whenever videoSink takes the frames
+ * in the format and size that they come in, which sinks that render with the GPU
+ * usually do. Such sinks can also mirror the picture as a render transform; then
+ * mirror should be false and the frames are not touched at all on the CPU.
+ * Sinks that only take RGB get it from ktpvideoconvertscale, in one pass. */
 class VideoSinkBin
 {
     Q_DISABLE_COPY(VideoSinkBin);
 public:
-    explicit VideoSinkBin(const QGst::ElementPtr & videoSink);
+    explicit VideoSinkBin(const QGst::ElementPtr & videoSink, bool mirror = true);
     virtual ~VideoSinkBin();
 
     QGst::BinPtr bin() const { return m_bin; }
@@ -0,0 +1,295 @@
+/*
+    Copyright (C) 2026 KDE Telepathy developers
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Runs the policies that adapt a call to the network and to the CPU through
+ * fixed sequences of receiver reports and load samples, without a pipeline.
+ */
+
+#include "../private/audio-resilience.h"
+#include "../private/cpu-pressure.h"
+#include "../private/video-adaptation.h"
+
+#include <QtTest/QtTest>
+
+using namespace KTpCallPrivate;
+
+class PolicyTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void audioResilience_data();
+    void audioResilience();
+    void videoAdaptationNetwork();
+    void videoAdaptationLimits_data();
+    void videoAdaptationLimits();
+    void videoAdaptationCpuLimit();
+    void cpuPressure();
+};
+
+struct AudioReport
+{
+    double fractionLost;
+    int jitterMs;
+    bool fec;
+    int packetTime;
+    int bitrate; //0 for anything above the base bitrate
+};
+Q_DECLARE_METATYPE(QList<AudioReport>)
+
+static const int s_audioBaseBitrate = 32000;
+
+void PolicyTest::audioResilience_data()
+{
+    QTest::addColumn<QList<AudioReport> >("reports");
+
+    const AudioReport loss[] = {
+        //slight loss does not switch FEC on
+        { 0.01, 5, false, 20, 32000 },
+        { 0.01, 5, false, 20, 32000 },
+        //2% does, once it persists, and FEC gets bits of its own
+        { 0.02, 5, false, 20, 32000 },
+        { 0.02, 5, true, 20, 0 },
+        //and off again after three clean reports
+        { 0.0, 5, true, 20, 0 },
+        { 0.0, 5, true, 20, 0 },
+        { 0.0, 5, false, 20, 32000 },
+        //congestion: longest packets and fewer bits
+        { 0.3, 5, true, 60, 24000 },
+        { 0.3, 5, true, 60, 24000 },
+        { 0.0, 5, true, 60, 24000 },
+        //both hold while the loss goes down, until it is well below where they started
+        { 0.0, 5, true, 40, 24000 },
+        { 0.0, 5, false, 40, 24000 },
+        { 0.0, 5, false, 40, 32000 },
+        { 0.0, 5, false, 40, 32000 },
+        { 0.0, 5, false, 40, 32000 },
+        { 0.0, 5, false, 20, 32000 }
+    };
+    const AudioReport jitter[] = {
+        { 0.0, 35, false, 40, 32000 },
+        //in between the thresholds the packet time holds
+        { 0.0, 25, false, 40, 32000 },
+        { 0.0, 15, false, 20, 32000 },
+        { 0.0, 65, false, 60, 32000 },
+        { 0.0, 45, false, 40, 32000 },
+        { 0.0, 10, false, 20, 32000 }
+    };
+
+    QList<AudioReport> reports;
+    for (uint i = 0; i < sizeof(loss) / sizeof(loss[0]); ++i) {
+        reports.append(loss[i]);
+    }
+    QTest::newRow("loss") << reports;
+
+    reports.clear();
+    for (uint i = 0; i < sizeof(jitter) / sizeof(jitter[0]); ++i) {
+        reports.append(jitter[i]);
+    }
+    QTest::newRow("jitter") << reports;
+}
+
+void PolicyTest::audioResilience()
+{
+    QFETCH(QList<AudioReport>, reports);
+
+    AudioResiliencePolicy policy(s_audioBaseBitrate, 20);
+    for (int i = 0; i < reports.size(); ++i) {
+        const AudioReport & report = reports.at(i);
+        policy.update(report.fractionLost, report.jitterMs);
+        const AudioResiliencePolicy::Settings settings = policy.settings();
+
+        const QByteArray where = "report " + QByteArray::number(i + 1);
+        QVERIFY2(settings.fec == report.fec, where.constData());
+        QVERIFY2((settings.expectedLoss > 0) == settings.fec, where.constData());
+        QVERIFY2(settings.packetTime == report.packetTime, where.constData());
+        QVERIFY2(report.bitrate ? settings.bitrate == report.bitrate : settings.bitrate > s_audioBaseBitrate,
+                 where.constData());
+    }
+
+    //after a reset the next report starts from scratch
+    policy.reset();
+    QVERIFY(policy.smoothedLoss() == 0);
+    QVERIFY(policy.settings() == AudioResiliencePolicy(s_audioBaseBitrate, 20).settings());
+    policy.update(0.02, 5);
+    QVERIFY(!policy.settings().fec);
+}
+
+static QByteArray tierString(const VideoAdaptationPolicy::Tier & tier)
+{
+    return QByteArray::number(tier.width) + 'x' + QByteArray::number(tier.height)
+            + '@' + QByteArray::number(tier.framerate);
+}
+
+void PolicyTest::videoAdaptationNetwork()
+{
+    struct Reports
+    {
+        double fractionLost;
+        int roundTripMs;
+        int allowedBitrate;
+        int count; //in a row, each of them expected to end up in the tier
+        const char *tier;
+    };
+    const Reports steps[] = {
+        //540p at first, 720p once there is room for it for two reports
+        { 0.0, 50, 0, 3, "960x540@30" },
+        { 0.0, 50, 0, 1, "1280x720@30" },
+        //one lossy report may be a burst, the next one is not
+        { 0.5, 50, 0, 1, "1280x720@30" },
+        { 0.5, 50, 0, 2, "960x540@30" },
+        //down at once while the smoothed loss is still high
+        { 0.0, 50, 0, 2, "854x480@30" },
+        { 0.0, 50, 0, 13, "640x360@30" },
+        //and back up one tier at a time
+        { 0.0, 50, 0, 3, "854x480@30" },
+        { 0.0, 50, 0, 4, "960x540@30" },
+        { 0.0, 50, 0, 2, "1280x720@30" },
+        //a round trip that shows queuing is congestion too
+        { 0.0, 600, 0, 1, "1280x720@30" },
+        { 0.0, 600, 0, 2, "960x540@30" },
+        //never above what fsconference lets us send
+        { 0.0, 50, 400000, 3, "640x360@15" }
+    };
+
+    VideoAdaptationPolicy policy;
+    policy.setLimits(1280, 720, 30);
+    policy.setNativeSize(1280, 720);
+
+    int report = 0;
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+        for (int r = 0; r < steps[i].count; ++r) {
+            ++report;
+            policy.update(steps[i].fractionLost, steps[i].roundTripMs, steps[i].allowedBitrate);
+            const QByteArray where = "report " + QByteArray::number(report);
+            QVERIFY2(tierString(policy.tier()) == steps[i].tier, where.constData());
+        }
+    }
+}
+
+void PolicyTest::videoAdaptationLimits_data()
+{
+    QTest::addColumn<int>("maxWidth");
+    QTest::addColumn<int>("maxHeight");
+    QTest::addColumn<int>("maxFramerate");
+    QTest::addColumn<int>("nativeWidth");
+    QTest::addColumn<int>("nativeHeight");
+    QTest::addColumn<QByteArray>("firstTier");
+    QTest::addColumn<QByteArray>("bestTier");
+
+    //the request sets the aspect ratio, and its size is the best tier
+    QTest::newRow("720p requested") << 1280 << 720 << 30 << 0 << 0
+                                    << QByteArray("960x540@30") << QByteArray("1280x720@30");
+    QTest::newRow("640x480 requested") << 640 << 480 << 30 << 0 << 0
+                                       << QByteArray("640x480@30") << QByteArray("640x480@30");
+    //without one the camera does; it always caps the tiers
+    QTest::newRow("640x480 camera") << 0 << 0 << 0 << 640 << 480
+                                    << QByteArray("640x480@30") << QByteArray("640x480@30");
+    QTest::newRow("640x480 camera, 720p requested") << 1280 << 720 << 30 << 640 << 480
+                                                    << QByteArray("640x360@30") << QByteArray("640x360@30");
+    //neither tells: 4:3, like most webcams
+    QTest::newRow("15fps requested") << 0 << 0 << 15 << 0 << 0
+                                     << QByteArray("480x360@15") << QByteArray("480x360@15");
+}
+
+void PolicyTest::videoAdaptationLimits()
+{
+    QFETCH(int, maxWidth);
+    QFETCH(int, maxHeight);
+    QFETCH(int, maxFramerate);
+    QFETCH(int, nativeWidth);
+    QFETCH(int, nativeHeight);
+    QFETCH(QByteArray, firstTier);
+    QFETCH(QByteArray, bestTier);
+
+    VideoAdaptationPolicy policy;
+    policy.setNativeSize(nativeWidth, nativeHeight);
+    policy.setLimits(maxWidth, maxHeight, maxFramerate);
+    QCOMPARE(tierString(policy.tier()), firstTier);
+
+    //a clean network gets to the best tier, and no further
+    for (int i = 0; i < 10; ++i) {
+        policy.update(0.0, 50, 0);
+    }
+    QCOMPARE(tierString(policy.tier()), bestTier);
+}
+
+void PolicyTest::videoAdaptationCpuLimit()
+{
+    VideoAdaptationPolicy policy;
+    policy.setLimits(1280, 720, 30);
+    for (int i = 0; i < 4; ++i) {
+        policy.update(0.0, 50, 0);
+    }
+    QCOMPARE(tierString(policy.tier()), QByteArray("1280x720@30"));
+
+    QVERIFY(policy.lowerCpuLimit());
+    QCOMPARE(tierString(policy.tier()), QByteArray("960x540@30"));
+    QVERIFY(policy.lowerCpuLimit());
+    QCOMPARE(tierString(policy.tier()), QByteArray("854x480@30"));
+    QVERIFY(policy.raiseCpuLimit());
+    QCOMPARE(tierString(policy.tier()), QByteArray("960x540@30"));
+    QVERIFY(policy.raiseCpuLimit());
+    QCOMPARE(tierString(policy.tier()), QByteArray("1280x720@30"));
+    //never above what the network carries
+    QVERIFY(!policy.raiseCpuLimit());
+}
+
+void PolicyTest::cpuPressure()
+{
+    struct Seconds
+    {
+        int queuedFrames;
+        int lateFrames;
+        int count; //in a row, all of them Steady but the last one
+        CpuPressurePolicy::Verdict verdict; //of the last one
+    };
+    const Seconds steps[] = {
+        //one busy second is not enough to step down
+        { 5, 0, 1, CpuPressurePolicy::Steady },
+        { 0, 0, 1, CpuPressurePolicy::Steady },
+        //a little in flight neither steps down nor counts as clear
+        { 0, 0, 10, CpuPressurePolicy::Steady },
+        { 1, 1, 1, CpuPressurePolicy::Steady },
+        //fifteen clear seconds step up
+        { 0, 0, 15, CpuPressurePolicy::Headroom },
+        //falling behind right after that doubles the hold
+        { 5, 0, 2, CpuPressurePolicy::Behind },
+        { 0, 0, 30, CpuPressurePolicy::Headroom },
+        { 0, 4, 2, CpuPressurePolicy::Behind },
+        { 0, 0, 60, CpuPressurePolicy::Headroom },
+        //falling behind long after a step up does not
+        { 0, 0, 40, CpuPressurePolicy::Steady },
+        { 5, 0, 2, CpuPressurePolicy::Behind },
+        { 0, 0, 60, CpuPressurePolicy::Headroom }
+    };
+
+    CpuPressurePolicy policy;
+    int second = 0;
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+        for (int s = 1; s <= steps[i].count; ++s) {
+            ++second;
+            CpuPressurePolicy::Verdict expected = s == steps[i].count ? steps[i].verdict : CpuPressurePolicy::Steady;
+            const QByteArray where = "second " + QByteArray::number(second);
+            QVERIFY2(policy.update(steps[i].queuedFrames, steps[i].lateFrames) == expected, where.constData());
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(PolicyTest)
+
+#include "policy_test.moc"
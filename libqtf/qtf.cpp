@@ -75,6 +75,12 @@ bool Channel::processBusMessage(const QGst::MessagePtr & message)
     return tf_channel_bus_message(object<TfChannel>(), message);
 }
 
+void Content::sendingFailed(const QString & message)
+{
+    //the message is text of the devices and GStreamer, never a format string
+    tf_content_sending_failed(object<TfContent>(), "%s", message.toUtf8().constData());
+}
+
 void init()
 {
     Private::registerWrapperConstructors();
@@ -61,6 +61,8 @@ public:
 class QTF_EXPORT Content : public QGlib::Object
 {
     QTF_WRAPPER(Content)
+public:
+    void sendingFailed(const QString & message);
 };
 
 
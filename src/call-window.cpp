@@ -242,13 +242,13 @@ void CallWindow::onContentAdded(CallContentHandler *contentHandler)
 
         checkEnableDtmf();
 
-        VolumeController *vol = audioContentHandler->inputVolumeControl();
-        d->muteAction->setEnabled(vol->volumeControlSupported());
-        connect(vol, SIGNAL(volumeControlSupportedChanged(bool)),
+        MuteController *mute = audioContentHandler->inputMuteControl();
+        d->muteAction->setEnabled(mute->muteControlSupported());
+        connect(mute, SIGNAL(muteControlSupportedChanged(bool)),
                 d->muteAction, SLOT(setEnabled(bool)));
-        d->muteAction->setChecked(vol->isMuted());
-        connect(vol, SIGNAL(mutedChanged(bool)), d->muteAction, SLOT(setChecked(bool)));
-        d->muteAction->setProperty("volumeController", QVariant::fromValue<QObject*>(vol));
+        d->muteAction->setChecked(mute->isMuted());
+        connect(mute, SIGNAL(mutedChanged(bool)), d->muteAction, SLOT(setChecked(bool)));
+        d->muteAction->setProperty("muteController", QVariant::fromValue<QObject*>(mute));
 
         d->statusArea->showAudioStatusIcon(true);
     } else {
@@ -280,10 +280,10 @@ void CallWindow::onContentRemoved(CallContentHandler *contentHandler)
         AudioContentHandler *audioContentHandler = qobject_cast<AudioContentHandler*>(contentHandler);
         Q_ASSERT(audioContentHandler);
 
-        VolumeController *vol = audioContentHandler->inputVolumeControl();
-        disconnect(vol, NULL, d->muteAction, NULL);
+        MuteController *mute = audioContentHandler->inputMuteControl();
+        disconnect(mute, NULL, d->muteAction, NULL);
         d->muteAction->setEnabled(false);
-        d->muteAction->setProperty("volumeController", QVariant());
+        d->muteAction->setProperty("muteController", QVariant());
 
         d->statusArea->showAudioStatusIcon(false);
     } else {
@@ -337,7 +337,8 @@ void CallWindow::changeVideoDisplayState(VideoDisplayFlags newState)
     } else if (!oldState.testFlag(LocalVideoPreview) && newState.testFlag(LocalVideoPreview)) {
         QGst::ElementPtr localVideoSink = d->qmlUi->getVideoPreviewSink();
         if (localVideoSink) {
-            d->videoContentHandler->linkVideoPreviewSink(localVideoSink );
+            //the video items of the QML ui mirror the picture themselves
+            d->videoContentHandler->linkVideoPreviewSink(localVideoSink, VideoContentHandler::SinkMirrors);
         }
     }
 
@@ -346,7 +347,8 @@ void CallWindow::changeVideoDisplayState(VideoDisplayFlags newState)
     } else if (!oldState.testFlag(RemoteVideo) && newState.testFlag(RemoteVideo)) {
         QGst::ElementPtr remoteVideoSink = d->qmlUi->getVideoSink();
         if (remoteVideoSink) {
-            d->videoContentHandler->linkRemoteMemberVideoSink(d->remoteVideoContact, remoteVideoSink);
+            d->videoContentHandler->linkRemoteMemberVideoSink(d->remoteVideoContact, remoteVideoSink,
+                                                              VideoContentHandler::SinkMirrors);
         }
     }
 
@@ -445,12 +447,12 @@ void CallWindow::toggleDtmf(bool checked)
 
 void CallWindow::toggleMute(bool checked)
 {
-    //this slot is here to avoid connecting the mute button directly to the VolumeController
+    //this slot is here to avoid connecting the mute button directly to the MuteController
     //as there is a signal loop: toggled() -> setMuted() -> mutedChanged() -> setChecked()
-    QObject *volControl = qvariant_cast<QObject*>(sender()->property("volumeController"));
-    if (volControl) {
+    QObject *muteControl = qvariant_cast<QObject*>(sender()->property("muteController"));
+    if (muteControl) {
         sender()->blockSignals(true);
-        volControl->setProperty("muted", checked);
+        muteControl->setProperty("muted", checked);
         sender()->blockSignals(false);
     }
 }
@@ -88,6 +88,9 @@ Rectangle {
 
             surface: videoSurface
             visible: false
+
+            //mirrored in the scene graph, instead of every frame on the CPU
+            transform: Scale { origin.x: videoWidget.width / 2; xScale: -1 }
         }
     }
 
@@ -113,6 +116,8 @@ Rectangle {
             anchors.fill: parent
             anchors.margins: 2
             surface: videoPreviewSurface
+
+            transform: Scale { origin.x: videoPreviewWidget.width / 2; xScale: -1 }
         }
     }
 